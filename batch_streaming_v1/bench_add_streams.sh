@@ -0,0 +1,44 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Bulk admission benchmark: time-to-N for N = 8, 32, 64 (BACKEND=cpu).
+# For each N, on a fresh server:
+#   bulk: one POST /add_streams {"count": N}
+#   seq:  N x GET /add_demo_stream, back to back
+# time-to-N = request start -> every /sN mount has delivered its first frame to
+# a viewer (response time + slowest ttff from rtsp_bench started right after).
+# Admission is opened up (ADMISSION_SW_FPS_PER_CORE, no reserve) so the run measures the
+# control and branch-building path, not this host's encoder capacity.
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_add_streams.sh
+source "$(dirname "$0")/bench_lib.sh"
+COUNTS="${COUNTS:-8 32 64}"
+ADMIT="${ADMISSION_SW_FPS_PER_CORE:-100000}"
+
+rows=()
+measure() { # mode N
+  local mode="$1" n="$2" t0 t1 out ttff
+  server_start MAX_STREAMS=64 ADMISSION_SW_FPS_PER_CORE="$ADMIT" ADMISSION_RESERVE_PCT=0
+  t0=$(now_ms)
+  if [[ "$mode" == bulk ]]; then
+    add_streams "$n" >/dev/null
+  else
+    for _ in $(seq 1 "$n"); do ctrl /add_demo_stream >/dev/null; done
+  fi
+  t1=$(now_ms)
+  [[ "$(stream_count)" == "$n" ]] || bench_fail "$mode N=$n: only $(stream_count) streams added"
+  out="$BENCH_OUT/add_${mode}_$n.json"
+  "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "0-$(( n - 1 ))" --duration 8 --warmup 1 >"$out" 2>/dev/null || true
+  ttff=$(json_get "d['summary']['ttff_ms_max']" <"$out")
+  local ok; ok=$(json_get "d['summary']['clients_ok']" <"$out")
+  rows+=("$(printf '%-5s N=%-3s response=%6s ms  ttff_max=%8.1f ms  time_to_N=%8.1f ms  viewers_ok=%s/%s' \
+    "$mode" "$n" "$(( t1 - t0 ))" "$ttff" "$(awk -v a=$(( t1 - t0 )) -v b="$ttff" 'BEGIN { print a + b }')" "$ok" "$n")")
+  server_stop
+}
+
+for n in $COUNTS; do
+  measure bulk "$n"
+  measure seq "$n"
+done
+printf '%s\n' "${rows[@]}"
+bench_pass "time-to-N (JSON in $BENCH_OUT)"
@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Core allocator benchmark: aggregate fps and per-stream jitter with the x264 core
+# budget off (CPU_BUDGET_CORES=0: historical threads, no pinning) and on
+# (CPU_BUDGET_CORES / CPU_BUDGET_FIRST / X264_THREADS as given, default all CPUs),
+# BACKEND=cpu. For each mode, on a fresh server: STREAMS x264 streams (default one
+# per CPU, so encoders contend), one rtsp_bench viewer per mount for DURATION s.
+# Admission is opened up so both runs encode the same number of streams.
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_cpu_budget.sh
+#   docker run --rm --network host -e STREAMS=24 -e X264_THREADS=2 batch_streaming:latest bash bench_cpu_budget.sh
+source "$(dirname "$0")/bench_lib.sh"
+STREAMS="${STREAMS:-$(( $(nproc) < 4 ? 4 : ($(nproc) > 48 ? 48 : $(nproc)) ))}"
+DURATION="${DURATION:-30}"
+
+rows=()
+for mode in off on; do
+  if [[ "$mode" == off ]]; then budget=(CPU_BUDGET_CORES=0); else budget=(CPU_BUDGET_CORES="${CPU_BUDGET_CORES:-}" CPU_BUDGET_FIRST="${CPU_BUDGET_FIRST:-}"); fi
+  server_start "${budget[@]}" X264_THREADS="${X264_THREADS:-}" HW_THRESHOLD=0 MAX_STREAMS=64 \
+    ADMISSION_SW_FPS_PER_CORE=100000 ADMISSION_RESERVE_PCT=0
+  add_streams "$STREAMS" >/dev/null
+  [[ "$(stream_count)" == "$STREAMS" ]] || bench_fail "$mode: only $(stream_count) of $STREAMS streams added"
+  sleep 3 # let the allocator's first re-apply pin every encoder thread
+  out="$BENCH_OUT/budget_$mode.json"
+  "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "0-$(( STREAMS - 1 ))" \
+    --duration "$DURATION" --warmup 5 >"$out" 2>/dev/null || true
+  rows+=("$(json_get "'%-3s streams=%d fps_total=%7.1f fps_min=%5.1f jitter_avg=%6.2fms jitter_max=%6.2fms loss=%.2f%% ok=%d' % ('$mode', $STREAMS, d['summary']['fps_total'], min([c.get('fps', 0) for c in d['clients']] or [0]), d['summary']['jitter_ms_avg'], d['summary']['jitter_ms_max'], d['summary']['loss_pct'], d['summary']['clients_ok'])" <"$out")")
+  server_stop
+done
+printf '%s\n' "${rows[@]}"
+bench_pass "core allocator comparison (JSON in $BENCH_OUT)"
@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Control API (epoll server) loopback benchmark: requests/s and p99 latency.
+# - Malformed requests first: Content-Length that is negative, oversized, not a
+#   number or repeated must get 400/413, and the server must still answer after.
+# - Then ctrl_bench against GET /status at 1/16/64 keep-alive connections and 16
+#   connection-per-request clients, and once more at 64 while /add_streams batches
+#   are running on the worker (cheap routes must not wait behind them).
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_ctrl.sh
+source "$(dirname "$0")/bench_lib.sh"
+DURATION="${DURATION:-10}"
+
+server_start
+add_streams 8 >/dev/null
+
+raw() { # raw HTTP request text -> status code of the answer
+  python3 - "$BENCH_CTRL_PORT" "$1" <<'EOF'
+import socket, sys
+s = socket.create_connection(("127.0.0.1", int(sys.argv[1])), timeout=5)
+s.sendall(sys.argv[2].encode().decode("unicode_escape").encode())
+print(s.recv(256).split(b" ")[1].decode())
+EOF
+}
+check_raw() { # want, label, headers after the request line
+  local got
+  got=$(raw "POST /add_streams HTTP/1.1\\r\\nHost: x\\r\\n$3")
+  [[ "$got" == "$want" ]] || bench_fail "$2: expected $want, got $got"
+  echo "OK: $2 -> $want"
+}
+check_raw 400 "negative Content-Length" 'Content-Length: -1\r\n\r\n'
+check_raw 413 "Content-Length = 2^64-1" 'Content-Length: 18446744073709551615\r\n\r\n'
+check_raw 413 "Content-Length past 2^64" 'Content-Length: 99999999999999999999999\r\n\r\n'
+check_raw 400 "non-numeric Content-Length" 'Content-Length: 12abc\r\n\r\n'
+check_raw 400 "repeated Content-Length" 'Content-Length: 2\r\nContent-Length: 2\r\n\r\n{}'
+[[ "$(ctrl_code /status)" == 200 ]] || bench_fail "server stopped answering after malformed requests"
+
+results=()
+run() { # label, ctrl_bench args
+  local label="$1"; shift
+  local out="$BENCH_OUT/ctrl_$label.json"
+  "$CTRL_BENCH" --port "$BENCH_CTRL_PORT" --duration "$DURATION" "$@" >"$out"
+  results+=("$(json_get "'%-16s rps=%9.0f p50=%6.2fms p99=%6.2fms errors=%d' % ('$label', d['summary']['rps'], d['summary']['latency_ms']['p50'], d['summary']['latency_ms']['p99'], d['summary']['errors'])" <"$out")")
+}
+run ka_1 --conns 1
+run ka_16 --conns 16
+run ka_64 --conns 64
+run close_16 --conns 16 --close
+
+# Same load while the worker is busy building and tearing down branches.
+( end=$(( $(date +%s) + DURATION ))
+  while (( $(date +%s) < end )); do
+    add_streams 8 >/dev/null || true
+    for i in $(seq 8 15); do remove_stream "$i" || true; done
+  done ) &
+churn=$!
+run ka_64_busy --conns 64
+wait "$churn" || true
+
+printf '%s\n' "${results[@]}"
+server_stop
+bench_pass "control API benchmark (JSON in $BENCH_OUT)"
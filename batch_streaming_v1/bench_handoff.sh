@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# RTSP egress benchmark: per-stream server CPU, UDP loopback wrap vs in-process
+# hand-off (RTSP_HANDOFF=appsrc), BACKEND=cpu.
+# For each mode, on a fresh server: STREAMS streams, one rtsp_bench viewer per
+# mount, server CPU sampled over DURATION seconds once every viewer is playing.
+# Encode cost is the same in both modes, so the per-stream difference is the
+# udpsink -> loopback -> udpsrc -> depay/pay hop the hand-off removes.
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_handoff.sh
+source "$(dirname "$0")/bench_lib.sh"
+STREAMS="${STREAMS:-8}"
+DURATION="${DURATION:-20}"
+
+rows=()
+for mode in udp appsrc; do
+  server_start RTSP_HANDOFF="$([[ "$mode" == appsrc ]] && echo appsrc || echo udp)"
+  add_streams "$STREAMS" >/dev/null
+  [[ "$(stream_count)" == "$STREAMS" ]] || bench_fail "$mode: only $(stream_count) of $STREAMS streams added"
+  out="$BENCH_OUT/handoff_$mode.json"
+  "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "0-$(( STREAMS - 1 ))" \
+    --duration $(( DURATION + 5 )) --warmup 3 >"$out" 2>/dev/null &
+  viewer=$!
+  sleep 4
+  cpu=$(proc_cpu_pct "$SERVER_PID" "$DURATION")
+  wait "$viewer" || true
+  ok=$(json_get "d['summary']['clients_ok']" <"$out")
+  (( ok == STREAMS )) || bench_fail "$mode: only $ok of $STREAMS viewers got frames"
+  rows+=("$(json_get "'%-6s streams=$STREAMS cpu=%6.1f%%  per_stream=%5.1f%%  fps_total=%6.1f  loss=%.2f%%  jitter_avg=%.2fms' % ('$mode', $cpu, $cpu / $STREAMS, d['summary']['fps_total'], d['summary']['loss_pct'], d['summary']['jitter_ms_avg'])" <"$out")")
+  server_stop
+done
+printf '%s\n' "${rows[@]}"
+bench_pass "hand-off CPU comparison (JSON in $BENCH_OUT)"
@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Late-joiner benchmark: time to the first keyframe (ttkf, the first frame a
+# decoder can start from) and to the first frame, with KEYFRAME_ON_JOIN off and
+# on, BACKEND=cpu.
+# For each mode, on a fresh server: STREAMS streams at keyframe_interval GOP
+# frames (default 150 = 5 s), one long-running anchor viewer per mount so every
+# media is already playing, then JOINS rounds of late joiners on every mount at
+# random offsets into the GOP. Without the join keyframe a joiner waits for the
+# next periodic IDR (GOP/2 on average); with it, about one frame time.
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_keyframe_join.sh
+source "$(dirname "$0")/bench_lib.sh"
+STREAMS="${STREAMS:-4}"
+GOP="${GOP:-150}"
+JOINS="${JOINS:-5}"
+JOIN_S=$(( GOP / 30 + 3 )) # long enough to see a periodic IDR at 30 fps
+
+rows=()
+for mode in off on; do
+  server_start KEYFRAME_ON_JOIN="$mode" KEYFRAME_JOIN_MIN_MS=0 LAZY_ENCODE=off \
+    ADMISSION_SW_FPS_PER_CORE=100000 ADMISSION_RESERVE_PCT=0
+  add_streams "$STREAMS" >/dev/null
+  for i in $(seq 0 $(( STREAMS - 1 ))); do
+    [[ "$(ctrl_code "/streams/$i/config" -X POST -H 'Content-Type: application/json' -d "{\"keyframe_interval\": $GOP}")" == 200 ]] || bench_fail "config /s$i"
+  done
+  "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "0-$(( STREAMS - 1 ))" \
+    --duration $(( JOINS * (JOIN_S + 2) + 10 )) >/dev/null 2>&1 &
+  anchor=$!
+  sleep 4
+  for r in $(seq 1 "$JOINS"); do
+    sleep "$(awk -v s="$RANDOM" 'BEGIN { printf "%.2f", (s % 200) / 100 }')"
+    "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "0-$(( STREAMS - 1 ))" \
+      --duration "$JOIN_S" --warmup 1 >"$BENCH_OUT/join_${mode}_$r.json" 2>/dev/null || true
+  done
+  kill "$anchor" 2>/dev/null || true
+  wait "$anchor" 2>/dev/null || true
+  rows+=("$(python3 - "$mode" "$BENCH_OUT"/join_"$mode"_*.json <<'EOF'
+import json, sys
+kf, ff, missing = [], [], 0
+for path in sys.argv[2:]:
+    for c in json.load(open(path))["clients"]:
+        if c.get("ttkf_ms") is None: missing += 1
+        else: kf.append(c["ttkf_ms"])
+        if c.get("ttff_ms") is not None: ff.append(c["ttff_ms"])
+kf.sort()
+avg = lambda v: sum(v) / len(v) if v else 0.0
+print("join_kf=%-3s joins=%d ttkf avg=%7.1fms p50=%7.1fms max=%7.1fms  ttff avg=%6.1fms  no_keyframe=%d"
+      % (sys.argv[1], len(kf) + missing, avg(kf), kf[len(kf) // 2] if kf else 0, kf[-1] if kf else 0, avg(ff), missing))
+EOF
+)")
+  server_stop
+done
+printf '%s\n' "${rows[@]}"
+bench_pass "keyframe-on-join comparison (JSON in $BENCH_OUT)"
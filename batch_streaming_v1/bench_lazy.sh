@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Lazy encoding benchmark: server CPU with STREAMS streams (default 64) of which
+# every WATCH_EVERY-th mount (default 10, i.e. ~10%) has a viewer, with
+# LAZY_ENCODE=off (every branch encodes) and on (unwatched valves closed),
+# BACKEND=cpu. Viewer fps is reported too, so the "on" run is shown to still
+# deliver to the watched mounts.
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_lazy.sh
+source "$(dirname "$0")/bench_lib.sh"
+STREAMS="${STREAMS:-64}"
+WATCH_EVERY="${WATCH_EVERY:-10}"
+DURATION="${DURATION:-20}"
+
+watched=$(seq -s, 0 "$WATCH_EVERY" $(( STREAMS - 1 )))
+n_watched=$(tr ',' '\n' <<<"$watched" | wc -l)
+
+rows=()
+for mode in off on; do
+  server_start LAZY_ENCODE="$mode" LAZY_IDLE_MS=2000 MAX_STREAMS="$STREAMS" \
+    ADMISSION_SW_FPS_PER_CORE=100000 ADMISSION_RESERVE_PCT=0
+  add_streams "$STREAMS" >/dev/null
+  [[ "$(stream_count)" == "$STREAMS" ]] || bench_fail "lazy=$mode: only $(stream_count) of $STREAMS streams added"
+  out="$BENCH_OUT/lazy_$mode.json"
+  "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "$watched" \
+    --duration $(( DURATION + 8 )) --warmup 3 >"$out" 2>/dev/null &
+  viewer=$!
+  sleep 6 # viewers playing, idle valves of the "on" run long closed
+  cpu=$(proc_cpu_pct "$SERVER_PID" "$DURATION")
+  wait "$viewer" || true
+  ok=$(json_get "d['summary']['clients_ok']" <"$out")
+  (( ok == n_watched )) || bench_fail "lazy=$mode: only $ok of $n_watched viewers got frames"
+  rows+=("$(json_get "'lazy=%-3s streams=$STREAMS watched=$n_watched cpu=%7.1f%%  fps_total=%6.1f  ttff_max=%7.1fms' % ('$mode', $cpu, d['summary']['fps_total'], d['summary']['ttff_ms_max'])" <"$out")")
+  server_stop
+done
+printf '%s\n' "${rows[@]}"
+bench_pass "lazy encoding CPU comparison (JSON in $BENCH_OUT)"
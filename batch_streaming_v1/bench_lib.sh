@@ -0,0 +1,75 @@
+#!/usr/bin/env bash
+# Shared helpers for the loopback test/benchmark scripts (bench_*.sh, test_*.sh).
+# Sourced, not run. The scripts run INSIDE the image, against a private BACKEND=cpu
+# server they start themselves (no GPU, no DeepStream front end), e.g.
+#   docker run --rm --network host batch_streaming:latest bash bench_ctrl.sh
+
+BENCH_DIR="${BENCH_DIR:-$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)}"
+SERVER_BIN="${SERVER_BIN:-$BENCH_DIR/rtsp_server}"
+RTSP_BENCH="${RTSP_BENCH:-$BENCH_DIR/rtsp_bench}"
+CTRL_BENCH="${CTRL_BENCH:-$BENCH_DIR/ctrl_bench}"
+BENCH_CTRL_PORT="${BENCH_CTRL_PORT:-18080}"
+BENCH_RTSP_PORT="${BENCH_RTSP_PORT:-18554}"
+BENCH_UDP_PORT="${BENCH_UDP_PORT:-15000}"
+BENCH_OUT="${BENCH_OUT:-$(mktemp -d /tmp/bench.XXXXXX)}"
+SERVER_PID=""
+
+bench_log() { echo "BENCH: $*" >&2; }
+bench_fail() { echo "FAIL: $*" >&2; server_stop; exit 1; }
+bench_pass() { echo "PASS: $*"; }
+
+# server_start [VAR=value ...]: extra env for this run; waits for /status.
+server_start() {
+  local log="$BENCH_OUT/server.$(date +%s%N).log"
+  env BACKEND=cpu CTRL_PORT="$BENCH_CTRL_PORT" RTSP_PORT="$BENCH_RTSP_PORT" \
+    BASE_UDP_PORT="$BENCH_UDP_PORT" PUBLIC_HOST=127.0.0.1 "$@" \
+    "$SERVER_BIN" >"$log" 2>&1 &
+  SERVER_PID=$!
+  SERVER_LOG="$log"
+  for _ in $(seq 1 100); do
+    if curl -fsS "http://127.0.0.1:$BENCH_CTRL_PORT/status" >/dev/null 2>&1; then
+      bench_log "server pid $SERVER_PID up ($*), log $log"
+      return 0
+    fi
+    kill -0 "$SERVER_PID" 2>/dev/null || break
+    sleep 0.2
+  done
+  tail -n 20 "$log" >&2
+  bench_fail "server did not come up"
+}
+
+server_stop() {
+  [[ -n "$SERVER_PID" ]] || return 0
+  kill -TERM "$SERVER_PID" 2>/dev/null || true
+  wait "$SERVER_PID" 2>/dev/null || true
+  SERVER_PID=""
+}
+trap server_stop EXIT
+
+# ctrl PATH [curl args...]: body on stdout
+ctrl() { curl -sS "http://127.0.0.1:$BENCH_CTRL_PORT$1" "${@:2}"; }
+# ctrl_code PATH [curl args...]: HTTP status only
+ctrl_code() { curl -sS -o /dev/null -w '%{http_code}' "http://127.0.0.1:$BENCH_CTRL_PORT$1" "${@:2}"; }
+
+add_streams() { ctrl /add_streams -X POST -H 'Content-Type: application/json' -d "{\"count\": $1}"; }
+remove_stream() { ctrl "/remove_stream?index=$1" >/dev/null; }
+stream_count() { ctrl /status | json_get 'len(d.get("streams", []))'; }
+
+# json_get EXPR: evaluates EXPR with d = the JSON document on stdin
+json_get() { python3 -c "import json,sys; d=json.load(sys.stdin); print($1)"; }
+
+# CPU seconds (user + system) used by pid so far
+proc_cpu_s() {
+  awk -v hz="$(getconf CLK_TCK)" '{ split($0, a, ") "); split(a[2], f, " "); printf "%.2f\n", (f[12] + f[13]) / hz }' "/proc/$1/stat"
+}
+proc_rss_kb() { awk '/^VmRSS:/ { print $2 }' "/proc/$1/status"; }
+proc_fds() { ls "/proc/$1/fd" | wc -l; }
+
+# Average CPU% of pid over S seconds (100 = one core)
+proc_cpu_pct() {
+  local a b
+  a=$(proc_cpu_s "$1"); sleep "$2"; b=$(proc_cpu_s "$1")
+  awk -v a="$a" -v b="$b" -v s="$2" 'BEGIN { printf "%.1f\n", 100 * (b - a) / s }'
+}
+
+now_ms() { date +%s%3N; }
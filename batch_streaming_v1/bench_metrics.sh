@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Metrics probe cost benchmark: server CPU with STREAMS streams (default 64), all
+# encoding (LAZY_ENCODE=off, no viewers needed), with METRICS=off (queue counters
+# only) and METRICS=on (encoder + sink probes), BACKEND=cpu. Modes alternate for
+# ROUNDS rounds on fresh servers so drift hits both; the overhead is the mean "on"
+# CPU over the mean "off" CPU (target: under 1%).
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_metrics.sh
+source "$(dirname "$0")/bench_lib.sh"
+STREAMS="${STREAMS:-64}"
+DURATION="${DURATION:-20}"
+ROUNDS="${ROUNDS:-2}"
+
+declare -A cpu_sum=([off]=0 [on]=0)
+rows=()
+for r in $(seq 1 "$ROUNDS"); do
+  for mode in off on; do
+    server_start METRICS="$mode" LAZY_ENCODE=off MAX_STREAMS="$STREAMS" \
+      ADMISSION_SW_FPS_PER_CORE=100000 ADMISSION_RESERVE_PCT=0
+    add_streams "$STREAMS" >/dev/null
+    [[ "$(stream_count)" == "$STREAMS" ]] || bench_fail "metrics=$mode: only $(stream_count) of $STREAMS streams added"
+    sleep 5 # encoders past their startup burst
+    cpu=$(proc_cpu_pct "$SERVER_PID" "$DURATION")
+    frames=$(ctrl /metrics | awk '/^batch_stream_frames_total/ { n += $2 } END { print n + 0 }')
+    [[ "$mode" == off || "$frames" -gt 0 ]] || bench_fail "metrics=on: no frames counted"
+    cpu_sum[$mode]=$(awk -v a="${cpu_sum[$mode]}" -v b="$cpu" 'BEGIN { print a + b }')
+    rows+=("$(printf 'round=%d metrics=%-3s streams=%d cpu=%7.1f%%' "$r" "$mode" "$STREAMS" "$cpu")")
+    server_stop
+  done
+done
+printf '%s\n' "${rows[@]}"
+awk -v off="${cpu_sum[off]}" -v on="${cpu_sum[on]}" -v n="$ROUNDS" 'BEGIN {
+  printf "mean cpu off=%.1f%% on=%.1f%%  probe overhead=%+.2f%% of server CPU\n", off / n, on / n, off > 0 ? 100 * (on - off) / off : 0 }'
+bench_pass "metrics probe cost (server logs in $BENCH_OUT)"
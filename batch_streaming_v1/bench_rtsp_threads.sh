@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# RTSP connect-storm benchmark: session setup latency per RTSP server thread-pool
+# size, BACKEND=cpu. For each RTSP_THREADS in THREADS (default 1 2 4 8), on a fresh
+# server with STREAMS streams: CLIENTS rtsp_bench viewers (default 500, over TCP so
+# the client side does not run out of UDP ports) start evenly over RAMP_MS (1000)
+# across all mounts. Prints setup_ms p50/p99 per setting: the DESCRIBE round trip
+# and the time to the first frame.
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_rtsp_threads.sh
+source "$(dirname "$0")/bench_lib.sh"
+THREADS="${THREADS:-1 2 4 8}"
+STREAMS="${STREAMS:-8}"
+CLIENTS="${CLIENTS:-500}"
+RAMP_MS="${RAMP_MS:-1000}"
+DURATION="${DURATION:-15}"
+
+ulimit -n "$(ulimit -Hn)" 2>/dev/null || true
+rows=()
+for threads in $THREADS; do
+  server_start RTSP_THREADS="$threads" MAX_STREAMS="$STREAMS" LAZY_ENCODE=off
+  add_streams "$STREAMS" >/dev/null
+  [[ "$(stream_count)" == "$STREAMS" ]] || bench_fail "threads=$threads: only $(stream_count) of $STREAMS streams added"
+  grep -q "($threads client threads)" "$SERVER_LOG" || bench_fail "threads=$threads: server did not size its pool to $threads"
+  out="$BENCH_OUT/rtsp_threads_$threads.json"
+  "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "0-$(( STREAMS - 1 ))" \
+    --clients "$CLIENTS" --ramp-ms "$RAMP_MS" --duration "$DURATION" --tcp >"$out" 2>/dev/null || true
+  ok=$(json_get "d['summary']['clients_ok']" <"$out")
+  (( ok * 10 >= CLIENTS * 9 )) || bench_fail "threads=$threads: only $ok of $CLIENTS clients got frames"
+  rows+=("$(json_get "'threads=%-2d clients=%d ok=%d  describe_ms p50=%7.1f p99=%7.1f  ttff_ms p50=%7.1f p99=%7.1f' % ($threads, $CLIENTS, d['summary']['clients_ok'], d['summary']['setup_ms']['describe_p50'], d['summary']['setup_ms']['describe_p99'], d['summary']['setup_ms']['ttff_p50'], d['summary']['setup_ms']['ttff_p99'])" <"$out")")
+  server_stop
+done
+printf '%s\n' "${rows[@]}"
+bench_pass "RTSP thread-pool connect storm, $CLIENTS clients over ${RAMP_MS} ms (JSON in $BENCH_OUT)"
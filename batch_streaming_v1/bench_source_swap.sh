@@ -0,0 +1,62 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Source swap latency against the mock REST backend (BACKEND=cpu, REST_MOCK=1).
+# For each mock answer delay in DELAYS_MS: one stream with a viewer on /s0, then
+# SWAPS × POST /streams/0/source alternating two urls. Reported per delay:
+# - rest_ms: remove + add round trip, from the endpoint's response;
+# - first_ms: swap start to the branch's first frame, from the server log;
+# - the viewer's worst frame gap (it must stay connected across every swap).
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash bench_source_swap.sh
+source "$(dirname "$0")/bench_lib.sh"
+SWAPS="${SWAPS:-20}"
+DELAYS_MS="${DELAYS_MS:-0 20 100}"
+MOCK_PORT="${MOCK_PORT:-19000}"
+
+MOCK_PID=""
+mock_stop() { [[ -z "$MOCK_PID" ]] || { kill "$MOCK_PID" 2>/dev/null || true; wait "$MOCK_PID" 2>/dev/null || true; MOCK_PID=""; }; }
+trap 'server_stop; mock_stop' EXIT
+
+rows=()
+for delay in $DELAYS_MS; do
+  python3 "$(dirname "$0")/mock_rest.py" "$MOCK_PORT" "$delay" &
+  MOCK_PID=$!
+  sleep 0.5
+  server_start REST_MOCK=1 REST_PORTS="$MOCK_PORT" ADMISSION_SW_FPS_PER_CORE=100000 ADMISSION_RESERVE_PCT=0
+  add_streams 1 >/dev/null
+  [[ "$(stream_count)" == 1 ]] || bench_fail "delay=$delay: stream not added"
+  out="$BENCH_OUT/swap_$delay.json"
+  "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts 0 \
+    --duration $(( SWAPS / 2 + 8 )) --warmup 2 >"$out" 2>/dev/null &
+  viewer=$!
+  sleep 3
+  : >"$BENCH_OUT/swap_$delay.rest"
+  for i in $(seq 1 "$SWAPS"); do
+    resp=$(ctrl /streams/0/source -X POST -H 'Content-Type: application/json' \
+      -d "{\"uri\": \"rtsp://cam-$(( i % 2 )).invalid/stream\"}")
+    json_get "d['rest_ms']" <<<"$resp" >>"$BENCH_OUT/swap_$delay.rest" || bench_fail "delay=$delay: swap $i: $resp"
+    sleep 0.4
+  done
+  wait "$viewer" || true
+  counts=$(curl -sS "http://127.0.0.1:$MOCK_PORT/stats")
+  server_stop
+  mock_stop
+  grep -o 'Source swap on /s0: first frame after [0-9]* ms' "$SERVER_LOG" | awk '{ print $(NF-1) }' >"$BENCH_OUT/swap_$delay.first"
+  rows+=("$(python3 - "$delay" "$SWAPS" "$out" "$BENCH_OUT/swap_$delay.rest" "$BENCH_OUT/swap_$delay.first" "$counts" <<'PY'
+import json, sys
+delay, swaps, out, rest_path, first_path, counts = sys.argv[1], int(sys.argv[2]), sys.argv[3], sys.argv[4], sys.argv[5], json.loads(sys.argv[6])
+rest = sorted(float(v) for v in open(rest_path).read().split())
+first = sorted(float(v) for v in open(first_path).read().split())
+c = json.load(open(out))["clients"][0]
+stat = lambda v: "avg=%6.1f p50=%6.1f max=%6.1f" % (sum(v) / len(v), v[len(v) // 2], v[-1]) if v else "n/a"
+ok = (c["error"] is None and len(rest) == swaps and len(first) == swaps
+      and counts.get("/api/v1/stream/remove") == swaps and counts.get("/api/v1/stream/add") == swaps + 1)
+print("mock_delay=%4sms swaps=%d rest_ms %s  first_ms %s  viewer fps=%5.1f gap_max=%6.1fms%s"
+      % (delay, swaps, stat(rest), stat(first), c["fps"], c["interval_ms"]["max"], "" if ok else "  INCOMPLETE"))
+PY
+)")
+done
+printf '%s\n' "${rows[@]}"
+grep -q INCOMPLETE <<<"${rows[*]}" && bench_fail "some swaps were lost or the viewer dropped (JSON in $BENCH_OUT)"
+bench_pass "source swap latency against the mock REST backend (JSON in $BENCH_OUT)"
@@ -10,4 +10,7 @@ echo "Running sanity check inside the image..."
 # GStreamer/DeepStream plugins and that a software H.264 encoder is available.
 docker run --rm -i batch_streaming:latest bash -s < sanity.sh
 echo "✓ Sanity passed."
+echo "Running unit tests inside the image..."
+docker run --rm batch_streaming:latest ./unit_tests
+echo "✓ Unit tests passed."
 echo "Run with: ./run.sh (starts empty; add streams via /add_demo_stream)"
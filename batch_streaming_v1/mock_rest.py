@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+# Mock nvmultiurisrcbin REST server for BACKEND=cpu runs with REST_MOCK=1.
+# Answers POST /api/v1/stream/{add,remove} with 200 after DELAY_MS (keep-alive,
+# like the real server) and counts requests; GET /stats returns the counts.
+#   python3 mock_rest.py PORT [DELAY_MS]
+import json, sys, threading, time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+PORT = int(sys.argv[1])
+DELAY_S = (int(sys.argv[2]) if len(sys.argv) > 2 else 0) / 1000.0
+counts = {}
+lock = threading.Lock()
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def reply(self, code, obj):
+        body = (json.dumps(obj) + "\n").encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_POST(self):
+        self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        if self.path not in ("/api/v1/stream/add", "/api/v1/stream/remove"):
+            return self.reply(404, {"status": "not found"})
+        with lock:
+            counts[self.path] = counts.get(self.path, 0) + 1
+        time.sleep(DELAY_S)
+        self.reply(200, {"status": "HTTP/1.1 200 OK", "reason": "STREAM_" + self.path.rsplit("/", 1)[1].upper() + "_SUCCESS"})
+
+    def do_GET(self):
+        with lock:
+            self.reply(200, dict(counts))
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+ThreadingHTTPServer(("127.0.0.1", PORT), Handler).serve_forever()
@@ -6,8 +6,12 @@ ENGINE_DIR="${ENGINE_DIR:-$PWD/models}"
 
 mkdir -p "$ENGINE_DIR"
 
+# BACKEND=cpu runs without a GPU (videotestsrc front end, x264 branches only)
+gpu_args=(--gpus all)
+if [[ "${BACKEND:-}" == "cpu" ]]; then gpu_args=(); fi
+
 cmd=(docker run --rm \
-  --gpus all \
+  ${gpu_args[@]+"${gpu_args[@]}"} \
   --network host \
   -e NVIDIA_DRIVER_CAPABILITIES="video,compute,utility" \
   -e RTSP_PORT="$RTSP_PORT" \
@@ -18,10 +22,44 @@ cmd=(docker run --rm \
   batch_streaming:latest)
 
 # Optional pass-throughs
+if [[ -n "${BACKEND:-}" ]]; then cmd+=(-e BACKEND="$BACKEND"); fi
 if [[ -n "${SAMPLE_URI:-}" ]]; then cmd+=(-e SAMPLE_URI="$SAMPLE_URI"); fi
+if [[ -n "${RTSP_HANDOFF:-}" ]]; then cmd+=(-e RTSP_HANDOFF="$RTSP_HANDOFF"); fi
 if [[ -n "${HW_THRESHOLD:-}" ]]; then cmd+=(-e HW_THRESHOLD="$HW_THRESHOLD"); fi
-if [[ -n "${SW_MAX:-}" ]]; then cmd+=(-e SW_MAX="$SW_MAX"); fi
+if [[ -n "${ADMISSION_SW_FPS_PER_CORE:-}" ]]; then cmd+=(-e ADMISSION_SW_FPS_PER_CORE="$ADMISSION_SW_FPS_PER_CORE"); fi
+if [[ -n "${ADMISSION_RESERVE_PCT:-}" ]]; then cmd+=(-e ADMISSION_RESERVE_PCT="$ADMISSION_RESERVE_PCT"); fi
+if [[ -n "${CPU_BUDGET_CORES:-}" ]]; then cmd+=(-e CPU_BUDGET_CORES="$CPU_BUDGET_CORES"); fi
+if [[ -n "${CPU_BUDGET_FIRST:-}" ]]; then cmd+=(-e CPU_BUDGET_FIRST="$CPU_BUDGET_FIRST"); fi
+if [[ -n "${BRANCH_QUEUE_POLICY:-}" ]]; then cmd+=(-e BRANCH_QUEUE_POLICY="$BRANCH_QUEUE_POLICY"); fi
+if [[ -n "${BRANCH_QUEUE_MS:-}" ]]; then cmd+=(-e BRANCH_QUEUE_MS="$BRANCH_QUEUE_MS"); fi
+if [[ -n "${DEGRADE:-}" ]]; then cmd+=(-e DEGRADE="$DEGRADE"); fi
+if [[ -n "${LAZY_ENCODE:-}" ]]; then cmd+=(-e LAZY_ENCODE="$LAZY_ENCODE"); fi
+if [[ -n "${METRICS:-}" ]]; then cmd+=(-e METRICS="$METRICS"); fi
+if [[ -n "${LAZY_IDLE_MS:-}" ]]; then cmd+=(-e LAZY_IDLE_MS="$LAZY_IDLE_MS"); fi
+if [[ -n "${KEYFRAME_JOIN_MIN_MS:-}" ]]; then cmd+=(-e KEYFRAME_JOIN_MIN_MS="$KEYFRAME_JOIN_MIN_MS"); fi
+if [[ -n "${RTSP_THREADS:-}" ]]; then cmd+=(-e RTSP_THREADS="$RTSP_THREADS"); fi
+if [[ -n "${RECORD_DIR:-}" ]]; then cmd+=(-e RECORD_DIR="$RECORD_DIR"); fi
+if [[ -n "${RECORD_SEGMENT_S:-}" ]]; then cmd+=(-e RECORD_SEGMENT_S="$RECORD_SEGMENT_S"); fi
+if [[ -n "${RECORD_MAX_FILES:-}" ]]; then cmd+=(-e RECORD_MAX_FILES="$RECORD_MAX_FILES"); fi
+if [[ -n "${INFER_ADAPT:-}" ]]; then cmd+=(-e INFER_ADAPT="$INFER_ADAPT"); fi
+if [[ -n "${INFER_BUDGET_MS:-}" ]]; then cmd+=(-e INFER_BUDGET_MS="$INFER_BUDGET_MS"); fi
+if [[ -n "${INFER_MAX_INTERVAL:-}" ]]; then cmd+=(-e INFER_MAX_INTERVAL="$INFER_MAX_INTERVAL"); fi
+if [[ -n "${PUSH_TIMEOUT_ADAPT:-}" ]]; then cmd+=(-e PUSH_TIMEOUT_ADAPT="$PUSH_TIMEOUT_ADAPT"); fi
+if [[ -n "${PUSH_TIMEOUT_MIN_MS:-}" ]]; then cmd+=(-e PUSH_TIMEOUT_MIN_MS="$PUSH_TIMEOUT_MIN_MS"); fi
+if [[ -n "${PUSH_TIMEOUT_MAX_MS:-}" ]]; then cmd+=(-e PUSH_TIMEOUT_MAX_MS="$PUSH_TIMEOUT_MAX_MS"); fi
+if [[ -n "${SNAPSHOT_TTL_MS:-}" ]]; then cmd+=(-e SNAPSHOT_TTL_MS="$SNAPSHOT_TTL_MS"); fi
+if [[ -n "${SNAPSHOT_CACHE_KB:-}" ]]; then cmd+=(-e SNAPSHOT_CACHE_KB="$SNAPSHOT_CACHE_KB"); fi
+if [[ -n "${SNAPSHOT_THREADS:-}" ]]; then cmd+=(-e SNAPSHOT_THREADS="$SNAPSHOT_THREADS"); fi
+if [[ -n "${SHARDS:-}" ]]; then cmd+=(-e SHARDS="$SHARDS"); fi
+if [[ -n "${SHARD_BATCH:-}" ]]; then cmd+=(-e SHARD_BATCH="$SHARD_BATCH"); fi
+if [[ -n "${REST_PORT:-}" ]]; then cmd+=(-e REST_PORT="$REST_PORT"); fi
 if [[ -n "${MAX_STREAMS:-}" ]]; then cmd+=(-e MAX_STREAMS="$MAX_STREAMS"); fi
 if [[ -n "${CTRL_PORT:-}" ]]; then cmd+=(-e CTRL_PORT="$CTRL_PORT"); fi
+if [[ -n "${CTRL_TIMEOUT_MS:-}" ]]; then cmd+=(-e CTRL_TIMEOUT_MS="$CTRL_TIMEOUT_MS"); fi
+if [[ -n "${CTRL_MAX_REQUEST_BYTES:-}" ]]; then cmd+=(-e CTRL_MAX_REQUEST_BYTES="$CTRL_MAX_REQUEST_BYTES"); fi
+if [[ -n "${CTRL_MAX_CONNS:-}" ]]; then cmd+=(-e CTRL_MAX_CONNS="$CTRL_MAX_CONNS"); fi
+if [[ -n "${REST_PORTS:-}" ]]; then cmd+=(-e REST_PORTS="$REST_PORTS"); fi
+if [[ -n "${REST_RETRIES:-}" ]]; then cmd+=(-e REST_RETRIES="$REST_RETRIES"); fi
+if [[ -n "${REST_BACKOFF_MS:-}" ]]; then cmd+=(-e REST_BACKOFF_MS="$REST_BACKOFF_MS"); fi
 
 "${cmd[@]}"
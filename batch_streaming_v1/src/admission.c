@@ -0,0 +1,154 @@
+// Encoder admission scheduler (L2)
+// - Startup: measure x264 frames/s on one core at branch resolution.
+// - Runtime: sample host CPU from /proc/stat once a second.
+// - Per add: NVENC while sessions remain, else x264 if both the cost model and the
+//   live idle CPU leave room, else reject with a Retry-After hint.
+#include <gst/gst.h>
+#include <stdio.h>
+#include "log.h"
+#include "config.h"
+#include "admission.h"
+
+#define ADMISSION_RETRY_BUSY_S 5   // live CPU short: about one sample window of churn
+#define ADMISSION_RETRY_FULL_S 30  // model full: a stream has to leave first
+#define ADMISSION_FALLBACK_FPS_PER_CORE 60.0
+
+static GMutex s_lock;
+static AdmissionModel s_model;
+static AdmissionLoad s_load;
+static guint64 s_prev_busy = 0, s_prev_total = 0;
+
+AdmitDecision admission_decide(const AdmissionModel *m, const AdmissionLoad *load) {
+  AdmitDecision d = { ADMIT_REJECT, ADMISSION_RETRY_FULL_S };
+  if (load->hw_active < m->hw_slots) { d.kind = ADMIT_HW; d.retry_after_s = 0; return d; }
+  if (m->sw_fps_per_core <= 0.0 || m->cores <= 0.0) return d;
+
+  gdouble cost = m->stream_fps / m->sw_fps_per_core; // cores per software stream
+  gdouble reserved = m->cores * m->reserve;
+  // Model: every admitted software stream costs `cost` cores.
+  if ((gdouble)(load->sw_active + 1) * cost > m->cores - reserved) return d;
+  // Live: that much must be idle right now (catches load the model does not see),
+  // after the streams admitted since the sample was taken take their share.
+  gdouble idle = m->cores * (1.0 - CLAMP(load->cpu_busy, 0.0, 1.0)) - (gdouble)load->sw_since_sample * cost;
+  if (idle - cost < reserved) { d.retry_after_s = ADMISSION_RETRY_BUSY_S; return d; }
+
+  d.kind = ADMIT_SW;
+  d.retry_after_s = 0;
+  return d;
+}
+
+// x264 frames/s on one thread with the branch encoder settings at branch resolution.
+static gdouble measure_x264(void) {
+  guint frames = MAX(30, config_env_uint("ADMISSION_CALIBRATE_FRAMES", 120));
+  gchar *desc = g_strdup_printf(
+    "videotestsrc num-buffers=%u pattern=ball ! video/x-raw,format=I420,width=1280,height=720,framerate=30/1 "
+    "! x264enc tune=zerolatency speed-preset=ultrafast bitrate=3000 key-int-max=30 bframes=0 threads=1 "
+    "! fakesink sync=false", frames);
+  GError *err = NULL;
+  GstElement *p = gst_parse_launch(desc, &err);
+  g_free(desc);
+  if (err) { LOG_WRN("Admission: calibration pipeline failed: %s", err->message); g_error_free(err); if (p) gst_object_unref(p); return 0.0; }
+
+  gint64 t0 = g_get_monotonic_time();
+  gst_element_set_state(p, GST_STATE_PLAYING);
+  GstBus *bus = gst_element_get_bus(p);
+  GstMessage *msg = gst_bus_timed_pop_filtered(bus, 30 * GST_SECOND, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  gint64 t1 = g_get_monotonic_time();
+  gboolean ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+  if (msg) gst_message_unref(msg);
+  gst_object_unref(bus);
+  gst_element_set_state(p, GST_STATE_NULL);
+  gst_object_unref(p);
+  if (!ok || t1 <= t0) { LOG_WRN("Admission: x264 calibration did not finish"); return 0.0; }
+  return (gdouble)frames * G_USEC_PER_SEC / (gdouble)(t1 - t0);
+}
+
+gdouble admission_calibrate_x264(void) {
+  gdouble fps = measure_x264();
+  return fps > 0.0 ? fps : ADMISSION_FALLBACK_FPS_PER_CORE;
+}
+
+static gboolean read_proc_stat(guint64 *busy, guint64 *total) {
+  FILE *f = fopen("/proc/stat", "r");
+  if (!f) return FALSE;
+  guint64 v[8] = { 0 };
+  int n = fscanf(f, "cpu %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT
+                    " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT " %" G_GUINT64_FORMAT,
+                 &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+  fclose(f);
+  if (n < 4) return FALSE;
+  *total = 0;
+  for (int i = 0; i < 8; ++i) *total += v[i];
+  *busy = *total - v[3] - v[4]; // minus idle and iowait
+  return TRUE;
+}
+
+static gboolean on_cpu_sample(gpointer data) {
+  (void)data;
+  guint64 busy = 0, total = 0;
+  if (!read_proc_stat(&busy, &total)) return G_SOURCE_CONTINUE;
+  if (s_prev_total > 0 && total > s_prev_total) {
+    gdouble frac = (gdouble)(busy - s_prev_busy) / (gdouble)(total - s_prev_total);
+    g_mutex_lock(&s_lock);
+    s_load.cpu_busy = CLAMP(frac, 0.0, 1.0);
+    s_load.sw_since_sample = 0; // now part of cpu_busy
+    g_mutex_unlock(&s_lock);
+  }
+  s_prev_busy = busy; s_prev_total = total;
+  return G_SOURCE_CONTINUE;
+}
+
+void admission_init(guint hw_slots) {
+  AdmissionModel m;
+  GstElementFactory *nvenc = gst_element_factory_find("nvv4l2h264enc");
+  m.hw_slots = nvenc ? hw_slots : 0;
+  if (nvenc) gst_object_unref(nvenc);
+  m.stream_fps = (gdouble) MAX(1, config_env_uint("ADMISSION_STREAM_FPS", 30));
+  const gchar *cores = g_getenv("ADMISSION_CORES"); // fractional for shards (a share of the host)
+  m.cores = cores && *cores ? g_ascii_strtod(cores, NULL) : (gdouble) g_get_num_processors();
+  m.reserve = MIN(config_env_uint("ADMISSION_RESERVE_PCT", 15), 90u) / 100.0;
+  m.sw_fps_per_core = (gdouble) config_env_uint("ADMISSION_SW_FPS_PER_CORE", 0);
+  if (m.sw_fps_per_core <= 0.0) m.sw_fps_per_core = admission_calibrate_x264();
+  g_mutex_lock(&s_lock);
+  s_model = m;
+  g_mutex_unlock(&s_lock);
+  LOG_INF("Admission: NVENC=%u, x264 %.0f fps/core @720p, %.0f fps/stream -> ~%.1f SW streams on %.0f cores (%.0f%% reserved)",
+          m.hw_slots, m.sw_fps_per_core, m.stream_fps,
+          (m.cores * (1.0 - m.reserve)) * m.sw_fps_per_core / m.stream_fps, m.cores, m.reserve * 100.0);
+  on_cpu_sample(NULL);
+  g_timeout_add_seconds(1, on_cpu_sample, NULL);
+}
+
+AdmitDecision admission_admit(void) {
+  g_mutex_lock(&s_lock);
+  AdmitDecision d = admission_decide(&s_model, &s_load);
+  if (d.kind == ADMIT_HW) s_load.hw_active++;
+  else if (d.kind == ADMIT_SW) { s_load.sw_active++; s_load.sw_since_sample++; }
+  g_mutex_unlock(&s_lock);
+  return d;
+}
+
+void admission_settle(AdmitKind reserved, gboolean actual_hw) {
+  g_mutex_lock(&s_lock);
+  if (reserved == ADMIT_HW && !actual_hw && s_load.hw_active > 0) {
+    s_load.hw_active--; s_load.sw_active++; s_load.sw_since_sample++;
+  } else if (reserved == ADMIT_SW && actual_hw && s_load.sw_active > 0) {
+    s_load.sw_active--; s_load.hw_active++;
+    if (s_load.sw_since_sample > 0) s_load.sw_since_sample--;
+  }
+  g_mutex_unlock(&s_lock);
+}
+
+void admission_release(gboolean hw) {
+  g_mutex_lock(&s_lock);
+  if (hw && s_load.hw_active > 0) s_load.hw_active--;
+  else if (!hw && s_load.sw_active > 0) s_load.sw_active--;
+  g_mutex_unlock(&s_lock);
+}
+
+void admission_get(AdmissionModel *m, AdmissionLoad *load) {
+  g_mutex_lock(&s_lock);
+  if (m) *m = s_model;
+  if (load) *load = s_load;
+  g_mutex_unlock(&s_lock);
+}
@@ -0,0 +1,50 @@
+// Encoder admission: NVENC, x264 or reject, from measured encode cost + live CPU load
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <glib.h>
+
+typedef enum { ADMIT_HW, ADMIT_SW, ADMIT_REJECT } AdmitKind;
+
+typedef struct {
+  guint hw_slots;            // NVENC sessions we may open (HW_THRESHOLD)
+  gdouble sw_fps_per_core;   // x264 frames/s on one core at branch resolution (calibrated)
+  gdouble stream_fps;        // frames/s each stream must sustain
+  gdouble cores;             // cores available to software encoders
+  gdouble reserve;           // fraction of cores kept free for the rest of the process
+} AdmissionModel;
+
+typedef struct {
+  guint hw_active;           // NVENC branches admitted
+  guint sw_active;           // software branches admitted
+  gdouble cpu_busy;          // host CPU utilisation over the last sample window, 0..1
+  guint sw_since_sample;     // software branches admitted since the last CPU sample, not yet in cpu_busy
+} AdmissionLoad;
+
+typedef struct {
+  AdmitKind kind;
+  guint retry_after_s;       // only for ADMIT_REJECT
+} AdmitDecision;
+
+// Pure decision for one more stream given the model and current load.
+AdmitDecision admission_decide(const AdmissionModel *m, const AdmissionLoad *load);
+
+// x264 frames/s on one core (a few seconds of encoding; a fixed fallback if the
+// pipeline fails). Call after gst_init.
+gdouble admission_calibrate_x264(void);
+
+// Calibrates x264 (unless ADMISSION_SW_FPS_PER_CORE is set) and starts CPU sampling
+// on the default main context. Call after gst_init.
+void admission_init(guint hw_slots);
+
+// Decide and reserve: the returned kind is counted as active until released.
+// Software streams admitted since the last CPU sample (by any request) count
+// against the live idle CPU, which cannot show their cost yet.
+AdmitDecision admission_admit(void);
+// Correct a reservation when the branch ended up on the other encoder kind.
+void admission_settle(AdmitKind reserved, gboolean actual_hw);
+void admission_release(gboolean hw);
+
+void admission_get(AdmissionModel *m, AdmissionLoad *load);
+
+#endif // ADMISSION_H
@@ -6,6 +6,17 @@
 #include "config.h"
 #include "branch.h"
 #include "control.h"
+#include "rest_client.h"
+#include "admission.h"
+#include "cpu_budget.h"
+#include "metrics.h"
+#include "overload.h"
+#include "lazy.h"
+#include "status.h"
+#include "record.h"
+#include "infer.h"
+#include "push_timeout.h"
+#include "snapshot.h"
 
 // Define shared state (declared in state.h)
 GstPipeline *g_pipeline = NULL;
@@ -13,13 +24,14 @@ GstElement  *g_pre_bin = NULL;
 GstElement  *g_demux = NULL;
 GstRTSPServer *g_rtsp_server = NULL;
 guint g_rtsp_port = 0;
-guint g_next_index = 0;
 guint g_base_udp_port_glb = 5000;
+gboolean g_handoff_appsrc = FALSE;
+gboolean g_backend_cpu = FALSE;
+gboolean g_rest_mock = FALSE;
 GMutex g_state_lock;
 guint g_ctrl_port = 0;
 const gchar *g_public_host = NULL;
 guint g_hw_threshold = 8;
-guint g_sw_max = 56;
 guint g_max_streams = 64;
 StreamInfo g_streams[64];
 
@@ -32,17 +44,22 @@ static gboolean have_factory(const char *name) {
   return FALSE;
 }
 
-gboolean sanity_check_plugins(void) {
-  const char *required[] = { "nvstreamdemux", "nvosdbin", "nvvideoconvert", "rtph264pay", "h264parse", "udpsink", NULL };
+gboolean sanity_check_plugins(const AppConfig *cfg) {
+  const char *required_gpu[] = { "nvstreamdemux", "nvosdbin", "nvvideoconvert", "rtph264pay", "h264parse", "udpsink", NULL };
+  const char *required_cpu[] = { "videotestsrc", "identity", "tee", "videoconvert", "rtph264pay", "h264parse", "udpsink", NULL };
+  const char **required = cfg->backend_cpu ? required_cpu : required_gpu;
   for (int i = 0; required[i]; ++i) {
     if (!have_factory(required[i])) {
       LOG_ERR("Missing required GStreamer element: %s", required[i]);
       return FALSE;
     }
   }
-  if (!have_factory("nvv4l2h264enc")) {
+  if (!cfg->backend_cpu && !have_factory("nvv4l2h264enc")) {
     LOG_WRN("NVENC encoder not found; hardware streams will not be available");
   }
+  if (!have_factory("splitmuxsink")) {
+    LOG_WRN("splitmuxsink not found; /streams/{index}/record will fail");
+  }
   if (!(have_factory("x264enc") || have_factory("avenc_h264") || have_factory("openh264enc"))) {
     LOG_ERR("No software H.264 encoder found (x264enc|avenc_h264|openh264enc)");
     return FALSE;
@@ -78,35 +95,43 @@ static void on_bus_message(GstBus *bus, GstMessage *msg, gpointer user_data) {
   }
 }
 
-// --- Capacity (hard limits)
+// --- Capacity (hard limits; software streams are admitted by measured cost, see admission.c)
 void decide_max_streams(void) {
   g_hw_threshold = 8;
-  g_sw_max = 56;
-  g_max_streams = g_hw_threshold + g_sw_max;
+  g_max_streams = G_N_ELEMENTS(g_streams);
 
   const gchar *env_hw = g_getenv("HW_THRESHOLD");
-  const gchar *env_sw = g_getenv("SW_MAX");
   const gchar *env_total = g_getenv("MAX_STREAMS");
   if (env_hw) g_hw_threshold = (guint) g_ascii_strtoull(env_hw, NULL, 10);
-  if (env_sw) g_sw_max = (guint) g_ascii_strtoull(env_sw, NULL, 10);
-  g_max_streams = g_hw_threshold + g_sw_max;
-  if (env_total) g_max_streams = (guint) g_ascii_strtoull(env_total, NULL, 10);
+  if (env_total) g_max_streams = MIN((guint) g_ascii_strtoull(env_total, NULL, 10), (guint)G_N_ELEMENTS(g_streams));
+  if (g_getenv("SW_MAX")) LOG_WRN("SW_MAX is ignored: software encoders are admitted by measured CPU cost (ADMISSION_*)");
 
-  LOG_INF("Capacity (hard limits): HW=%u, SW=%u, total=%u", g_hw_threshold, g_sw_max, g_max_streams);
+  LOG_INF("Capacity (hard limits): HW=%u, total=%u", g_hw_threshold, g_max_streams);
 }
 
 // --- Build pipeline + RTSP server (no external pipeline.txt)
 gboolean build_full_pipeline_and_server(const AppConfig *cfg, GstPipeline **out_pipeline, GstRTSPServer **out_server) {
   // Build pre-demux chain in one go for readability. It uses:
   // nvmultiurisrcbin ! nvinfer (pgie) ! nvstreamdemux name=demux
-  const gchar *pre_desc =
-    "nvmultiurisrcbin max-batch-size=64 batched-push-timeout=33000 width=1280 height=720 "
+  // or, with BACKEND=cpu, one test pattern fanned out by a tee standing in for demux
+  // (tee request pads are src_%u as well, so branches attach unchanged).
+  const gchar *pre_desc_cpu =
+    "videotestsrc is-live=true pattern=ball "
+    "! video/x-raw,format=I420,width=1280,height=720,framerate=30/1 "
+    "! identity name=pgie "
+    "! tee name=demux allow-not-linked=true";
+  // Batch sized to the stream cap (a shard runs a slice of the full 64).
+  gchar *rest_port = cfg->rest_port ? g_strdup_printf("port=%u ", cfg->rest_port) : g_strdup("");
+  gchar *pre_desc = cfg->backend_cpu ? g_strdup(pre_desc_cpu) : g_strdup_printf(
+    "nvmultiurisrcbin name=src max-batch-size=%u %sbatched-push-timeout=33000 width=1280 height=720 "
     "live-source=1 file-loop=true sync-inputs=false attach-sys-ts=true drop-on-latency=false "
-    "! nvinfer config-file-path=/opt/nvidia/deepstream/deepstream-8.0/pgie.txt "
-    "! nvstreamdemux name=demux";
+    "! nvinfer name=pgie config-file-path=/opt/nvidia/deepstream/deepstream-8.0/pgie.txt "
+    "! nvstreamdemux name=demux", MAX(1u, g_max_streams), rest_port);
+  g_free(rest_port);
 
   GError *err = NULL;
   GstElement *pre = gst_parse_launch(pre_desc, &err);
+  g_free(pre_desc);
   if (err) {
     LOG_ERR("Failed to parse pre-demux pipeline: %s", err->message);
     g_error_free(err);
@@ -119,7 +144,7 @@ gboolean build_full_pipeline_and_server(const AppConfig *cfg, GstPipeline **out_
   // Find demux
   GstElement *demux = gst_bin_get_by_name(GST_BIN(pipeline), "demux");
   if (!demux) {
-    LOG_ERR("Could not find 'demux' (nvstreamdemux name=demux)");
+    LOG_ERR("Could not find 'demux' (nvstreamdemux|tee name=demux)");
     gst_object_unref(pipeline);
     return FALSE;
   }
@@ -127,6 +152,11 @@ gboolean build_full_pipeline_and_server(const AppConfig *cfg, GstPipeline **out_
   // RTSP server wrapping UDP ports
   GstRTSPServer *server = gst_rtsp_server_new();
   gst_rtsp_server_set_address(server, "0.0.0.0");
+  // Client sockets, RTSP requests and RTCP run on pool threads (each with its own
+  // context) rather than all on the default main context.
+  GstRTSPThreadPool *pool = gst_rtsp_server_get_thread_pool(server);
+  gst_rtsp_thread_pool_set_max_threads(pool, (gint)cfg->rtsp_threads);
+  g_object_unref(pool);
   guint chosen_port = cfg->rtsp_port;
   guint attach_id = 0;
   for (guint attempt = 0; attempt < 10 && attach_id == 0; ++attempt) {
@@ -159,7 +189,7 @@ gboolean build_full_pipeline_and_server(const AppConfig *cfg, GstPipeline **out_
 
   *out_pipeline = pipeline;
   *out_server = server;
-  LOG_INF("Pipeline READY. RTSP server on %u", chosen_port);
+  LOG_INF("Pipeline READY. RTSP server on %u (%u client threads)", chosen_port, cfg->rtsp_threads);
   return TRUE;
 }
 
@@ -173,11 +203,31 @@ static gboolean on_signal_cb(gpointer data) {
 
 // --- App lifecycle
 gboolean app_setup(const AppConfig *cfg) {
+  g_backend_cpu = cfg->backend_cpu;
+  g_rest_mock = cfg->backend_cpu && cfg->rest_mock;
+  if (g_backend_cpu) LOG_INF("Backend: CPU test (videotestsrc ! identity ! tee; no NVENC, %s)", g_rest_mock ? "REST to a mock server" : "no REST");
+  if (g_getenv("SHARD_INDEX")) LOG_INF("Shard %s: RTSP %u, UDP from %u", g_getenv("SHARD_INDEX"), cfg->rtsp_port, cfg->base_udp_port);
   decide_max_streams();
+  admission_init(g_backend_cpu ? 0 : g_hw_threshold);
+  cpu_budget_init();
+  metrics_init();
+  overload_init();
+  lazy_init();
+  record_init();
+  infer_init();
+  push_timeout_init();
+  snapshot_init();
 
   GstPipeline *pipeline = NULL; GstRTSPServer *server = NULL;
   if (!build_full_pipeline_and_server(cfg, &pipeline, &server)) return FALSE;
 
+  GstElement *pgie = gst_bin_get_by_name(GST_BIN(pipeline), "pgie");
+  infer_attach(pgie);
+  if (pgie) gst_object_unref(pgie);
+  GstElement *src = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+  push_timeout_attach(src);
+  if (src) gst_object_unref(src);
+
   // Attach bus handler for logs
   GstBus *bus = gst_element_get_bus(GST_ELEMENT(pipeline));
   gst_bus_add_signal_watch(bus);
@@ -192,14 +242,21 @@ gboolean app_setup(const AppConfig *cfg) {
   g_rtsp_server = server;
   g_rtsp_port = cfg->rtsp_port; // will be updated below from server service
   g_base_udp_port_glb = cfg->base_udp_port;
+  g_handoff_appsrc = cfg->handoff_appsrc;
+  LOG_INF("RTSP hand-off: %s", g_handoff_appsrc ? "in-process (appsink -> appsrc)" : "UDP loopback");
   g_demux = gst_bin_get_by_name(GST_BIN(pipeline), "demux");
   g_pre_bin = GST_ELEMENT(gst_element_get_parent(g_demux));
-  g_next_index = 0;
   g_public_host = cfg->public_host;
+  lazy_watch_server(server);
   const gchar *service = gst_rtsp_server_get_service(server);
   if (service) g_rtsp_port = (guint) g_ascii_strtoull(service, NULL, 10);
 
-  // Start minimal control API
+  g_mutex_lock(&g_state_lock);
+  status_publish();
+  g_mutex_unlock(&g_state_lock);
+
+  // Start minimal control API (REST client first: handlers post through it)
+  rest_client_init();
   (void)g_thread_new("ctrl_http", control_http_thread, NULL);
 
   // Create main loop + signals
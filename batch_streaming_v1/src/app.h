@@ -6,7 +6,7 @@
 #include <gst/rtsp-server/rtsp-server.h>
 #include "config.h"
 
-gboolean sanity_check_plugins(void);
+gboolean sanity_check_plugins(const AppConfig *cfg);
 void decide_max_streams(void);
 gboolean build_full_pipeline_and_server(const AppConfig *cfg, GstPipeline **out_pipeline, GstRTSPServer **out_server);
 
@@ -1,36 +1,202 @@
 // Per-stream branch building (L2)
 #include "log.h"
 #include "state.h"
+#include "config.h"
+#include "cpu_budget.h"
+#include "metrics.h"
+#include "overload.h"
+#include "lazy.h"
+#include "status.h"
+#include "record.h"
+#include "latency.h"
+#include "snapshot.h"
 #include <gst/gst.h>
+#include <gst/app/app.h>
+#include <gst/video/video.h>
 #include <string.h>
 
 typedef struct {
-  GstElement *queue, *conv_pre, *caps_pre, *osd, *conv_post, *caps_post;
-  GstElement *conv_cpu, *caps_cpu, *enc, *parse, *pay, *udp;
+  GstElement *queue, *slow, *valve, *rate, *conv_pre, *caps_pre, *osd, *conv_post, *caps_post;
+  GstElement *conv_cpu, *caps_cpu, *enc, *parse, *tee, *pay, *sink;
 } BranchElems;
 
-static guint get_env_uint(const char *name, guint defval) {
-  const gchar *e = g_getenv(name);
-  if (!e || !*e) return defval;
-  return (guint) g_ascii_strtoull(e, NULL, 10);
+// Slots handed out to streams (reserved before the branch exists, freed after teardown)
+static gboolean s_slot_taken[G_N_ELEMENTS(g_streams)];
+static guint s_slots_used = 0;
+
+gboolean branch_slots_acquire(guint n, guint *out_indices) {
+  gboolean ok = FALSE;
+  g_mutex_lock(&g_state_lock);
+  guint limit = MIN(g_max_streams, (guint)G_N_ELEMENTS(g_streams));
+  if (n > 0 && s_slots_used + n <= limit) {
+    guint got = 0;
+    for (guint i = 0; i < limit && got < n; ++i) {
+      if (s_slot_taken[i]) continue;
+      s_slot_taken[i] = TRUE;
+      out_indices[got++] = i;
+    }
+    s_slots_used += got;
+    ok = TRUE;
+  }
+  g_mutex_unlock(&g_state_lock);
+  return ok;
 }
 
-static gboolean create_elements(guint index, BranchElems *e, gboolean *enc_is_hw, gboolean *enc_is_x264, guint *out_port) {
+gboolean branch_slot_acquire(guint *out_index) {
+  return branch_slots_acquire(1, out_index);
+}
+
+void branch_slot_release(guint index) {
+  if (index >= G_N_ELEMENTS(g_streams)) return;
+  g_mutex_lock(&g_state_lock);
+  if (s_slot_taken[index] && !g_streams[index].in_use) {
+    s_slot_taken[index] = FALSE;
+    s_slots_used--;
+  }
+  g_mutex_unlock(&g_state_lock);
+}
+
+// --- appsrc hand-off (RTSP_HANDOFF=appsrc)
+// Encoded access units go from the branch appsink straight into the appsrc of the
+// mount's shared RTSP media, which payloads once. Nothing is sent while no media exists.
+// The per-slot target lives outside StreamInfo: media callbacks run on RTSP pool
+// threads and can still take the lock after remove has wiped and recycled the slot.
+typedef struct {
+  GMutex lock;          // static storage: never cleared, valid for the process lifetime
+  GstRTSPMedia *media;  // identity only (not reffed)
+  GstElement *src;      // reffed appsrc inside media
+} Handoff;
+
+static Handoff s_handoff[G_N_ELEMENTS(g_streams)];
+
+static GstFlowReturn on_handoff_sample(GstAppSink *sink, gpointer user_data) {
+  Handoff *h = &s_handoff[GPOINTER_TO_UINT(user_data)];
+  GstSample *sample = gst_app_sink_pull_sample(sink);
+  if (!sample) return GST_FLOW_OK;
+  g_mutex_lock(&h->lock);
+  GstElement *src = h->src ? gst_object_ref(h->src) : NULL;
+  g_mutex_unlock(&h->lock);
+  if (src) {
+    // Shallow copy shares the encoded memory; the media restamps it (do-timestamp)
+    // because branch timestamps are in the main pipeline's running time.
+    GstBuffer *buf = gst_buffer_copy(gst_sample_get_buffer(sample));
+    GST_BUFFER_PTS(buf) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_DTS(buf) = GST_CLOCK_TIME_NONE;
+    (void)gst_app_src_push_buffer(GST_APP_SRC(src), buf);
+    gst_object_unref(src);
+  }
+  gst_sample_unref(sample);
+  return GST_FLOW_OK;
+}
+
+// media NULL: whatever is attached (branch teardown).
+static void handoff_detach(guint index, GstRTSPMedia *media) {
+  Handoff *h = &s_handoff[index];
+  GstElement *old = NULL;
+  g_mutex_lock(&h->lock);
+  if (!media || h->media == media) {
+    old = h->src;
+    h->src = NULL;
+    h->media = NULL;
+  }
+  g_mutex_unlock(&h->lock);
+  if (old) gst_object_unref(old);
+}
+
+static void on_handoff_media_unprepared(GstRTSPMedia *media, gpointer user_data) {
+  handoff_detach(GPOINTER_TO_UINT(user_data), media);
+}
+
+static void on_handoff_media_configure(GstRTSPMediaFactory *factory, GstRTSPMedia *media, gpointer user_data) {
+  (void)factory;
+  Handoff *h = &s_handoff[GPOINTER_TO_UINT(user_data)];
+  GstElement *bin = gst_rtsp_media_get_element(media);
+  GstElement *src = gst_bin_get_by_name(GST_BIN(bin), "src");
+  gst_object_unref(bin);
+  if (!src) { LOG_ERR("RTSP hand-off: media has no appsrc 'src'"); return; }
+  g_object_set(src, "format", GST_FORMAT_TIME, "is-live", TRUE, "do-timestamp", TRUE, "max-bytes", (guint64)(2 * 1024 * 1024), NULL);
+  if (g_object_class_find_property(G_OBJECT_GET_CLASS(src), "leaky-type")) {
+    gst_util_set_object_arg(G_OBJECT(src), "leaky-type", "downstream");
+  }
+  GstElement *old = NULL;
+  g_mutex_lock(&h->lock);
+  old = h->src;
+  h->src = src; // takes the ref from gst_bin_get_by_name
+  h->media = media;
+  g_mutex_unlock(&h->lock);
+  if (old) gst_object_unref(old);
+  g_signal_connect(media, "unprepared", G_CALLBACK(on_handoff_media_unprepared), user_data);
+}
+
+static const EncoderConfig k_default_enc_cfg = { 3000, 30, 0, "ultrafast" };
+
+// Encoder properties from cfg (full bitrate; the overload ladder scales it later).
+static void configure_encoder(GstElement *enc, gboolean is_hw, gboolean is_x264, guint x264_threads, const EncoderConfig *cfg) {
+  if (is_hw) {
+    g_object_set(enc,
+      "insert-sps-pps", 1,
+      "iframeinterval", cfg->gop,
+      "idrinterval", cfg->gop,
+      "bitrate", cfg->bitrate_kbps * 1000,
+      "maxperf-enable", 1,
+      "control-rate", 1,
+      "preset-level", 1,
+      NULL);
+  } else if (is_x264) {
+    gst_util_set_object_arg(G_OBJECT(enc), "tune", "zerolatency");
+    gst_util_set_object_arg(G_OBJECT(enc), "speed-preset", cfg->preset);
+    g_object_set(enc, "bitrate", cfg->bitrate_kbps, "key-int-max", cfg->gop, "bframes", 0, "threads", x264_threads, NULL);
+    GObjectClass *klass = G_OBJECT_GET_CLASS(enc);
+    if (g_object_class_find_property(klass, "sliced-threads")) {
+      g_object_set(enc, "sliced-threads", TRUE, NULL);
+    }
+  } else {
+    g_object_set(enc, "bitrate", cfg->bitrate_kbps * 1000, NULL);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(enc), "gop-size")) g_object_set(enc, "gop-size", cfg->gop, NULL);
+  }
+}
+
+// BACKEND=cpu test hook: SLOW_BRANCH=<index>:<ms> -> per-frame stall for that branch.
+static guint slow_branch_ms(guint index) {
+  const gchar *env = g_getenv("SLOW_BRANCH");
+  gchar **kv = env ? g_strsplit(env, ":", 2) : NULL;
+  guint ms = 0;
+  if (kv && kv[0] && kv[1] && g_ascii_strtoull(kv[0], NULL, 10) == index) ms = (guint) g_ascii_strtoull(kv[1], NULL, 10);
+  g_strfreev(kv);
+  return ms;
+}
+
+static gboolean create_elements(guint index, gboolean want_hw, guint x264_threads, BranchElems *e, gboolean *enc_is_hw, gboolean *enc_is_x264, guint *out_port) {
   memset(e, 0, sizeof(*e));
   *enc_is_hw = FALSE;
   *enc_is_x264 = FALSE;
 
-  e->queue = gst_element_factory_make("queue", NULL);
-  e->conv_pre = gst_element_factory_make("nvvideoconvert", NULL);
-  e->caps_pre = gst_element_factory_make("capsfilter", NULL);
-  e->osd = gst_element_factory_make("nvosdbin", NULL);
-  e->conv_post = gst_element_factory_make("nvvideoconvert", NULL);
-  e->caps_post = gst_element_factory_make("capsfilter", NULL);
-  e->conv_cpu = gst_element_factory_make("nvvideoconvert", NULL);
+  // Named so its streaming thread reads "q_sN:src" (cpu_budget pins by thread name)
+  gchar *qname = g_strdup_printf("q_s%u", index);
+  e->queue = gst_element_factory_make("queue", qname);
+  g_free(qname);
+  // Sleeps in the queue's streaming thread, like an encoder that cannot keep up.
+  guint slow_ms = g_backend_cpu ? slow_branch_ms(index) : 0;
+  if (slow_ms) {
+    e->slow = gst_element_factory_make("identity", NULL);
+    if (e->slow) g_object_set(e->slow, "sleep-time", slow_ms * 1000, NULL);
+    LOG_WRN("SLOW_BRANCH: /s%u stalls %ums per frame", index, slow_ms);
+  }
+  if (lazy_enabled()) e->valve = gst_element_factory_make("valve", NULL);
+  e->rate = gst_element_factory_make("videorate", NULL);
+  // CPU backend: frames are already in system memory, so only the I420 pair remains.
+  if (!g_backend_cpu) {
+    e->conv_pre = gst_element_factory_make("nvvideoconvert", NULL);
+    e->caps_pre = gst_element_factory_make("capsfilter", NULL);
+    e->osd = gst_element_factory_make("nvosdbin", NULL);
+    e->conv_post = gst_element_factory_make("nvvideoconvert", NULL);
+    e->caps_post = gst_element_factory_make("capsfilter", NULL);
+  }
+  e->conv_cpu = gst_element_factory_make(g_backend_cpu ? "videoconvert" : "nvvideoconvert", NULL);
   e->caps_cpu = gst_element_factory_make("capsfilter", NULL);
 
-  // Encoder selection (HW for first g_hw_threshold)
-  if (index < g_hw_threshold) {
+  // Encoder selection (admission decides; software fallbacks if NVENC is unavailable)
+  if (want_hw && !g_backend_cpu) {
     e->enc = gst_element_factory_make("nvv4l2h264enc", NULL);
     *enc_is_hw = (e->enc != NULL);
   }
@@ -49,160 +215,585 @@ static gboolean create_elements(guint index, BranchElems *e, gboolean *enc_is_hw
   }
 
   e->parse = gst_element_factory_make("h264parse", NULL);
-  e->pay = gst_element_factory_make("rtph264pay", NULL);
-  e->udp = gst_element_factory_make("udpsink", NULL);
+  e->tee = gst_element_factory_make("tee", NULL);
+  if (g_handoff_appsrc) {
+    e->sink = gst_element_factory_make("appsink", NULL);
+  } else {
+    e->pay = gst_element_factory_make("rtph264pay", NULL);
+    e->sink = gst_element_factory_make("udpsink", NULL);
+  }
 
-  if (!e->queue || !e->conv_pre || !e->caps_pre || !e->osd || !e->conv_post || !e->caps_post || !e->enc || !e->parse || !e->pay || !e->udp) {
+  gboolean nvmm_ok = g_backend_cpu || (e->conv_pre && e->caps_pre && e->osd && e->conv_post && e->caps_post);
+  if (!e->queue || !e->rate || !nvmm_ok || !e->conv_cpu || !e->caps_cpu || !e->enc || !e->parse || !e->tee || (!g_handoff_appsrc && !e->pay) || !e->sink) {
     LOG_ERR("Element creation failed for /s%u", index);
     return FALSE;
   }
 
   // Properties and caps
-  g_object_set(e->queue, "leaky", 0, "max-size-time", (guint64)200000000, "max-size-buffers", 0, "max-size-bytes", 0, NULL);
-  GstCaps *caps_rgba = gst_caps_from_string("video/x-raw(memory:NVMM),format=RGBA");
-  g_object_set(e->caps_pre, "caps", caps_rgba, NULL);
-  gst_caps_unref(caps_rgba);
-  GstCaps *caps_nv12 = gst_caps_from_string("video/x-raw(memory:NVMM),format=NV12");
-  g_object_set(e->caps_post, "caps", caps_nv12, NULL);
-  gst_caps_unref(caps_nv12);
+  // Leaky downstream (default): a lagging branch drops its oldest frames rather than blocking demux.
+  g_object_set(e->queue, "leaky", overload_queue_leaky() ? 2 : 0, "max-size-time", overload_queue_time_ns(), "max-size-buffers", 0, "max-size-bytes", 0, NULL);
+  g_object_set(e->rate, "drop-only", TRUE, "skip-to-first", TRUE, NULL);
+  if (!g_backend_cpu) {
+    GstCaps *caps_rgba = gst_caps_from_string("video/x-raw(memory:NVMM),format=RGBA");
+    g_object_set(e->caps_pre, "caps", caps_rgba, NULL);
+    gst_caps_unref(caps_rgba);
+    GstCaps *caps_nv12 = gst_caps_from_string("video/x-raw(memory:NVMM),format=NV12");
+    g_object_set(e->caps_post, "caps", caps_nv12, NULL);
+    gst_caps_unref(caps_nv12);
+  }
 
   if (*enc_is_hw) {
-    g_object_set(e->enc,
-      "insert-sps-pps", 1,
-      "iframeinterval", 30,
-      "idrinterval", 30,
-      "bitrate", 3000000,
-      "maxperf-enable", 1,
-      "control-rate", 1,
-      "preset-level", 1,
-      NULL);
+    // NVMM straight into NVENC: the CPU converter pair is not part of this branch
+    g_clear_pointer(&e->conv_cpu, gst_object_unref);
+    g_clear_pointer(&e->caps_cpu, gst_object_unref);
   } else {
     GstCaps *caps_i420 = gst_caps_from_string("video/x-raw,format=I420");
     g_object_set(e->caps_cpu, "caps", caps_i420, NULL);
     gst_caps_unref(caps_i420);
-    if (*enc_is_x264) {
-      guint cores = (guint) g_get_num_processors();
-      guint def_threads = cores > 1 ? (cores / 2) : 1; if (def_threads > 4) def_threads = 4; if (def_threads < 1) def_threads = 1;
-      guint threads = get_env_uint("X264_THREADS", def_threads);
-      g_object_set(e->enc, "tune", "zerolatency", "speed-preset", "ultrafast", "bitrate", 3000, "key-int-max", 30, "bframes", 0, "threads", threads, NULL);
-      GObjectClass *klass = G_OBJECT_GET_CLASS(e->enc);
-      if (g_object_class_find_property(klass, "sliced-threads")) {
-        g_object_set(e->enc, "sliced-threads", TRUE, NULL);
-      }
-    } else {
-      g_object_set(e->enc, "bitrate", 3000000, NULL);
-    }
+  }
+  configure_encoder(e->enc, *enc_is_hw, *enc_is_x264, x264_threads, &k_default_enc_cfg);
+  if (g_handoff_appsrc) {
+    // Access units straight to the RTSP media; SPS/PPS ride along with every IDR.
+    g_object_set(e->parse, "config-interval", -1, NULL);
+    GstCaps *caps_au = gst_caps_from_string("video/x-h264,stream-format=byte-stream,alignment=au");
+    g_object_set(e->sink, "caps", caps_au, "sync", TRUE, "async", FALSE, "emit-signals", FALSE, "max-buffers", 2, "drop", TRUE, NULL);
+    gst_caps_unref(caps_au);
+    GstAppSinkCallbacks cbs = { .new_sample = on_handoff_sample };
+    gst_app_sink_set_callbacks(GST_APP_SINK(e->sink), &cbs, GUINT_TO_POINTER(index), NULL);
+    if (out_port) *out_port = 0;
+    return TRUE;
   }
   g_object_set(e->pay, "config-interval", 1, "pt", 96, NULL);
   guint port = g_base_udp_port_glb + index;
-  g_object_set(e->udp, "host", "127.0.0.1", "port", port, "sync", TRUE, "async", FALSE, NULL);
+  g_object_set(e->sink, "host", "127.0.0.1", "port", port, "sync", TRUE, "async", FALSE, NULL);
   if (out_port) *out_port = port;
   return TRUE;
 }
 
-static void cleanup_branch(const BranchElems *e, gboolean enc_is_hw) {
+// Branch elements in link order (queue first); unused slots are NULL and skipped.
+static guint branch_elems_list(const BranchElems *e, GstElement **out) {
+  GstElement *all[] = { e->queue, e->slow, e->valve, e->rate, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post,
+                        e->conv_cpu, e->caps_cpu, e->enc, e->parse, e->tee, e->pay, e->sink };
+  guint n = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(all); ++i) if (all[i]) out[n++] = all[i];
+  return n;
+}
+
+static void cleanup_branch(const BranchElems *e) {
   if (!e) return;
-  if (enc_is_hw) {
-    gst_bin_remove_many(GST_BIN(g_pre_bin), e->queue, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post, e->enc, e->parse, e->pay, e->udp, NULL);
-  } else {
-    gst_bin_remove_many(GST_BIN(g_pre_bin), e->queue, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post, e->conv_cpu, e->caps_cpu, e->enc, e->parse, e->pay, e->udp, NULL);
-  }
+  GstElement *els[17];
+  guint n = branch_elems_list(e, els);
+  for (guint i = 0; i < n; ++i) gst_element_set_state(els[i], GST_STATE_NULL);
+  for (guint i = 0; i < n; ++i) gst_bin_remove(GST_BIN(g_pre_bin), els[i]);
 }
 
-static gboolean link_branch(guint index, const BranchElems *e, gboolean enc_is_hw) {
-  gboolean ok = FALSE;
-  if (enc_is_hw) {
-    gst_bin_add_many(GST_BIN(g_pre_bin), e->queue, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post, e->enc, e->parse, e->pay, e->udp, NULL);
-    ok = gst_element_link_many(e->queue, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post, e->enc, e->parse, e->pay, e->udp, NULL);
-  } else {
-    gst_bin_add_many(GST_BIN(g_pre_bin), e->queue, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post, e->conv_cpu, e->caps_cpu, e->enc, e->parse, e->pay, e->udp, NULL);
-    ok = gst_element_link_many(e->queue, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post, e->conv_cpu, e->caps_cpu, e->enc, e->parse, e->pay, e->udp, NULL);
+static gboolean link_branch(const BranchElems *e) {
+  GstElement *els[17];
+  guint n = branch_elems_list(e, els);
+  for (guint i = 0; i < n; ++i) gst_bin_add(GST_BIN(g_pre_bin), els[i]);
+  for (guint i = 0; i + 1 < n; ++i) {
+    if (!gst_element_link(els[i], els[i + 1])) return FALSE;
   }
-  if (!ok) return FALSE;
+  return TRUE;
+}
 
+static void sync_branch(const BranchElems *e) {
+  GstElement *els[17];
+  guint n = branch_elems_list(e, els);
+  for (guint i = 0; i < n; ++i) gst_element_sync_state_with_parent(els[i]);
+}
+
+static gboolean attach_to_demux(guint index, const BranchElems *e) {
   gchar *padname = g_strdup_printf("src_%u", index);
   GstPad *demux_src = gst_element_request_pad_simple(g_demux, padname);
   g_free(padname);
   if (!demux_src) return FALSE;
   GstPad *queue_sink = gst_element_get_static_pad(e->queue, "sink");
-  if (!queue_sink) { gst_object_unref(demux_src); return FALSE; }
+  if (!queue_sink) { gst_element_release_request_pad(g_demux, demux_src); gst_object_unref(demux_src); return FALSE; }
   if (gst_pad_link(demux_src, queue_sink) != GST_PAD_LINK_OK) {
+    gst_element_release_request_pad(g_demux, demux_src);
     gst_object_unref(demux_src); gst_object_unref(queue_sink); return FALSE;
   }
   gst_object_unref(demux_src); gst_object_unref(queue_sink);
-
-  if (enc_is_hw) {
-    GstElement *els[] = { e->queue, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post, e->enc, e->parse, e->pay, e->udp, NULL };
-    for (int i = 0; els[i]; ++i) gst_element_sync_state_with_parent(els[i]);
-  } else {
-    GstElement *els[] = { e->queue, e->conv_pre, e->caps_pre, e->osd, e->conv_post, e->caps_post, e->conv_cpu, e->caps_cpu, e->enc, e->parse, e->pay, e->udp, NULL };
-    for (int i = 0; els[i]; ++i) gst_element_sync_state_with_parent(els[i]);
-  }
   return TRUE;
 }
 
-static gboolean mount_rtsp(const gchar *path, guint port) {
-  // Wrap the already-RTP H264 UDP stream by depayloading and re-payloading so the RTSP
-  // factory exposes a proper payloader named pay0 (as expected by gst-rtsp-server).
-  gchar *launch = g_strdup_printf(
-    "( udpsrc port=%u buffer-size=%lu caps=\"application/x-rtp, media=video, clock-rate=90000, encoding-name=H264, payload=96\" "
-    "! rtph264depay ! rtph264pay name=pay0 pt=96 )",
-    port, (unsigned long)(524288UL));
+static gboolean mount_rtsp(guint index, const gchar *path, guint port) {
+  gchar *launch;
+  if (g_handoff_appsrc) {
+    // Fed in-process by the branch appsink; the only payload pass is pay0 here.
+    launch = g_strdup(
+      "( appsrc name=src caps=\"video/x-h264, stream-format=byte-stream, alignment=au\" "
+      "! rtph264pay name=pay0 pt=96 config-interval=1 )");
+  } else {
+    // Wrap the already-RTP H264 UDP stream by depayloading and re-payloading so the RTSP
+    // factory exposes a proper payloader named pay0 (as expected by gst-rtsp-server).
+    launch = g_strdup_printf(
+      "( udpsrc port=%u buffer-size=%lu caps=\"application/x-rtp, media=video, clock-rate=90000, encoding-name=H264, payload=96\" "
+      "! rtph264depay ! rtph264pay name=pay0 pt=96 )",
+      port, (unsigned long)(524288UL));
+  }
   GstRTSPMountPoints *mounts = gst_rtsp_server_get_mount_points(g_rtsp_server);
   GstRTSPMediaFactory *factory = gst_rtsp_media_factory_new();
   gst_rtsp_media_factory_set_launch(factory, launch);
   gst_rtsp_media_factory_set_shared(factory, TRUE);
   gst_rtsp_media_factory_set_latency(factory, 100);
+  if (g_handoff_appsrc) {
+    g_signal_connect(factory, "media-configure", G_CALLBACK(on_handoff_media_configure), GUINT_TO_POINTER(index));
+  }
+  lazy_watch_factory(index, factory);
   gst_rtsp_mount_points_add_factory(mounts, path, factory);
   g_object_unref(mounts);
   g_free(launch);
   return TRUE;
 }
 
-gboolean add_branch_and_mount(guint index, gchar **out_path, gchar **out_url) {
+static void record_stream(guint index, const BranchElems *be, gboolean enc_is_hw, gboolean enc_is_x264, guint port, const gchar *path, const gchar *uri) {
+  StreamInfo *si = &g_streams[index];
+  si->in_use = TRUE;
+  si->enc_is_hw = enc_is_hw;
+  strncpy(si->enc_kind, enc_is_hw ? "nvenc" : (enc_is_x264 ? "x264" : (g_str_has_prefix(G_OBJECT_TYPE_NAME(be->enc), "GstAv") ? "avenc" : "openh264")), sizeof(si->enc_kind)-1);
+  si->enc_kind[sizeof(si->enc_kind)-1] = '\0';
+  si->enc_cfg = k_default_enc_cfg;
+  si->udp_port = port;
+  g_snprintf(si->path, sizeof(si->path), "%s", path);
+  si->uri = g_strdup(uri);
+  si->queue = be->queue;
+  si->slow = be->slow;
+  si->valve = be->valve;
+  si->rate = be->rate;
+  si->conv_pre = be->conv_pre;
+  si->caps_pre = be->caps_pre;
+  si->osd = be->osd;
+  si->conv_post = be->conv_post;
+  si->caps_post = be->caps_post;
+  si->conv_cpu = be->conv_cpu;
+  si->caps_cpu = be->caps_cpu;
+  si->enc = be->enc;
+  si->parse = be->parse;
+  si->tee = be->tee;
+  si->pay = be->pay;
+  si->sink = be->sink;
+}
+
+typedef struct {
+  BranchElems be;
+  gboolean enc_is_hw, enc_is_x264, linked;
+  guint port;
+} PendingBranch;
+
+guint add_branches_and_mount(const guint *indices, const gchar *const *uris, const gboolean *want_hw, guint n, gboolean *ok, gchar **out_paths, gchar **out_urls) {
+  for (guint i = 0; i < n; ++i) {
+    ok[i] = FALSE;
+    if (out_paths) out_paths[i] = NULL;
+    if (out_urls) out_urls[i] = NULL;
+  }
   g_mutex_lock(&g_state_lock);
   if (!g_pipeline || !g_demux || !g_pre_bin || !g_rtsp_server) {
+    g_mutex_unlock(&g_state_lock);
+    return 0;
+  }
+
+  // Build and link every branch first, then bring them all up in one state-sync
+  // pass, and only then attach them to demux so no branch sees data while NULL.
+  PendingBranch *pb = g_new0(PendingBranch, n);
+  guint n_sw = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(g_streams); ++i) if (g_streams[i].in_use && !g_streams[i].enc_is_hw) n_sw++;
+  for (guint i = 0; i < n; ++i) if (!want_hw[i]) n_sw++;
+  guint x264_threads = cpu_budget_threads_for(n_sw);
+  for (guint i = 0; i < n; ++i) {
+    guint index = indices[i];
+    if (!create_elements(index, want_hw[i], x264_threads, &pb[i].be, &pb[i].enc_is_hw, &pb[i].enc_is_x264, &pb[i].port)) continue;
+    if (!link_branch(&pb[i].be)) {
+      LOG_ERR("Link failed for /s%u (pre/osd/post/cpu/enc/rtp/udp)", index);
+      cleanup_branch(&pb[i].be);
+      continue;
+    }
+    pb[i].linked = TRUE;
+    metrics_branch_attach(index, pb[i].be.queue, pb[i].be.enc, pb[i].be.sink);
+    latency_branch_attach(index, pb[i].be.queue, pb[i].be.pay ? pb[i].be.pay : pb[i].be.sink);
+    snapshot_branch_attach(index, pb[i].be.tee);
+    overload_branch_reset(index);
+    lazy_branch_attach(index, pb[i].be.valve, pb[i].be.enc);
+  }
+  for (guint i = 0; i < n; ++i) if (pb[i].linked) sync_branch(&pb[i].be);
+
+  guint added = 0;
+  const gchar *host = g_public_host ? g_public_host : "127.0.0.1";
+  for (guint i = 0; i < n; ++i) {
+    if (!pb[i].linked) continue;
+    guint index = indices[i];
+    if (!attach_to_demux(index, &pb[i].be)) {
+      LOG_ERR("Link failed for demux src_%u -> /s%u", index, index);
+      lazy_branch_detach(index);
+      cleanup_branch(&pb[i].be);
+      continue;
+    }
+    if (g_handoff_appsrc) LOG_INF("Linked demux src_%u to in-process RTSP hand-off (dynamic)", index);
+    else LOG_INF("Linked demux src_%u to UDP egress port %u (dynamic)", index, pb[i].port);
+
+    gchar *path = g_strdup_printf("/s%u", index);
+    (void)mount_rtsp(index, path, pb[i].port);
+    if (g_handoff_appsrc) LOG_INF("RTSP mounted: rtsp://%s:%u%s (in-process H264 hand-off)", host, g_rtsp_port, path);
+    else LOG_INF("RTSP mounted: rtsp://%s:%u%s (udp-wrap H264 RTP @127.0.0.1:%u)", host, g_rtsp_port, path, pb[i].port);
+    if (out_paths) out_paths[i] = g_strdup(path);
+    if (out_urls) out_urls[i] = g_strdup_printf("rtsp://%s:%u%s", host, g_rtsp_port, path);
+    record_stream(index, &pb[i].be, pb[i].enc_is_hw, pb[i].enc_is_x264, pb[i].port, path, uris[i]);
+    g_free(path);
+    ok[i] = TRUE;
+    added++;
+  }
+
+  g_free(pb);
+  if (added > 0) { cpu_budget_rebalance(); status_publish(); }
+  g_mutex_unlock(&g_state_lock);
+  return added;
+}
+
+gboolean add_branch_and_mount(guint index, const gchar *uri, gboolean want_hw, gchar **out_path, gchar **out_url) {
+  gboolean ok = FALSE;
+  return add_branches_and_mount(&index, &uri, &want_hw, 1, &ok, out_path, out_url) == 1;
+}
+
+// --- Teardown
+// Branch elements in link order (queue first); returns the count.
+static guint stream_elements(const StreamInfo *si, GstElement **out) {
+  GstElement *all[] = { si->queue, si->slow, si->valve, si->rate, si->conv_pre, si->caps_pre, si->osd, si->conv_post, si->caps_post,
+                        si->conv_cpu, si->caps_cpu, si->enc, si->parse, si->tee, si->pay, si->sink };
+  guint n = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(all); ++i) if (all[i]) out[n++] = all[i];
+  return n;
+}
+
+// A remove waits at most this long for demux to stop pushing on the branch's pad
+// (g_state_lock is held meanwhile); past it the remove fails and the slot stays.
+#define DEMUX_UNLINK_TIMEOUT_MS 2000
+
+typedef struct {
+  gint refs;            // unlink_from_demux + the probe (its destroy notify)
+  GMutex lock;
+  GCond cond;
+  gboolean started;     // probe is unlinking: unlink_from_demux waits for it to finish
+  gboolean cancelled;   // unlink_from_demux gave up: the probe must not touch the pad
+  gboolean done;
+} UnlinkWait;
+
+static void unlink_wait_unref(gpointer data) {
+  UnlinkWait *w = (UnlinkWait*)data;
+  if (!g_atomic_int_dec_and_test(&w->refs)) return;
+  g_mutex_clear(&w->lock); g_cond_clear(&w->cond);
+  g_free(w);
+}
+
+// Runs once demux is not pushing on this pad: unlink so the branch gets no more data.
+static GstPadProbeReturn on_demux_pad_idle(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)info;
+  UnlinkWait *w = (UnlinkWait*)user_data;
+  g_mutex_lock(&w->lock);
+  w->started = !w->cancelled;
+  g_mutex_unlock(&w->lock);
+  if (!w->started) return GST_PAD_PROBE_REMOVE;
+  GstPad *peer = gst_pad_get_peer(pad);
+  if (peer) { gst_pad_unlink(pad, peer); gst_object_unref(peer); }
+  g_mutex_lock(&w->lock);
+  w->done = TRUE;
+  g_cond_signal(&w->cond);
+  g_mutex_unlock(&w->lock);
+  return GST_PAD_PROBE_REMOVE;
+}
+
+// FALSE when demux src_N did not go idle in time; the branch is then still linked.
+static gboolean unlink_from_demux(guint index, GstElement *queue) {
+  GstPad *queue_sink = gst_element_get_static_pad(queue, "sink");
+  GstPad *demux_src = queue_sink ? gst_pad_get_peer(queue_sink) : NULL;
+  if (queue_sink) gst_object_unref(queue_sink);
+  if (!demux_src) return TRUE;
+
+  UnlinkWait *w = g_new0(UnlinkWait, 1);
+  w->refs = 2;
+  g_mutex_init(&w->lock); g_cond_init(&w->cond);
+  gst_pad_add_probe(demux_src, GST_PAD_PROBE_TYPE_IDLE, on_demux_pad_idle, w, unlink_wait_unref);
+  // The branch keeps draining, so demux's current push returns within a frame or so.
+  gint64 deadline = g_get_monotonic_time() + DEMUX_UNLINK_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+  g_mutex_lock(&w->lock);
+  while (!w->done) {
+    if (w->started) { g_cond_wait(&w->cond, &w->lock); continue; }
+    if (!g_cond_wait_until(&w->cond, &w->lock, deadline) && !w->started && !w->done) {
+      // The pending probe stays until the pad idles, then drops itself.
+      w->cancelled = TRUE;
+      break;
+    }
+  }
+  gboolean done = w->done;
+  g_mutex_unlock(&w->lock);
+  unlink_wait_unref(w);
+
+  if (!done) {
+    LOG_WRN("Demux src_%u not idle within %u ms; keeping the branch", index, DEMUX_UNLINK_TIMEOUT_MS);
+    gst_object_unref(demux_src);
+    return FALSE;
+  }
+  gst_element_release_request_pad(g_demux, demux_src);
+  gst_object_unref(demux_src);
+  return TRUE;
+}
+
+// Kick sessions playing this mount so the media (and its udpsrc port) is released.
+static GstRTSPFilterResult session_filter(GstRTSPClient *client, GstRTSPSession *sess, gpointer user_data) {
+  (void)client;
+  const gchar *path = (const gchar*)user_data;
+  gint matched = 0;
+  GstRTSPSessionMedia *sm = gst_rtsp_session_get_media(sess, path, &matched);
+  if (!sm || matched != (gint)strlen(path)) return GST_RTSP_FILTER_KEEP;
+  GstRTSPSessionPool *pool = gst_rtsp_server_get_session_pool(g_rtsp_server);
+  gst_rtsp_session_pool_remove(pool, sess);
+  g_object_unref(pool);
+  return GST_RTSP_FILTER_REMOVE;
+}
+
+static GstRTSPFilterResult client_filter(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+  (void)server;
+  g_list_free_full(gst_rtsp_client_session_filter(client, session_filter, user_data), g_object_unref);
+  return GST_RTSP_FILTER_KEEP;
+}
+
+static void unmount_rtsp(const gchar *path) {
+  GstRTSPMountPoints *mounts = gst_rtsp_server_get_mount_points(g_rtsp_server);
+  gst_rtsp_mount_points_remove_factory(mounts, path);
+  g_object_unref(mounts);
+  g_list_free_full(gst_rtsp_server_client_filter(g_rtsp_server, client_filter, (gpointer)path), g_object_unref);
+}
+
+// --- Source swap
+typedef struct {
+  gulong probe_id;
+  gint64 started_us;
+  gint armed;   // new source posted: next buffer is its first frame
+  gint active;  // probe installed on the branch queue sink
+} SourceSwap;
+
+static SourceSwap s_swaps[G_N_ELEMENTS(g_streams)];
+
+static GstPadProbeReturn on_source_swap(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  SourceSwap *sw = (SourceSwap*)user_data;
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    // The outgoing source's EOS would end the encoder and the RTSP media with it.
+    return GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+  }
+  if (!g_atomic_int_get(&sw->armed)) return GST_PAD_PROBE_OK;
+  guint index = (guint)(sw - s_swaps);
+  LOG_INF("Source swap on /s%u: first frame after %" G_GINT64_FORMAT " ms", index, (g_get_monotonic_time() - sw->started_us) / 1000);
+  // Serialized ahead of this buffer, so viewers can decode from the first new frame.
+  gst_pad_send_event(pad, gst_video_event_new_downstream_force_key_unit(GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE, TRUE, 0));
+  g_atomic_int_set(&sw->active, FALSE);
+  return GST_PAD_PROBE_REMOVE;
+}
+
+// Caller holds g_state_lock and demux is no longer pushing (or the swap is not armed).
+static void source_swap_cancel(guint index, StreamInfo *si) {
+  SourceSwap *sw = &s_swaps[index];
+  if (!g_atomic_int_get(&sw->active)) return;
+  GstPad *sink = gst_element_get_static_pad(si->queue, "sink");
+  if (sink) { gst_pad_remove_probe(sink, sw->probe_id); gst_object_unref(sink); }
+  g_atomic_int_set(&sw->active, FALSE);
+}
+
+gboolean branch_source_swap_begin(guint index) {
+  if (index >= G_N_ELEMENTS(g_streams)) return FALSE;
+  g_mutex_lock(&g_state_lock);
+  StreamInfo *si = &g_streams[index];
+  SourceSwap *sw = &s_swaps[index];
+  gboolean ok = si->in_use && !g_atomic_int_get(&sw->active);
+  if (ok) {
+    GstPad *sink = gst_element_get_static_pad(si->queue, "sink");
+    sw->started_us = g_get_monotonic_time();
+    g_atomic_int_set(&sw->armed, FALSE);
+    g_atomic_int_set(&sw->active, TRUE);
+    sw->probe_id = gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, on_source_swap, sw, NULL);
+    gst_object_unref(sink);
+  }
+  g_mutex_unlock(&g_state_lock);
+  return ok;
+}
+
+void branch_source_swap_end(guint index, const gchar *uri) {
+  if (index >= G_N_ELEMENTS(g_streams)) return;
+  g_mutex_lock(&g_state_lock);
+  StreamInfo *si = &g_streams[index];
+  if (si->in_use) {
+    if (uri) {
+      g_free(si->uri);
+      si->uri = g_strdup(uri);
+      g_atomic_int_set(&s_swaps[index].armed, TRUE);
+      status_publish();
+    } else {
+      source_swap_cancel(index, si);
+    }
+  }
+  g_mutex_unlock(&g_state_lock);
+}
+
+gboolean remove_branch_and_unmount(guint index, gboolean *busy) {
+  *busy = FALSE;
+  if (index >= G_N_ELEMENTS(g_streams)) return FALSE;
+  // Finalizing a recording waits on the tap's streaming threads: not under g_state_lock.
+  record_branch_detach(index);
+  g_mutex_lock(&g_state_lock);
+  StreamInfo *si = &g_streams[index];
+  if (!si->in_use || !g_pre_bin || !g_demux || !g_rtsp_server) {
     g_mutex_unlock(&g_state_lock);
     return FALSE;
   }
 
-  BranchElems be; gboolean enc_is_hw = FALSE; gboolean enc_is_x264 = FALSE; guint port = 0;
-  if (!create_elements(index, &be, &enc_is_hw, &enc_is_x264, &port)) { g_mutex_unlock(&g_state_lock); return FALSE; }
-  if (!link_branch(index, &be, enc_is_hw)) {
-    LOG_ERR("Link failed for /s%u (pre/osd/post/cpu/enc/rtp/udp)", index);
-    cleanup_branch(&be, enc_is_hw);
+  // Unlinked first: if demux never lets go, the branch is left fully intact.
+  if (!unlink_from_demux(index, si->queue)) {
+    *busy = TRUE;
     g_mutex_unlock(&g_state_lock);
     return FALSE;
   }
+  unmount_rtsp(si->path);
+  lazy_branch_detach(index);
+  source_swap_cancel(index, si);
 
-  LOG_INF("Linked demux src_%u to UDP egress port %u (dynamic)", index, port);
-
-  gchar *path = g_strdup_printf("/s%u", index);
-  (void)mount_rtsp(path, port);
-  LOG_INF("RTSP mounted: rtsp://%s:%u%s (udp-wrap H264 RTP @127.0.0.1:%u)", g_public_host ? g_public_host : "127.0.0.1", g_rtsp_port, path, port);
-  if (out_path) *out_path = g_strdup(path);
-  if (out_url) *out_url = g_strdup_printf("rtsp://%s:%u%s", g_public_host ? g_public_host : "127.0.0.1", g_rtsp_port, path);
-
-  g_streams[index].in_use = TRUE;
-  g_streams[index].enc_is_hw = enc_is_hw;
-  strncpy(g_streams[index].enc_kind, enc_is_hw ? "nvenc" : (enc_is_x264 ? "x264" : (g_str_has_prefix(G_OBJECT_TYPE_NAME(be.enc), "GstAv") ? "avenc" : "openh264")), sizeof(g_streams[index].enc_kind)-1);
-  g_streams[index].enc_kind[sizeof(g_streams[index].enc_kind)-1] = '\0';
-  g_streams[index].udp_port = port;
-  g_snprintf(g_streams[index].path, sizeof(g_streams[index].path), "%s", path);
-  g_streams[index].queue = be.queue;
-  g_streams[index].conv_pre = be.conv_pre;
-  g_streams[index].caps_pre = be.caps_pre;
-  g_streams[index].osd = be.osd;
-  g_streams[index].conv_post = be.conv_post;
-  g_streams[index].caps_post = be.caps_post;
-  g_streams[index].conv_cpu = enc_is_hw ? NULL : be.conv_cpu;
-  g_streams[index].caps_cpu = enc_is_hw ? NULL : be.caps_cpu;
-  g_streams[index].enc = be.enc;
-  g_streams[index].parse = be.parse;
-  g_streams[index].pay = be.pay;
-  g_streams[index].udp = be.udp;
-
-  g_free(path);
+  GstElement *els[17];
+  guint n = stream_elements(si, els);
+  for (guint i = 0; i < n; ++i) gst_element_set_state(els[i], GST_STATE_NULL);
+  for (guint i = 0; i < n; ++i) gst_bin_remove(GST_BIN(g_pre_bin), els[i]);
+  snapshot_branch_detach(index);
+
+  LOG_INF("Removed %s (demux src_%u, udp %u)", si->path, index, si->udp_port);
+  handoff_detach(index, NULL);
+  g_free(si->uri);
+  memset(si, 0, sizeof(*si));
+  if (s_slot_taken[index]) { s_slot_taken[index] = FALSE; s_slots_used--; }
+  cpu_budget_rebalance();
+  status_publish();
   g_mutex_unlock(&g_state_lock);
   return TRUE;
 }
+
+// --- Live reconfiguration
+// A swap waits at most this long for the encoder input to go idle (g_state_lock is
+// held meanwhile); past it the swap is called off and the running encoder stays.
+#define ENCODER_SWAP_TIMEOUT_MS 2000
+
+typedef struct {
+  gint refs;            // swap_encoder + the probe (its destroy notify)
+  StreamInfo *si;
+  GstElement *up;       // element feeding the encoder
+  GstElement *enc;      // replacement (floating until added)
+  GMutex lock;
+  GCond cond;
+  gboolean started;     // probe is relinking: swap_encoder waits for it to finish
+  gboolean cancelled;   // swap_encoder gave up: the probe must not touch the branch
+  gboolean done, ok;
+} EncoderSwap;
+
+static void encoder_swap_unref(gpointer data) {
+  EncoderSwap *w = (EncoderSwap*)data;
+  if (!g_atomic_int_dec_and_test(&w->refs)) return;
+  g_mutex_clear(&w->lock); g_cond_clear(&w->cond);
+  g_free(w);
+}
+
+// Runs while nothing is being pushed into the encoder: replace it in place.
+static GstPadProbeReturn on_enc_input_idle(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad; (void)info;
+  EncoderSwap *w = (EncoderSwap*)user_data;
+  g_mutex_lock(&w->lock);
+  w->started = !w->cancelled;
+  g_mutex_unlock(&w->lock);
+  if (!w->started) return GST_PAD_PROBE_REMOVE;
+  StreamInfo *si = w->si;
+  GstElement *old = si->enc;
+  gst_element_unlink_many(w->up, old, si->parse, NULL);
+  gst_element_set_state(old, GST_STATE_NULL);
+  gst_bin_remove(GST_BIN(g_pre_bin), old);
+  gst_bin_add(GST_BIN(g_pre_bin), w->enc);
+  w->ok = gst_element_link_many(w->up, w->enc, si->parse, NULL);
+  gst_element_sync_state_with_parent(w->enc);
+  g_mutex_lock(&w->lock);
+  w->done = TRUE;
+  g_cond_signal(&w->cond);
+  g_mutex_unlock(&w->lock);
+  return GST_PAD_PROBE_REMOVE;
+}
+
+static gboolean swap_encoder(guint index, const EncoderConfig *cfg) {
+  StreamInfo *si = &g_streams[index];
+  GstElementFactory *f = gst_element_get_factory(si->enc);
+  GstElement *enc = f ? gst_element_factory_create(f, NULL) : NULL;
+  if (!enc) return FALSE;
+  gboolean is_x264 = g_strcmp0(si->enc_kind, "x264") == 0;
+  guint threads = 1;
+  if (is_x264) g_object_get(si->enc, "threads", &threads, NULL);
+  configure_encoder(enc, si->enc_is_hw, is_x264, threads, cfg);
+
+  EncoderSwap *w = g_new0(EncoderSwap, 1);
+  w->refs = 2;
+  w->si = si;
+  w->up = si->caps_cpu ? si->caps_cpu : si->caps_post;
+  w->enc = enc;
+  g_mutex_init(&w->lock); g_cond_init(&w->cond);
+  GstPad *up_src = gst_element_get_static_pad(w->up, "src");
+  gst_pad_add_probe(up_src, GST_PAD_PROBE_TYPE_IDLE, on_enc_input_idle, w, encoder_swap_unref);
+  gst_object_unref(up_src);
+  gint64 deadline = g_get_monotonic_time() + ENCODER_SWAP_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+  g_mutex_lock(&w->lock);
+  while (!w->done) {
+    // Once relinking has begun it is a handful of calls with no data flowing.
+    if (w->started) { g_cond_wait(&w->cond, &w->lock); continue; }
+    if (!g_cond_wait_until(&w->cond, &w->lock, deadline) && !w->started && !w->done) {
+      // Roll back: the pending probe stays until the pad idles, then drops itself.
+      w->cancelled = TRUE;
+      break;
+    }
+  }
+  gboolean done = w->done, ok = w->ok;
+  g_mutex_unlock(&w->lock);
+  encoder_swap_unref(w);
+
+  if (!done) {
+    gst_object_unref(gst_object_ref_sink(enc));
+    LOG_WRN("Encoder swap for %s: input not idle within %u ms, keeping the running encoder", si->path, ENCODER_SWAP_TIMEOUT_MS);
+    return FALSE;
+  }
+  si->enc = enc;
+  metrics_encoder_attach(index, enc);
+  lazy_branch_set_encoder(index, enc);
+  if (!ok) LOG_ERR("Encoder swap for %s did not relink", si->path);
+  return ok;
+}
+
+gboolean branch_get_config(guint index, EncoderConfig *out) {
+  if (index >= G_N_ELEMENTS(g_streams)) return FALSE;
+  g_mutex_lock(&g_state_lock);
+  gboolean ok = g_streams[index].in_use;
+  if (ok) *out = g_streams[index].enc_cfg;
+  g_mutex_unlock(&g_state_lock);
+  return ok;
+}
+
+gboolean branch_reconfigure(guint index, const EncoderConfig *cfg, gboolean *swapped) {
+  *swapped = FALSE;
+  if (index >= G_N_ELEMENTS(g_streams)) return FALSE;
+  g_mutex_lock(&g_state_lock);
+  StreamInfo *si = &g_streams[index];
+  if (!si->in_use || !g_pre_bin) { g_mutex_unlock(&g_state_lock); return FALSE; }
+  gboolean ok = TRUE;
+  gboolean is_x264 = g_strcmp0(si->enc_kind, "x264") == 0;
+  // Keyframe interval and x264 preset are fixed once an encoder is open.
+  if (cfg->gop != si->enc_cfg.gop || (is_x264 && g_strcmp0(cfg->preset, si->enc_cfg.preset) != 0)) {
+    GstElement *before = si->enc;
+    ok = swap_encoder(index, cfg);
+    *swapped = si->enc != before;
+    // Timed out: nothing changed, so keep the running config too.
+    if (!*swapped) { g_mutex_unlock(&g_state_lock); return FALSE; }
+  }
+  si->enc_cfg = *cfg;
+  overload_apply(index);
+  LOG_INF("Reconfigured %s: %u kbps, gop %u, fps cap %u, preset %s%s", si->path, cfg->bitrate_kbps, cfg->gop, cfg->fps, cfg->preset,
+          *swapped ? " (encoder swapped)" : "");
+  g_mutex_unlock(&g_state_lock);
+  return ok;
+}
@@ -3,8 +3,33 @@
 #define BRANCH_H
 
 #include <glib.h>
+#include "state.h"
 
-gboolean add_branch_and_mount(guint index, gchar **out_path, gchar **out_url);
+// Stream slots: lowest free index first (nvmultiurisrcbin reuses the lowest free
+// source id, so demux src_N, /sN and the UDP port stay in step across churn).
+gboolean branch_slot_acquire(guint *out_index);
+gboolean branch_slots_acquire(guint n, guint *out_indices); // all-or-nothing
+void branch_slot_release(guint index);
+
+// want_hw picks NVENC (falls back to a software encoder if it cannot be created).
+gboolean add_branch_and_mount(guint index, const gchar *uri, gboolean want_hw, gchar **out_path, gchar **out_url);
+// Batch add under one g_state_lock hold; ok[i] reports each entry. Returns the number added.
+guint add_branches_and_mount(const guint *indices, const gchar *const *uris, const gboolean *want_hw, guint n, gboolean *ok, gchar **out_paths, gchar **out_urls);
+// busy: demux kept pushing past the unlink deadline; the stream is left as it was.
+gboolean remove_branch_and_unmount(guint index, gboolean *busy);
+
+// Source swap: the branch, encoder and mount stay up while the caller replaces the
+// camera behind demux src_N. begin holds back EOS from the outgoing source (FALSE if
+// the slot is free or a swap is pending); end records the new uri (NULL = aborted)
+// and asks the encoder for a keyframe on the first frame of the new source.
+gboolean branch_source_swap_begin(guint index);
+void branch_source_swap_end(guint index, const gchar *uri);
+
+// Live encoder settings. Bitrate and fps change in place; a new keyframe interval or
+// x264 preset swaps in a freshly configured encoder of the same kind (*swapped).
+// FALSE with *swapped unset: the encoder input never went idle, nothing was changed.
+gboolean branch_get_config(guint index, EncoderConfig *out);
+gboolean branch_reconfigure(guint index, const EncoderConfig *cfg, gboolean *swapped);
 
 #endif // BRANCH_H
 
@@ -6,7 +6,12 @@
 gboolean parse_args(int argc, char *argv[], AppConfig *cfg) {
   // Defaults
   cfg->rtsp_port = 8554;
+  cfg->rtsp_threads = CLAMP((guint) g_get_num_processors() / 2, 2u, 8u);
   cfg->base_udp_port = 5000;
+  cfg->handoff_appsrc = FALSE;
+  cfg->backend_cpu = FALSE;
+  cfg->rest_port = 0;
+  cfg->rest_mock = FALSE;
   cfg->sample_uri = g_strdup("file:///opt/nvidia/deepstream/deepstream/samples/streams/sample_1080p_h264.mp4");
   cfg->public_host = g_strdup("127.0.0.1");
 
@@ -17,7 +22,12 @@ gboolean parse_args(int argc, char *argv[], AppConfig *cfg) {
   // Environment overrides
   const gchar *env;
   if ((env = g_getenv("RTSP_PORT"))) cfg->rtsp_port = (guint) g_ascii_strtoull(env, NULL, 10);
+  if ((env = g_getenv("RTSP_THREADS"))) cfg->rtsp_threads = CLAMP((guint) g_ascii_strtoull(env, NULL, 10), 1u, 64u);
   if ((env = g_getenv("BASE_UDP_PORT"))) cfg->base_udp_port = (guint) g_ascii_strtoull(env, NULL, 10);
+  if ((env = g_getenv("RTSP_HANDOFF"))) cfg->handoff_appsrc = (g_ascii_strcasecmp(env, "appsrc") == 0);
+  if ((env = g_getenv("REST_PORT"))) cfg->rest_port = (guint) g_ascii_strtoull(env, NULL, 10);
+  if ((env = g_getenv("BACKEND"))) cfg->backend_cpu = (g_ascii_strcasecmp(env, "cpu") == 0);
+  if ((env = g_getenv("REST_MOCK"))) cfg->rest_mock = (g_strcmp0(env, "1") == 0 || g_ascii_strcasecmp(env, "on") == 0);
   if ((env = g_getenv("SAMPLE_URI"))) { g_free(cfg->sample_uri); cfg->sample_uri = g_strdup(env); }
   if ((env = g_getenv("PUBLIC_HOST"))) { g_free(cfg->public_host); cfg->public_host = g_strdup(env); }
   return TRUE;
@@ -27,3 +37,9 @@ void cleanup_config(AppConfig *cfg) {
   g_free(cfg->sample_uri);
   g_free(cfg->public_host);
 }
+
+guint config_env_uint(const char *name, guint defval) {
+  const gchar *e = g_getenv(name);
+  if (!e || !*e) return defval;
+  return (guint) g_ascii_strtoull(e, NULL, 10);
+}
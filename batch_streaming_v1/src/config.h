@@ -7,7 +7,12 @@
 typedef struct {
   // Outputs / serving
   guint rtsp_port;     // RTSP TCP port (e.g., 8554)
+  guint rtsp_threads;  // RTSP_THREADS: client threads in the RTSP server's pool
   guint base_udp_port; // base UDP port for per-stream RTP egress
+  gboolean handoff_appsrc; // RTSP_HANDOFF=appsrc: appsink -> RTSP media appsrc, no UDP hop
+  gboolean backend_cpu;    // BACKEND=cpu: videotestsrc ! identity ! tee instead of the DeepStream front end
+  guint rest_port;     // REST_PORT: nvmultiurisrcbin REST server port (0 = element default)
+  gboolean rest_mock;  // REST_MOCK=1 with BACKEND=cpu: still send camera REST calls (to a mock on REST_PORTS)
 
   // Sample source + URL host for responses
   gchar *sample_uri;  // default DS sample video
@@ -17,4 +22,7 @@ typedef struct {
 gboolean parse_args(int argc, char *argv[], AppConfig *cfg);
 void cleanup_config(AppConfig *cfg);
 
+// Unsigned env knob with a default (unset/empty -> defval)
+guint config_env_uint(const char *name, guint defval);
+
 #endif // CONFIG_H
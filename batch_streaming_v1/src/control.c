@@ -1,50 +1,42 @@
-// Tiny control HTTP server (L2)
+// Tiny control HTTP server (L2): /add_demo_stream, /add_streams, /remove_stream, /status, /metrics, /latency,
+// /streams/{index}/config, /streams/{index}/source, /streams/{index}/record, /streams/{index}/snapshot.jpg
+// (or, on a sharded front, the same routes forwarded to the shard processes)
+// - One epoll thread owns the listener and every client connection (keep-alive,
+//   per-connection read timeout, growable request buffer).
+// - Cheap routes (/status) are answered inline on that thread; routes that build
+//   pipeline branches run on a worker so they never stall health checks.
+#define _GNU_SOURCE // accept4
 #include <sys/types.h>
 #include <sys/socket.h>
-#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <json-glib/json-glib.h>
 #include "log.h"
 #include "state.h"
+#include "config.h"
 #include "branch.h"
+#include "rest_client.h"
+#include "admission.h"
+#include "metrics.h"
+#include "status.h"
+#include "overload.h"
+#include "shard.h"
+#include "record.h"
+#include "latency.h"
+#include "infer.h"
+#include "push_timeout.h"
+#include "snapshot.h"
 
-// Minimal HTTP POST helper to nvmultiurisrcbin REST (localhost:9010/9000)
-static gboolean http_post_localhost_port(const char *port_str, const char *path, const char *json, size_t json_len) {
-  struct addrinfo hints; memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_UNSPEC; hints.ai_socktype = SOCK_STREAM;
-  struct addrinfo *res = NULL;
-  int err = getaddrinfo("127.0.0.1", port_str, &hints, &res);
-  if (err != 0 || !res) { LOG_WRN("REST: getaddrinfo failed: %s", gai_strerror(err)); if (res) freeaddrinfo(res); return FALSE; }
-  int s = -1; for (struct addrinfo *rp = res; rp != NULL; rp = rp->ai_next) {
-    s = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-    if (s == -1) continue;
-    if (connect(s, rp->ai_addr, rp->ai_addrlen) == 0) break;
-    close(s); s = -1;
-  }
-  freeaddrinfo(res);
-  if (s == -1) { LOG_WRN("REST: connect failed"); return FALSE; }
-  gchar *req = g_strdup_printf(
-    "POST %s HTTP/1.1\r\nHost: 127.0.0.1:%s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
-    path, port_str, json_len);
-  ssize_t n = send(s, req, strlen(req), 0); g_free(req);
-  if (n < 0) { LOG_WRN("REST: send header failed"); close(s); return FALSE; }
-  if (json_len > 0) { ssize_t m = send(s, json, json_len, 0); if (m < 0) { LOG_WRN("REST: send body failed"); close(s); return FALSE; } }
-  char buf[256]; (void)recv(s, buf, sizeof(buf), 0); close(s);
-  return TRUE;
-}
-
-static gboolean http_post_localhost_try(const char *path, const char *json, size_t json_len) {
-  if (http_post_localhost_port("9010", path, json, json_len)) return TRUE;
-  if (http_post_localhost_port("9000", path, json, json_len)) return TRUE;
-  LOG_WRN("REST: failed to post on 9010 and 9000");
-  return FALSE;
-}
+#define CTRL_TICK_MS 250
 
 static int create_ctrl_listener(void) {
-  int s = socket(AF_INET, SOCK_STREAM, 0);
+  int s = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
   if (s < 0) { LOG_ERR("CTRL: socket create failed"); return -1; }
   int opt = 1; setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
   struct sockaddr_in addr; memset(&addr, 0, sizeof(addr));
@@ -63,86 +55,1082 @@ static int create_ctrl_listener(void) {
     }
   }
   if (g_ctrl_port == 0) { LOG_ERR("CTRL: bind 8080-8089 failed"); close(s); return -1; }
-  if (listen(s, 16) != 0) { LOG_ERR("CTRL: listen failed"); close(s); return -1; }
+  if (listen(s, SOMAXCONN) != 0) { LOG_ERR("CTRL: listen failed"); close(s); return -1; }
   LOG_INF("Control API listening on http://0.0.0.0:%u", g_ctrl_port);
   return s;
 }
 
-static void handle_request(int c, const char *buf) {
-  gboolean is_add = (g_str_has_prefix(buf, "GET /add_demo_stream ") || g_str_has_prefix(buf, "GET /add_demo_stream?"));
-  gboolean is_status = (g_str_has_prefix(buf, "GET /status ") || g_str_has_prefix(buf, "GET /status?"));
-  if (!is_add && !is_status) {
-    const char *resp = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 9\r\nConnection: close\r\n\r\nNot Found";
-    send(c, resp, strlen(resp), 0);
+// --- Requests / responses
+typedef struct {
+  gchar *method;
+  gchar *path;     // request target without the query string
+  gchar *query;    // text after '?', or NULL
+  gchar *body;     // NUL-terminated copy of the body, or NULL
+  gsize body_len;
+  gboolean keep_alive;
+  gint path_index; // value of {index} in the matched route, or -1
+  gint shard;      // front: shard the request was queued for, or -1
+} CtrlRequest;
+
+static void ctrl_request_free(CtrlRequest *req) {
+  if (!req) return;
+  g_free(req->method); g_free(req->path); g_free(req->query); g_free(req->body);
+  g_free(req);
+}
+
+// Append a complete HTTP/1.1 response to out. status is e.g. "200 OK"; extra is
+// NULL or additional header lines, each ending in \r\n.
+static void respond_ex(GString *out, const CtrlRequest *req, const char *status, const char *extra, const char *ctype, const char *body, gsize len) {
+  g_string_append_printf(out,
+    "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n%s\r\n",
+    status, ctype, len, (req && req->keep_alive) ? "keep-alive" : "close", extra ? extra : "");
+  if (len > 0) g_string_append_len(out, body, (gssize)len);
+}
+
+static void respond(GString *out, const CtrlRequest *req, const char *status, const char *ctype, const char *body, gsize len) {
+  respond_ex(out, req, status, NULL, ctype, body, len);
+}
+
+static void respond_json(GString *out, const CtrlRequest *req, const char *status, const gchar *json) {
+  respond(out, req, status, "application/json", json, strlen(json));
+}
+
+static void respond_text(GString *out, const CtrlRequest *req, const char *status, const char *text) {
+  respond(out, req, status, "text/plain", text, strlen(text));
+}
+
+// --- Route handlers
+// Served from the published snapshot: no g_state_lock, no rendering per poll.
+static void handle_status(const CtrlRequest *req, GString *out) {
+  const StatusSnapshot *s = status_acquire();
+  if (s) respond(out, req, "200 OK", "application/json", s->json, s->len);
+  else respond_json(out, req, "503 Service Unavailable", "{\n  \"error\": \"starting\"\n}\n");
+  status_release();
+}
+
+// Value of key in the query string (URL-decoded); caller frees. NULL if absent.
+static gchar *query_get(const CtrlRequest *req, const char *key) {
+  if (!req->query) return NULL;
+  gchar *val = NULL;
+  gchar **pairs = g_strsplit(req->query, "&", -1);
+  for (guint i = 0; pairs[i] && !val; ++i) {
+    gchar *eq = strchr(pairs[i], '=');
+    if (!eq) continue;
+    *eq = '\0';
+    if (g_strcmp0(pairs[i], key) == 0) val = g_uri_unescape_string(eq + 1, NULL);
+  }
+  g_strfreev(pairs);
+  return val;
+}
+
+static const gchar *sample_uri(void) {
+  const gchar *env_sample = g_getenv("SAMPLE_URI");
+  return env_sample ? env_sample : "file:///opt/nvidia/deepstream/deepstream/samples/streams/sample_1080p_h264.mp4";
+}
+
+// JSON string literal (quoted + escaped) for caller-supplied text; caller frees.
+static gchar *json_quote(const gchar *s) {
+  JsonNode *node = json_node_init_string(json_node_alloc(), s ? s : "");
+  gchar *q = json_to_string(node, FALSE);
+  json_node_unref(node);
+  return q;
+}
+
+// nvmultiurisrcbin REST body for source api_<index> (change: camera_add|camera_remove)
+static gchar *camera_change_body(guint index, const gchar *uri, const gchar *change) {
+  gchar *quri = json_quote(uri);
+  gchar *body = g_strdup_printf(
+    "{\n  \"key\": \"sensor\",\n  \"value\": {\n    \"camera_id\": \"api_%u\",\n    \"camera_url\": %s,\n    \"change\": \"%s\"\n  },\n  \"headers\": { \"source\": \"app\" }\n}\n",
+    index, quri, change);
+  g_free(quri);
+  return body;
+}
+
+// Adds are queued (the REST client keeps them in order); removes wait so the source
+// is gone before its branch is torn down.
+// The CPU backend has no nvmultiurisrcbin (and no REST server) behind the tee;
+// with REST_MOCK the calls still go out, to a mock server, so they can be timed.
+static gboolean rest_backend(void) { return !g_backend_cpu || g_rest_mock; }
+
+static void post_camera_add(guint index, const gchar *uri) {
+  if (!rest_backend()) return;
+  gchar *body = camera_change_body(index, uri, "camera_add");
+  rest_client_post_async("/api/v1/stream/add", body);
+  g_free(body);
+}
+
+// Waits for the 2xx (used where the caller has to know the source is back).
+static gboolean post_camera_add_sync(guint index, const gchar *uri) {
+  if (!rest_backend()) return TRUE;
+  gchar *body = camera_change_body(index, uri, "camera_add");
+  gboolean ok = rest_client_post("/api/v1/stream/add", body);
+  g_free(body);
+  return ok;
+}
+
+static gboolean post_camera_remove(guint index, const gchar *uri) {
+  if (!rest_backend()) return TRUE;
+  gchar *body = camera_change_body(index, uri, "camera_remove");
+  gboolean ok = rest_client_post("/api/v1/stream/remove", body);
+  g_free(body);
+  return ok;
+}
+
+// POST /streams/{index}/source  {"uri": "rtsp://..."}
+// Same slot, branch and /sN mount: remove api_<index> then add it back with the new url.
+// nvmultiurisrcbin hands the freed source id straight back, so demux src_N is reused.
+static void handle_stream_source(const CtrlRequest *req, GString *out) {
+  guint index = (guint)req->path_index;
+  JsonParser *parser = json_parser_new();
+  gboolean parsed = req->body && json_parser_load_from_data(parser, req->body, (gssize)req->body_len, NULL);
+  JsonNode *root = parsed ? json_parser_get_root(parser) : NULL;
+  gchar *uri = NULL;
+  if (root && JSON_NODE_HOLDS_OBJECT(root)) {
+    const gchar *u = json_object_get_string_member(json_node_get_object(root), "uri");
+    if (u && strstr(u, "://")) uri = g_strdup(u);
+  }
+  g_object_unref(parser);
+  if (!uri) {
+    respond_json(out, req, "400 Bad Request", "{\n  \"error\": \"uri_required\"\n}\n");
     return;
   }
-  if (is_status) {
-    GString *j = g_string_new(NULL);
-    g_string_append_printf(j, "{\n  \"max\": %u,\n  \"streams\": [\n", g_max_streams);
-    gboolean first = TRUE;
-    for (guint i = 0; i < G_N_ELEMENTS(g_streams); ++i) {
-      if (!g_streams[i].in_use) continue;
-      if (!first) g_string_append(j, ",\n");
-      first = FALSE;
-      g_string_append_printf(j,
-        "    { \"index\": %u, \"path\": \"%s\", \"udp\": %u, \"encoder\": \"%s\" }",
-        i, g_streams[i].path, g_streams[i].udp_port, g_streams[i].enc_kind[0] ? g_streams[i].enc_kind : "unknown");
-    }
-    g_string_append(j, "\n  ]\n}\n");
-    gchar *hdr = g_strdup_printf("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", j->len);
-    send(c, hdr, strlen(hdr), 0); send(c, j->str, j->len, 0);
-    g_free(hdr); g_string_free(j, TRUE);
+  if (req->path_index < 0 || !branch_source_swap_begin(index)) {
+    gboolean busy = req->path_index >= 0 && g_streams[index].in_use;
+    respond_json(out, req, busy ? "409 Conflict" : "404 Not Found",
+                 busy ? "{\n  \"error\": \"swap_in_progress\"\n}\n" : "{\n  \"error\": \"no_such_stream\"\n}\n");
+    g_free(uri);
     return;
   }
 
-  // Add stream
+  // Only this worker mutates slots, so the uri cannot change underneath us.
+  gchar *old = g_strdup(g_streams[index].uri);
+  gint64 t0 = g_get_monotonic_time();
+  const char *err = NULL;
+  if (!post_camera_remove(index, old)) err = "rest_remove_failed";
+  else if (!post_camera_add_sync(index, uri)) {
+    err = "rest_add_failed";
+    if (!post_camera_add_sync(index, old)) LOG_ERR("Source swap: /s%u has no source (restoring %s failed)", index, old);
+  }
+  gint64 rest_us = g_get_monotonic_time() - t0;
+  branch_source_swap_end(index, err ? NULL : uri);
+  if (err) {
+    LOG_WRN("Source swap on /s%u failed: %s", index, err);
+    gchar *json = g_strdup_printf("{\n  \"error\": \"%s\"\n}\n", err);
+    respond_json(out, req, "502 Bad Gateway", json);
+    g_free(json);
+  } else {
+    LOG_INF("Source swap on /s%u: %s -> %s (REST %" G_GINT64_FORMAT " ms)", index, old, uri, rest_us / 1000);
+    gchar *quri = json_quote(uri), *qold = json_quote(old);
+    gchar *json = g_strdup_printf(
+      "{\n  \"stream\": \"/s%u\",\n  \"uri\": %s,\n  \"previous\": %s,\n  \"rest_ms\": %.1f\n}\n",
+      index, quri, qold, rest_us / 1000.0);
+    respond_json(out, req, "200 OK", json);
+    g_free(json); g_free(quri); g_free(qold);
+  }
+  g_free(old); g_free(uri);
+}
+
+// 429 from the admission scheduler: no encoder capacity right now.
+static void respond_encoder_busy(GString *out, const CtrlRequest *req, guint retry_after_s) {
+  gchar *hdr = g_strdup_printf("Retry-After: %u\r\n", retry_after_s);
+  gchar *json = g_strdup_printf("{\n  \"error\": \"encoder_capacity\",\n  \"retry_after_s\": %u\n}\n", retry_after_s);
+  respond_ex(out, req, "429 Too Many Requests", hdr, "application/json", json, strlen(json));
+  g_free(hdr); g_free(json);
+}
+
+static void handle_add_demo_stream(const CtrlRequest *req, GString *out) {
+  AdmitDecision d = admission_admit();
+  if (d.kind == ADMIT_REJECT) { respond_encoder_busy(out, req, d.retry_after_s); return; }
   guint index;
-  g_mutex_lock(&g_state_lock);
-  if (g_next_index >= g_max_streams) {
-    g_mutex_unlock(&g_state_lock);
+  if (!branch_slot_acquire(&index)) {
+    admission_release(d.kind == ADMIT_HW);
     gchar *json = g_strdup_printf("{\n  \"error\": \"capacity_exceeded\",\n  \"max\": %u\n}\n", g_max_streams);
-    gchar *hdr = g_strdup_printf("HTTP/1.1 429 Too Many Requests\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", strlen(json));
-    send(c, hdr, strlen(hdr), 0); send(c, json, strlen(json), 0);
-    g_free(hdr); g_free(json);
+    respond_json(out, req, "429 Too Many Requests", json);
+    g_free(json);
     return;
   }
-  index = g_next_index++;
-  g_mutex_unlock(&g_state_lock);
 
   gchar *path = NULL; gchar *url = NULL;
-  gboolean ok = add_branch_and_mount(index, &path, &url);
+  gboolean ok = add_branch_and_mount(index, sample_uri(), d.kind == ADMIT_HW, &path, &url);
   if (ok) {
-    const gchar *env_sample = g_getenv("SAMPLE_URI");
-    const gchar *sample_uri = env_sample ? env_sample : "file:///opt/nvidia/deepstream/deepstream/samples/streams/sample_1080p_h264.mp4";
-    gchar *body = g_strdup_printf(
-      "{\n  \"key\": \"sensor\",\n  \"value\": {\n    \"camera_id\": \"api_%u\",\n    \"camera_url\": \"%s\",\n    \"change\": \"camera_add\"\n  },\n  \"headers\": { \"source\": \"app\" }\n}\n",
-      index, sample_uri);
-    (void)http_post_localhost_try("/api/v1/stream/add", body, strlen(body));
-    g_free(body);
+    admission_settle(d.kind, g_streams[index].enc_is_hw);
+    post_camera_add(index, sample_uri());
     gchar *json = g_strdup_printf("{\n  \"path\": \"%s\",\n  \"url\": \"%s\"\n}\n", path, url);
-    gchar *hdr = g_strdup_printf("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", strlen(json));
-    send(c, hdr, strlen(hdr), 0); send(c, json, strlen(json), 0);
-    g_free(hdr); g_free(json);
+    respond_json(out, req, "200 OK", json);
+    g_free(json);
   } else {
-    const char *resp = "HTTP/1.1 500 Internal Server Error\r\nContent-Type: text/plain\r\nContent-Length: 6\r\nConnection: close\r\n\r\nError\n";
-    send(c, resp, strlen(resp), 0);
+    admission_release(d.kind == ADMIT_HW);
+    branch_slot_release(index);
+    respond_text(out, req, "500 Internal Server Error", "Error\n");
   }
   g_free(path); g_free(url);
 }
 
+static void handle_remove_stream(const CtrlRequest *req, GString *out) {
+  gchar *idx = query_get(req, "index");
+  gchar *end = NULL;
+  guint64 index = idx ? g_ascii_strtoull(idx, &end, 10) : 0;
+  gboolean valid = idx && *idx && end && *end == '\0' && index < G_N_ELEMENTS(g_streams);
+  g_free(idx);
+  if (!valid) {
+    respond_json(out, req, "400 Bad Request", "{\n  \"error\": \"index_required\"\n}\n");
+    return;
+  }
+  if (!g_streams[index].in_use) {
+    respond_json(out, req, "404 Not Found", "{\n  \"error\": \"no_such_stream\"\n}\n");
+    return;
+  }
+
+  // Stop the source first so demux src_N goes quiet before the branch is torn down.
+  gboolean was_hw = g_streams[index].enc_is_hw;
+  (void)post_camera_remove((guint)index, g_streams[index].uri);
+  gboolean busy = FALSE;
+  if (!remove_branch_and_unmount((guint)index, &busy)) {
+    if (busy) respond_json(out, req, "503 Service Unavailable", "{\n  \"error\": \"unlink_timeout\"\n}\n");
+    else respond_text(out, req, "500 Internal Server Error", "Error\n");
+    return;
+  }
+  admission_release(was_hw);
+  gchar *json = g_strdup_printf("{\n  \"removed\": \"/s%u\"\n}\n", (guint)index);
+  respond_json(out, req, "200 OK", json);
+  g_free(json);
+}
+
+// POST /add_streams  {"sources": ["rtsp://...", ...]}  or  {"count": N} (N x SAMPLE_URI)
+// All branches are built in one g_state_lock hold and registered in one REST exchange.
+static void handle_add_streams(const CtrlRequest *req, GString *out) {
+  GPtrArray *uris = g_ptr_array_new_with_free_func(g_free);
+  JsonParser *parser = json_parser_new();
+  gboolean parsed = req->body && json_parser_load_from_data(parser, req->body, (gssize)req->body_len, NULL);
+  JsonNode *root = parsed ? json_parser_get_root(parser) : NULL;
+  if (root && JSON_NODE_HOLDS_OBJECT(root)) {
+    JsonObject *obj = json_node_get_object(root);
+    if (json_object_has_member(obj, "sources")) {
+      JsonArray *arr = json_object_get_array_member(obj, "sources");
+      for (guint i = 0; arr && i < json_array_get_length(arr); ++i) {
+        const gchar *u = json_array_get_string_element(arr, i);
+        if (u && *u) g_ptr_array_add(uris, g_strdup(u));
+      }
+    } else if (json_object_has_member(obj, "count")) {
+      gint64 count = json_object_get_int_member(obj, "count");
+      for (gint64 i = 0; i < count && i < (gint64)G_N_ELEMENTS(g_streams); ++i) g_ptr_array_add(uris, g_strdup(sample_uri()));
+    }
+  }
+  g_object_unref(parser);
+  guint n = uris->len;
+  if (n == 0) {
+    respond_json(out, req, "400 Bad Request", "{\n  \"error\": \"sources_required\"\n}\n");
+    g_ptr_array_free(uris, TRUE);
+    return;
+  }
+
+  guint *indices = g_new0(guint, n);
+  if (!branch_slots_acquire(n, indices)) {
+    gchar *json = g_strdup_printf("{\n  \"error\": \"capacity_exceeded\",\n  \"max\": %u,\n  \"requested\": %u\n}\n", g_max_streams, n);
+    respond_json(out, req, "429 Too Many Requests", json);
+    g_free(json); g_free(indices);
+    g_ptr_array_free(uris, TRUE);
+    return;
+  }
+
+  // Admit entry by entry; rejected entries give their slot back and are not built.
+  // Software entries admitted so far count against the live idle CPU of the next
+  // (admission tracks every stream admitted since its last CPU sample).
+  AdmitDecision *dec = g_new0(AdmitDecision, n);
+  gboolean *want_hw = g_new0(gboolean, n);
+  guint *adm_idx = g_new0(guint, n);
+  const gchar **adm_uri = g_new0(const gchar*, n);
+  guint m = 0, rejected = 0, retry_after_s = 0;
+  for (guint i = 0; i < n; ++i) {
+    dec[i] = admission_admit();
+    if (dec[i].kind == ADMIT_REJECT) {
+      branch_slot_release(indices[i]);
+      retry_after_s = MAX(retry_after_s, dec[i].retry_after_s);
+      rejected++;
+      continue;
+    }
+    want_hw[m] = dec[i].kind == ADMIT_HW;
+    adm_idx[m] = indices[i];
+    adm_uri[m] = g_ptr_array_index(uris, i);
+    m++;
+  }
+  if (m == 0) {
+    respond_encoder_busy(out, req, retry_after_s);
+    g_free(dec); g_free(want_hw); g_free(adm_idx); g_free(adm_uri); g_free(indices);
+    g_ptr_array_free(uris, TRUE);
+    return;
+  }
+
+  gboolean *ok = g_new0(gboolean, m);
+  gchar **paths = g_new0(gchar*, m);
+  gchar **urls = g_new0(gchar*, m);
+  guint added = add_branches_and_mount(adm_idx, adm_uri, want_hw, m, ok, paths, urls);
+
+  gchar **bodies = g_new0(gchar*, added + 1);
+  for (guint i = 0, k = 0; i < m; ++i) {
+    AdmitKind kind = want_hw[i] ? ADMIT_HW : ADMIT_SW;
+    if (ok[i]) {
+      admission_settle(kind, g_streams[adm_idx[i]].enc_is_hw);
+      bodies[k++] = camera_change_body(adm_idx[i], adm_uri[i], "camera_add");
+    } else {
+      admission_release(kind == ADMIT_HW);
+      branch_slot_release(adm_idx[i]);
+    }
+  }
+  guint posted = !rest_backend() ? added : rest_client_post_batch("/api/v1/stream/add", bodies, added);
+  if (posted < added) LOG_WRN("REST: only %u of %u sources registered", posted, added);
+
+  GString *j = g_string_new("{\n  \"streams\": [\n");
+  gboolean first = TRUE;
+  for (guint i = 0; i < m; ++i) {
+    if (!ok[i]) continue;
+    gchar *quri = json_quote(adm_uri[i]);
+    g_string_append_printf(j, "%s    { \"index\": %u, \"path\": \"%s\", \"url\": \"%s\", \"source\": %s, \"encoder\": \"%s\" }",
+      first ? "" : ",\n", adm_idx[i], paths[i], urls[i], quri, g_streams[adm_idx[i]].enc_kind);
+    g_free(quri);
+    first = FALSE;
+  }
+  g_string_append_printf(j, "\n  ],\n  \"failed\": %u,\n  \"rejected\": %u\n}\n", m - added, rejected);
+  respond(out, req, added > 0 ? "200 OK" : "500 Internal Server Error", "application/json", j->str, j->len);
+
+  g_string_free(j, TRUE);
+  g_strfreev(bodies);
+  for (guint i = 0; i < m; ++i) { g_free(paths[i]); g_free(urls[i]); }
+  g_free(paths); g_free(urls); g_free(ok);
+  g_free(dec); g_free(want_hw); g_free(adm_idx); g_free(adm_uri); g_free(indices);
+  g_ptr_array_free(uris, TRUE);
+}
+
+static void handle_rest_stats(const CtrlRequest *req, GString *out) {
+  RestClientStats st;
+  rest_client_get_stats(&st);
+  gchar *json = g_strdup_printf(
+    "{\n  \"port\": %u,\n  \"calls\": %" G_GUINT64_FORMAT ",\n  \"failures\": %" G_GUINT64_FORMAT ",\n"
+    "  \"retries\": %" G_GUINT64_FORMAT ",\n  \"connects\": %" G_GUINT64_FORMAT ",\n  \"queued\": %u,\n"
+    "  \"latency_us\": { \"last\": %" G_GUINT64_FORMAT ", \"max\": %" G_GUINT64_FORMAT ", \"avg\": %" G_GUINT64_FORMAT " }\n}\n",
+    st.port, st.calls, st.failures, st.retries, st.connects, st.queued,
+    st.last_us, st.max_us, st.calls ? st.total_us / st.calls : 0);
+  respond_json(out, req, "200 OK", json);
+  g_free(json);
+}
+
+// Prometheus scrape; branches from the status snapshot, values from probe counters
+// (no g_state_lock, no pipeline locks).
+static void handle_metrics(const CtrlRequest *req, GString *out) {
+  const StatusSnapshot *s = status_acquire();
+  if (!s) {
+    status_release();
+    respond_json(out, req, "503 Service Unavailable", "{\n  \"error\": \"starting\"\n}\n");
+    return;
+  }
+  GString *m = g_string_new(NULL);
+  metrics_render(m, s);
+  status_release();
+  infer_render_metrics(m);
+  push_timeout_render_metrics(m);
+  respond(out, req, "200 OK", "text/plain; version=0.0.4", m->str, m->len);
+  g_string_free(m, TRUE);
+}
+
+// GET/POST /streams/{index}/config  {"bitrate_kbps", "keyframe_interval", "speed_preset", "fps"}
+// Omitted fields keep their value; fps 0 lifts the cap.
+static void respond_stream_config(GString *out, const CtrlRequest *req, guint index, const EncoderConfig *c, gboolean swapped) {
+  gchar *json = g_strdup_printf(
+    "{\n  \"stream\": \"/s%u\",\n  \"bitrate_kbps\": %u,\n  \"keyframe_interval\": %u,\n  \"speed_preset\": \"%s\",\n"
+    "  \"fps\": %u,\n  \"degrade_level\": %u,\n  \"swapped\": %s\n}\n",
+    index, c->bitrate_kbps, c->gop, c->preset, c->fps, overload_level(index), swapped ? "true" : "false");
+  respond_json(out, req, "200 OK", json);
+  g_free(json);
+}
+
+static void handle_stream_config_get(const CtrlRequest *req, GString *out) {
+  EncoderConfig c;
+  if (req->path_index < 0 || !branch_get_config((guint)req->path_index, &c)) {
+    respond_json(out, req, "404 Not Found", "{\n  \"error\": \"no_such_stream\"\n}\n");
+    return;
+  }
+  respond_stream_config(out, req, (guint)req->path_index, &c, FALSE);
+}
+
+static gboolean config_uint_member(JsonObject *obj, const char *name, guint lo, guint hi, guint *inout) {
+  if (!json_object_has_member(obj, name)) return TRUE;
+  JsonNode *n = json_object_get_member(obj, name);
+  if (!JSON_NODE_HOLDS_VALUE(n) || json_node_get_value_type(n) != G_TYPE_INT64) return FALSE;
+  gint64 v = json_node_get_int(n);
+  if (v < (gint64)lo || v > (gint64)hi) return FALSE;
+  *inout = (guint)v;
+  return TRUE;
+}
+
+static void handle_stream_config_post(const CtrlRequest *req, GString *out) {
+  static const char *const k_presets[] = { "ultrafast", "superfast", "veryfast", "faster", "fast", "medium" };
+  EncoderConfig c;
+  guint index = (guint)req->path_index;
+  if (req->path_index < 0 || !branch_get_config(index, &c)) {
+    respond_json(out, req, "404 Not Found", "{\n  \"error\": \"no_such_stream\"\n}\n");
+    return;
+  }
+  JsonParser *parser = json_parser_new();
+  gboolean parsed = req->body && json_parser_load_from_data(parser, req->body, (gssize)req->body_len, NULL);
+  JsonNode *root = parsed ? json_parser_get_root(parser) : NULL;
+  const char *err = NULL;
+  if (!root || !JSON_NODE_HOLDS_OBJECT(root)) err = "json_object_required";
+  else {
+    JsonObject *obj = json_node_get_object(root);
+    if (!config_uint_member(obj, "bitrate_kbps", 100, 100000, &c.bitrate_kbps)) err = "bad_bitrate_kbps";
+    else if (!config_uint_member(obj, "keyframe_interval", 1, 600, &c.gop)) err = "bad_keyframe_interval";
+    else if (!config_uint_member(obj, "fps", 0, 120, &c.fps)) err = "bad_fps";
+    else if (json_object_has_member(obj, "speed_preset")) {
+      const gchar *p = json_object_get_string_member(obj, "speed_preset");
+      gboolean known = FALSE;
+      for (guint i = 0; p && i < G_N_ELEMENTS(k_presets); ++i) known = known || g_strcmp0(p, k_presets[i]) == 0;
+      if (!known) err = "bad_speed_preset";
+      else if (g_strcmp0(g_streams[index].enc_kind, "x264") != 0) err = "speed_preset_needs_x264";
+      else g_strlcpy(c.preset, p, sizeof(c.preset));
+    }
+  }
+  g_object_unref(parser);
+  if (err) {
+    gchar *json = g_strdup_printf("{\n  \"error\": \"%s\"\n}\n", err);
+    respond_json(out, req, "400 Bad Request", json);
+    g_free(json);
+    return;
+  }
+  gboolean swapped = FALSE;
+  if (!branch_reconfigure(index, &c, &swapped)) {
+    if (swapped) respond_text(out, req, "500 Internal Server Error", "Error\n");
+    else respond_json(out, req, "503 Service Unavailable", "{\n  \"error\": \"encoder_busy\"\n}\n");
+    return;
+  }
+  respond_stream_config(out, req, index, &c, swapped);
+}
+
+// GET / POST / DELETE /streams/{index}/record: status, start {"segment_s", "max_files"}, stop
+static void respond_record(GString *out, const CtrlRequest *req, guint index, const RecordInfo *r) {
+  gchar *json = g_strdup_printf(
+    "{\n  \"stream\": \"/s%u\",\n  \"recording\": %s,\n  \"location\": \"%s\",\n  \"segment_s\": %u,\n"
+    "  \"max_files\": %u,\n  \"elapsed_s\": %u,\n  \"gaps\": %u\n}\n",
+    index, r->active ? "true" : "false", r->location, r->segment_s, r->max_files, r->elapsed_s, r->gaps);
+  respond_json(out, req, "200 OK", json);
+  g_free(json);
+}
+
+static void respond_record_error(GString *out, const CtrlRequest *req, RecordResult rc) {
+  if (rc == RECORD_NO_STREAM) respond_json(out, req, "404 Not Found", "{\n  \"error\": \"no_such_stream\"\n}\n");
+  else if (rc == RECORD_BUSY) respond_json(out, req, "409 Conflict", "{\n  \"error\": \"recording_state\"\n}\n");
+  else respond_text(out, req, "500 Internal Server Error", "Error\n");
+}
+
+static void handle_record_get(const CtrlRequest *req, GString *out) {
+  RecordInfo r;
+  if (!record_info((guint)req->path_index, &r)) { respond_record_error(out, req, RECORD_NO_STREAM); return; }
+  respond_record(out, req, (guint)req->path_index, &r);
+}
+
+static void handle_record_start(const CtrlRequest *req, GString *out) {
+  guint segment_s = 0, max_files = G_MAXUINT;
+  if (req->body && req->body_len > 0) {
+    JsonParser *parser = json_parser_new();
+    gboolean parsed = json_parser_load_from_data(parser, req->body, (gssize)req->body_len, NULL);
+    JsonNode *root = parsed ? json_parser_get_root(parser) : NULL;
+    const char *err = NULL;
+    if (!root || !JSON_NODE_HOLDS_OBJECT(root)) err = "json_object_required";
+    else {
+      JsonObject *obj = json_node_get_object(root);
+      if (!config_uint_member(obj, "segment_s", 1, 86400, &segment_s)) err = "bad_segment_s";
+      else if (!config_uint_member(obj, "max_files", 0, 100000, &max_files)) err = "bad_max_files";
+    }
+    g_object_unref(parser);
+    if (err) {
+      gchar *json = g_strdup_printf("{\n  \"error\": \"%s\"\n}\n", err);
+      respond_json(out, req, "400 Bad Request", json);
+      g_free(json);
+      return;
+    }
+  }
+  RecordInfo r;
+  RecordResult rc = record_start((guint)req->path_index, segment_s, max_files, &r);
+  if (rc != RECORD_OK) { respond_record_error(out, req, rc); return; }
+  respond_record(out, req, (guint)req->path_index, &r);
+}
+
+static void handle_record_stop(const CtrlRequest *req, GString *out) {
+  RecordResult rc = record_stop((guint)req->path_index);
+  RecordInfo r;
+  if (rc != RECORD_OK || !record_info((guint)req->path_index, &r)) { respond_record_error(out, req, rc != RECORD_OK ? rc : RECORD_NO_STREAM); return; }
+  respond_record(out, req, (guint)req->path_index, &r);
+}
+
+// GET /streams/{index}/snapshot.jpg: last keyframe as JPEG (decoded on demand, short-lived cache)
+static void handle_snapshot(const CtrlRequest *req, GString *out) {
+  GBytes *jpeg = NULL;
+  guint age_ms = 0;
+  gboolean cached = FALSE;
+  SnapshotResult rc = snapshot_get((guint)req->path_index, &jpeg, &age_ms, &cached);
+  if (rc == SNAPSHOT_NO_STREAM) { respond_json(out, req, "404 Not Found", "{\n  \"error\": \"no_such_stream\"\n}\n"); return; }
+  if (rc == SNAPSHOT_NO_KEYFRAME) {
+    // A lazy branch encodes only while watched: nothing to show until it has had a viewer.
+    const gchar *json = "{\n  \"error\": \"no_keyframe\"\n}\n";
+    respond_ex(out, req, "503 Service Unavailable", "Retry-After: 1\r\n", "application/json", json, strlen(json));
+    return;
+  }
+  if (rc != SNAPSHOT_OK) { respond_text(out, req, "500 Internal Server Error", "Error\n"); return; }
+  gsize len = 0;
+  const gchar *data = g_bytes_get_data(jpeg, &len);
+  gchar *hdr = g_strdup_printf("Cache-Control: no-cache\r\nX-Keyframe-Age-Ms: %u\r\nX-Snapshot-Cache: %s\r\n", age_ms, cached ? "hit" : "miss");
+  respond_ex(out, req, "200 OK", hdr, "image/jpeg", data, len);
+  g_free(hdr);
+  g_bytes_unref(jpeg);
+}
+
+// GET /latency[?reset=1]: capture -> egress percentiles per stream (reset opens a new window)
+static void handle_latency(const CtrlRequest *req, GString *out) {
+  gchar *reset = query_get(req, "reset");
+  GString *j = g_string_new(NULL);
+  latency_render_json(j, reset && g_strcmp0(reset, "0") != 0);
+  respond(out, req, "200 OK", "application/json", j->str, j->len);
+  g_string_free(j, TRUE);
+  g_free(reset);
+}
+
+static void handle_admission(const CtrlRequest *req, GString *out) {
+  AdmissionModel m; AdmissionLoad l;
+  admission_get(&m, &l);
+  AdmitDecision next = admission_decide(&m, &l);
+  gchar *json = g_strdup_printf(
+    "{\n  \"hw_slots\": %u,\n  \"hw_active\": %u,\n  \"sw_active\": %u,\n  \"sw_fps_per_core\": %.1f,\n"
+    "  \"stream_fps\": %.1f,\n  \"cores\": %.0f,\n  \"reserve\": %.2f,\n  \"cpu_busy\": %.3f,\n  \"sw_since_sample\": %u,\n"
+    "  \"next\": \"%s\"\n}\n",
+    m.hw_slots, l.hw_active, l.sw_active, m.sw_fps_per_core, m.stream_fps, m.cores, m.reserve, l.cpu_busy, l.sw_since_sample,
+    next.kind == ADMIT_HW ? "hw" : (next.kind == ADMIT_SW ? "sw" : "reject"));
+  respond_json(out, req, "200 OK", json);
+  g_free(json);
+}
+
+// --- Sharded front (SHARDS > 1): every stream route is forwarded to a shard process
+// Relays the shard's answer, tagging JSON objects with "shard" so callers can address
+// the stream again (?shard=S on remove/config/source).
+static void respond_forwarded(GString *out, const CtrlRequest *req, guint s, const gchar *status, const gchar *body, guint retry_after) {
+  gchar *json = NULL;
+  JsonParser *parser = json_parser_new();
+  if (body && *body == '{' && json_parser_load_from_data(parser, body, -1, NULL)) {
+    JsonNode *root = json_parser_get_root(parser);
+    json_object_set_int_member(json_node_get_object(root), "shard", s);
+    JsonGenerator *gen = json_generator_new();
+    json_generator_set_pretty(gen, TRUE);
+    json_generator_set_root(gen, root);
+    gchar *text = json_generator_to_data(gen, NULL);
+    json = g_strconcat(text, "\n", NULL);
+    g_free(text);
+    g_object_unref(gen);
+  }
+  g_object_unref(parser);
+  gchar *hdr = retry_after ? g_strdup_printf("Retry-After: %u\r\n", retry_after) : NULL;
+  const gchar *payload = json ? json : (body ? body : "");
+  respond_ex(out, req, status, hdr, json ? "application/json" : "text/plain", payload, strlen(payload));
+  g_free(hdr); g_free(json);
+}
+
+static void forward_to_shard(const CtrlRequest *req, GString *out, guint s) {
+  gchar *target = req->query ? g_strconcat(req->path, "?", req->query, NULL) : g_strdup(req->path);
+  gchar *status = NULL, *body = NULL;
+  guint retry_after = 0;
+  if (shard_front_forward(s, req->method, target, req->body, &status, &body, &retry_after)) {
+    respond_forwarded(out, req, s, status, body, retry_after);
+  } else {
+    gchar *json = g_strdup_printf("{\n  \"error\": \"shard_unavailable\",\n  \"shard\": %u\n}\n", s);
+    respond_json(out, req, "502 Bad Gateway", json);
+    g_free(json);
+  }
+  g_free(target); g_free(status); g_free(body);
+}
+
+static void handle_front_status(const CtrlRequest *req, GString *out) {
+  gchar *json = shard_front_status_json();
+  respond_json(out, req, "200 OK", json);
+  g_free(json);
+}
+
+// Adds go to the least-loaded live shard (a batch stays on one shard), picked when
+// the request is queued; -1 means none had room.
+static void handle_front_add(const CtrlRequest *req, GString *out) {
+  if (req->shard < 0) {
+    respond_json(out, req, "429 Too Many Requests", "{\n  \"error\": \"capacity_exceeded\"\n}\n");
+    return;
+  }
+  forward_to_shard(req, out, (guint)req->shard);
+  shard_front_refresh((guint)req->shard);
+}
+
+// Anything addressing an existing stream names its shard: ?shard=S. -1 if missing or out of range.
+static gint front_shard_query(const CtrlRequest *req) {
+  gchar *sv = query_get(req, "shard");
+  gchar *end = NULL;
+  guint64 v = sv ? g_ascii_strtoull(sv, &end, 10) : 0;
+  gboolean valid = sv && *sv && end && *end == '\0' && v < shard_front_count();
+  g_free(sv);
+  return valid ? (gint)v : -1;
+}
+
+static gboolean front_shard_arg(const CtrlRequest *req, GString *out, guint *s) {
+  if (req->shard < 0) {
+    respond_json(out, req, "400 Bad Request", "{\n  \"error\": \"shard_required\"\n}\n");
+    return FALSE;
+  }
+  *s = (guint)req->shard;
+  return TRUE;
+}
+
+static void handle_front_stream(const CtrlRequest *req, GString *out) {
+  guint s = 0;
+  if (!front_shard_arg(req, out, &s)) return;
+  forward_to_shard(req, out, s);
+  if (g_strcmp0(req->path, "/remove_stream") == 0) shard_front_refresh(s);
+}
+
+// Snapshots are binary: relay the shard's body and content type untouched.
+static void handle_front_snapshot(const CtrlRequest *req, GString *out) {
+  guint s = 0;
+  if (!front_shard_arg(req, out, &s)) return;
+  gchar *status = NULL, *ctype = NULL, *body = NULL;
+  gsize len = 0;
+  if (shard_front_fetch(s, req->path, &status, &ctype, &body, &len)) {
+    respond_ex(out, req, status, "Cache-Control: no-cache\r\n", ctype, body, len);
+  } else {
+    gchar *json = g_strdup_printf("{\n  \"error\": \"shard_unavailable\",\n  \"shard\": %u\n}\n", s);
+    respond_json(out, req, "502 Bad Gateway", json);
+    g_free(json);
+  }
+  g_free(status); g_free(ctype); g_free(body);
+}
+
+typedef void (*CtrlHandler)(const CtrlRequest *req, GString *out);
+
+// Where a route's handler runs.
+typedef enum {
+  LANE_INLINE,    // on the epoll thread (cheap, never blocks)
+  LANE_WORKER,    // on the control worker (may take g_state_lock / build branches)
+  LANE_SNAPSHOT,  // on the snapshot pool (decodes; never mutates g_streams)
+  LANE_SHARD_ADD, // front: on the worker of the shard picked for the add
+  LANE_SHARD,     // front: on the worker of the ?shard=S it addresses
+} CtrlLane;
+
+typedef struct {
+  const char *method;
+  const char *path;
+  CtrlHandler fn;
+  CtrlLane lane;
+} CtrlRoute;
+
+static const CtrlRoute k_routes[] = {
+  { "GET", "/status",          handle_status,          LANE_INLINE },
+  { "GET", "/add_demo_stream", handle_add_demo_stream, LANE_WORKER },
+  { "GET", "/remove_stream",   handle_remove_stream,   LANE_WORKER },
+  { "POST", "/add_streams",    handle_add_streams,     LANE_WORKER },
+  { "GET", "/rest_stats",      handle_rest_stats,      LANE_INLINE },
+  { "GET", "/admission",       handle_admission,       LANE_INLINE },
+  { "GET", "/metrics",         handle_metrics,         LANE_INLINE },
+  { "GET", "/latency",         handle_latency,         LANE_INLINE },
+  { "GET", "/streams/{index}/config",  handle_stream_config_get,  LANE_WORKER },
+  { "POST", "/streams/{index}/config", handle_stream_config_post, LANE_WORKER },
+  { "POST", "/streams/{index}/source", handle_stream_source,      LANE_WORKER },
+  { "GET", "/streams/{index}/record",    handle_record_get,   LANE_WORKER },
+  { "POST", "/streams/{index}/record",   handle_record_start, LANE_WORKER },
+  { "DELETE", "/streams/{index}/record", handle_record_stop,  LANE_WORKER },
+  { "GET", "/streams/{index}/snapshot.jpg", handle_snapshot,  LANE_SNAPSHOT },
+};
+
+static const CtrlRoute k_front_routes[] = {
+  { "GET", "/status",          handle_front_status,    LANE_INLINE },
+  { "GET", "/add_demo_stream", handle_front_add,       LANE_SHARD_ADD },
+  { "POST", "/add_streams",    handle_front_add,       LANE_SHARD_ADD },
+  { "GET", "/remove_stream",   handle_front_stream,    LANE_SHARD },
+  { "GET", "/latency",         handle_front_stream,    LANE_SHARD },
+  { "GET", "/streams/{index}/config",  handle_front_stream, LANE_SHARD },
+  { "POST", "/streams/{index}/config", handle_front_stream, LANE_SHARD },
+  { "POST", "/streams/{index}/source", handle_front_stream, LANE_SHARD },
+  { "GET", "/streams/{index}/record",    handle_front_stream, LANE_SHARD },
+  { "POST", "/streams/{index}/record",   handle_front_stream, LANE_SHARD },
+  { "DELETE", "/streams/{index}/record", handle_front_stream, LANE_SHARD },
+  { "GET", "/streams/{index}/snapshot.jpg", handle_front_snapshot, LANE_SHARD },
+};
+
+static const CtrlRoute *s_routes = k_routes;
+static guint s_n_routes = G_N_ELEMENTS(k_routes);
+
+void control_use_front_routes(void) {
+  s_routes = k_front_routes;
+  s_n_routes = G_N_ELEMENTS(k_front_routes);
+}
+
+// Exact match, except that "{index}" in pattern matches one decimal path segment.
+static gboolean route_match(const char *pattern, const char *path, gint *index) {
+  const char *hole = strstr(pattern, "{index}");
+  if (!hole) return g_strcmp0(pattern, path) == 0;
+  gsize pre = (gsize)(hole - pattern);
+  if (strncmp(path, pattern, pre) != 0 || !g_ascii_isdigit(path[pre])) return FALSE;
+  gchar *end = NULL;
+  guint64 v = g_ascii_strtoull(path + pre, &end, 10);
+  if (v >= G_N_ELEMENTS(g_streams) || g_strcmp0(end, hole + strlen("{index}")) != 0) return FALSE;
+  *index = (gint)v;
+  return TRUE;
+}
+
+static const CtrlRoute *find_route(CtrlRequest *req) {
+  for (guint i = 0; i < s_n_routes; ++i) {
+    if (g_strcmp0(req->method, s_routes[i].method) == 0 && route_match(s_routes[i].path, req->path, &req->path_index)) return &s_routes[i];
+  }
+  return NULL;
+}
+
+// --- Connections
+typedef struct {
+  int fd;              // -1 once closed
+  GString *in;         // bytes received, not yet parsed
+  GString *out;        // bytes to send
+  gsize out_off;
+  gint64 last_active_us;
+  gboolean busy;       // a request is running on a worker
+  gboolean close_after_write;
+  guint32 events;      // current epoll interest
+} CtrlConn;
+
+typedef struct {
+  CtrlConn *conn;
+  CtrlRequest *req;
+  const CtrlRoute *route;
+  GString *out;
+} CtrlJob;
+
+typedef struct {
+  int epfd;
+  int listen_fd;
+  int wake_fd;           // eventfd signalled by the worker when a job is done
+  GHashTable *conns;     // CtrlConn* set
+  GThreadPool *workers;
+  GThreadPool *snapshots;  // SNAPSHOT_THREADS decoders, so a snapshot never queues behind an add
+  GThreadPool *shard_workers[SHARD_MAX]; // front: one per shard, so a hung shard stalls only its own requests
+  GAsyncQueue *done;     // finished CtrlJob*
+  GSList *dead;          // closed CtrlConn*, freed once the current epoll batch is handled
+  guint timeout_ms;
+  gsize max_request;
+  guint max_conns;
+} CtrlServer;
+
+// epoll data tags for the two non-connection fds
+static char k_tag_listen, k_tag_wake;
+
+static void conn_free(CtrlConn *conn) {
+  g_string_free(conn->in, TRUE);
+  g_string_free(conn->out, TRUE);
+  g_free(conn);
+}
+
+// conn may still have an entry later in the events[] batch being handled (which
+// then sees fd < 0), so it is only freed after the batch.
+static void conn_retire(CtrlServer *srv, CtrlConn *conn) {
+  g_hash_table_remove(srv->conns, conn);
+  srv->dead = g_slist_prepend(srv->dead, conn);
+}
+
+static void conn_close(CtrlServer *srv, CtrlConn *conn) {
+  if (conn->fd >= 0) {
+    epoll_ctl(srv->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn->fd = -1;
+  }
+  // A running job still references conn; it is released when the job returns.
+  if (conn->busy) return;
+  conn_retire(srv, conn);
+}
+
+static void conn_want(CtrlServer *srv, CtrlConn *conn, guint32 events) {
+  if (conn->fd < 0 || conn->events == events) return;
+  struct epoll_event ev = { .events = events, .data.ptr = conn };
+  epoll_ctl(srv->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+  conn->events = events;
+}
+
+// No EPOLLIN while a job runs: the client cannot grow conn->in (or spin the
+// level-triggered loop) until the job is done and the connection is re-armed.
+static void conn_rearm(CtrlServer *srv, CtrlConn *conn) {
+  guint32 events = conn->busy ? 0 : EPOLLIN;
+  if (conn->out_off < conn->out->len) events |= EPOLLOUT;
+  conn_want(srv, conn, events);
+}
+
+// Send pending output. Returns FALSE if the connection was closed.
+static gboolean conn_flush(CtrlServer *srv, CtrlConn *conn) {
+  while (conn->out_off < conn->out->len) {
+    ssize_t n = send(conn->fd, conn->out->str + conn->out_off, conn->out->len - conn->out_off, MSG_NOSIGNAL);
+    if (n > 0) { conn->out_off += (gsize)n; conn->last_active_us = g_get_monotonic_time(); continue; }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { conn_rearm(srv, conn); return TRUE; }
+    conn_close(srv, conn);
+    return FALSE;
+  }
+  g_string_truncate(conn->out, 0);
+  conn->out_off = 0;
+  if (conn->close_after_write) { conn_close(srv, conn); return FALSE; }
+  conn_rearm(srv, conn);
+  return TRUE;
+}
+
+typedef enum { PARSE_MORE, PARSE_OK, PARSE_BAD, PARSE_TOO_LARGE } ParseResult;
+
+// Parse one request from the front of conn->in and consume its bytes.
+static ParseResult parse_request(CtrlConn *conn, gsize max_request, CtrlRequest **out_req) {
+  const gchar *buf = conn->in->str;
+  const gchar *hdr_end = g_strstr_len(buf, (gssize)conn->in->len, "\r\n\r\n");
+  if (!hdr_end) return conn->in->len > max_request ? PARSE_TOO_LARGE : PARSE_MORE;
+  gsize hdr_len = (gsize)(hdr_end - buf) + 4;
+
+  const gchar *line_end = strstr(buf, "\r\n");
+  gchar *line = g_strndup(buf, (gsize)(line_end - buf));
+  gchar **parts = g_strsplit(line, " ", 3);
+  g_free(line);
+  if (g_strv_length(parts) != 3 || !g_str_has_prefix(parts[2], "HTTP/1.")) { g_strfreev(parts); return PARSE_BAD; }
+
+  CtrlRequest *req = g_new0(CtrlRequest, 1);
+  req->path_index = -1;
+  req->shard = -1;
+  req->method = g_strdup(parts[0]);
+  gchar *q = strchr(parts[1], '?');
+  if (q) { req->query = g_strdup(q + 1); *q = '\0'; }
+  req->path = g_strdup(parts[1]);
+  req->keep_alive = g_strcmp0(parts[2], "HTTP/1.0") != 0;
+  g_strfreev(parts);
+
+  // Content-Length: digits only, at most once, never above max_request (so the
+  // header + body sum below cannot wrap).
+  gsize content_len = 0;
+  gboolean have_len = FALSE;
+  ParseResult bad = PARSE_OK;
+  const gchar *p = line_end + 2;
+  while (p < hdr_end && bad == PARSE_OK) {
+    const gchar *eol = strstr(p, "\r\n");
+    if (g_ascii_strncasecmp(p, "Content-Length:", 15) == 0) {
+      gchar *v = g_strstrip(g_strndup(p + 15, (gsize)(eol - p - 15)));
+      guint64 len = 0;
+      GError *err = NULL;
+      if (have_len || !*v || v[strspn(v, "0123456789")] != '\0') bad = PARSE_BAD;
+      else if (!g_ascii_string_to_unsigned(v, 10, 0, max_request, &len, &err))
+        bad = g_error_matches(err, G_NUMBER_PARSER_ERROR, G_NUMBER_PARSER_ERROR_OUT_OF_BOUNDS) ? PARSE_TOO_LARGE : PARSE_BAD;
+      g_clear_error(&err);
+      g_free(v);
+      content_len = (gsize)len;
+      have_len = TRUE;
+    } else if (g_ascii_strncasecmp(p, "Connection:", 11) == 0) {
+      gchar *v = g_strstrip(g_strndup(p + 11, (gsize)(eol - p - 11)));
+      if (g_ascii_strcasecmp(v, "close") == 0) req->keep_alive = FALSE;
+      else if (g_ascii_strcasecmp(v, "keep-alive") == 0) req->keep_alive = TRUE;
+      g_free(v);
+    }
+    p = eol + 2;
+  }
+
+  if (bad != PARSE_OK) { ctrl_request_free(req); return bad; }
+  if (hdr_len > max_request || content_len > max_request - hdr_len) { ctrl_request_free(req); return PARSE_TOO_LARGE; }
+  if (conn->in->len < hdr_len + content_len) { ctrl_request_free(req); return PARSE_MORE; }
+  if (content_len > 0) {
+    req->body = g_strndup(buf + hdr_len, content_len);
+    req->body_len = content_len;
+  }
+  g_string_erase(conn->in, 0, (gssize)(hdr_len + content_len));
+  *out_req = req;
+  return PARSE_OK;
+}
+
+// Worker for a non-inline route, or NULL to run it inline. Front routes resolve
+// their shard here; without one the handler answers 429/400 without blocking.
+static GThreadPool *route_pool(CtrlServer *srv, const CtrlRoute *route, CtrlRequest *req) {
+  switch (route->lane) {
+  case LANE_INLINE: return NULL;
+  case LANE_WORKER: return srv->workers;
+  case LANE_SNAPSHOT: return srv->snapshots;
+  case LANE_SHARD_ADD: req->shard = shard_front_pick(); break;
+  case LANE_SHARD: req->shard = front_shard_query(req); break;
+  }
+  return req->shard >= 0 ? srv->shard_workers[req->shard] : NULL;
+}
+
+// Handle every complete request buffered on conn (stops at one queued to a worker).
+static void conn_process(CtrlServer *srv, CtrlConn *conn) {
+  while (!conn->busy && !conn->close_after_write && conn->in->len > 0) {
+    CtrlRequest *req = NULL;
+    ParseResult pr = parse_request(conn, srv->max_request, &req);
+    if (pr == PARSE_MORE) break;
+    if (pr == PARSE_TOO_LARGE) {
+      respond_text(conn->out, NULL, "413 Payload Too Large", "Too Large\n");
+      conn->close_after_write = TRUE;
+      break;
+    }
+    if (pr == PARSE_BAD) {
+      respond_text(conn->out, NULL, "400 Bad Request", "Bad Request\n");
+      conn->close_after_write = TRUE;
+      break;
+    }
+    if (!req->keep_alive) conn->close_after_write = TRUE;
+    const CtrlRoute *route = find_route(req);
+    if (!route) {
+      respond_text(conn->out, req, "404 Not Found", "Not Found");
+      ctrl_request_free(req);
+      continue;
+    }
+    GThreadPool *pool = route_pool(srv, route, req);
+    if (pool) {
+      CtrlJob *job = g_new0(CtrlJob, 1);
+      job->conn = conn; job->req = req; job->route = route; job->out = g_string_new(NULL);
+      conn->busy = TRUE;
+      g_thread_pool_push(pool, job, NULL);
+      break;
+    }
+    route->fn(req, conn->out);
+    ctrl_request_free(req);
+  }
+  if (conn->out->len > conn->out_off) (void)conn_flush(srv, conn);
+  else conn_rearm(srv, conn);
+}
+
+static void conn_read(CtrlServer *srv, CtrlConn *conn) {
+  char buf[4096];
+  for (;;) {
+    ssize_t n = recv(conn->fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+      g_string_append_len(conn->in, buf, n);
+      conn->last_active_us = g_get_monotonic_time();
+      if (conn->in->len > srv->max_request) break;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    conn_close(srv, conn); // peer closed or error
+    return;
+  }
+  conn_process(srv, conn);
+  // Not busy, an oversized request already got its 413 above.
+  if (conn->fd >= 0 && conn->busy && conn->in->len > srv->max_request) conn_close(srv, conn);
+}
+
+static void accept_all(CtrlServer *srv) {
+  for (;;) {
+    int c = accept4(srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (c < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) LOG_WRN("CTRL: accept failed: %s", g_strerror(errno));
+      return;
+    }
+    if (g_hash_table_size(srv->conns) >= srv->max_conns) {
+      LOG_WRN("CTRL: connection limit (%u) reached; dropping client", srv->max_conns);
+      close(c);
+      continue;
+    }
+    CtrlConn *conn = g_new0(CtrlConn, 1);
+    conn->fd = c;
+    conn->in = g_string_sized_new(1024);
+    conn->out = g_string_sized_new(1024);
+    conn->last_active_us = g_get_monotonic_time();
+    conn->events = EPOLLIN;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = conn };
+    if (epoll_ctl(srv->epfd, EPOLL_CTL_ADD, c, &ev) != 0) { close(c); conn_free(conn); continue; }
+    g_hash_table_add(srv->conns, conn);
+  }
+}
+
+// Worker side: run the handler, then hand the result back to the epoll thread.
+static void worker_run(gpointer data, gpointer user_data) {
+  CtrlJob *job = (CtrlJob*)data;
+  CtrlServer *srv = (CtrlServer*)user_data;
+  job->route->fn(job->req, job->out);
+  g_async_queue_push(srv->done, job);
+  guint64 one = 1;
+  if (write(srv->wake_fd, &one, sizeof(one)) < 0) LOG_WRN("CTRL: wake write failed");
+}
+
+static void drain_done_jobs(CtrlServer *srv) {
+  guint64 cnt;
+  while (read(srv->wake_fd, &cnt, sizeof(cnt)) > 0) {}
+  CtrlJob *job;
+  while ((job = g_async_queue_try_pop(srv->done)) != NULL) {
+    CtrlConn *conn = job->conn;
+    conn->busy = FALSE;
+    if (conn->fd < 0) {
+      conn_retire(srv, conn);
+    } else {
+      g_string_append_len(conn->out, job->out->str, (gssize)job->out->len);
+      conn->last_active_us = g_get_monotonic_time();
+      if (conn_flush(srv, conn)) conn_process(srv, conn);
+    }
+    ctrl_request_free(job->req);
+    g_string_free(job->out, TRUE);
+    g_free(job);
+  }
+}
+
+static void expire_idle(CtrlServer *srv) {
+  gint64 cutoff = g_get_monotonic_time() - (gint64)srv->timeout_ms * 1000;
+  GHashTableIter it; gpointer key;
+  GSList *stale = NULL;
+  g_hash_table_iter_init(&it, srv->conns);
+  while (g_hash_table_iter_next(&it, &key, NULL)) {
+    CtrlConn *conn = (CtrlConn*)key;
+    if (!conn->busy && conn->fd >= 0 && conn->last_active_us < cutoff) stale = g_slist_prepend(stale, conn);
+  }
+  for (GSList *l = stale; l; l = l->next) conn_close(srv, (CtrlConn*)l->data);
+  g_slist_free(stale);
+}
+
 gpointer control_http_thread(gpointer data) {
   (void)data;
-  int s = create_ctrl_listener();
-  if (s < 0) return NULL;
+  static CtrlServer srv; // outlives this frame: the worker pool points at it
+  srv.listen_fd = create_ctrl_listener();
+  if (srv.listen_fd < 0) return NULL;
+  srv.timeout_ms = config_env_uint("CTRL_TIMEOUT_MS", 5000);
+  srv.max_request = config_env_uint("CTRL_MAX_REQUEST_BYTES", 1024 * 1024);
+  srv.max_conns = config_env_uint("CTRL_MAX_CONNS", 1024);
+  srv.epfd = epoll_create1(EPOLL_CLOEXEC);
+  srv.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (srv.epfd < 0 || srv.wake_fd < 0) {
+    LOG_ERR("CTRL: epoll/eventfd setup failed");
+    if (srv.epfd >= 0) close(srv.epfd);
+    if (srv.wake_fd >= 0) close(srv.wake_fd);
+    close(srv.listen_fd);
+    return NULL;
+  }
+  struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &k_tag_listen };
+  epoll_ctl(srv.epfd, EPOLL_CTL_ADD, srv.listen_fd, &ev);
+  ev.data.ptr = &k_tag_wake;
+  epoll_ctl(srv.epfd, EPOLL_CTL_ADD, srv.wake_fd, &ev);
+  srv.conns = g_hash_table_new(g_direct_hash, g_direct_equal);
+  srv.done = g_async_queue_new();
+  // A single worker keeps stream mutations (and their REST posts) in request order.
+  srv.workers = g_thread_pool_new(worker_run, &srv, 1, FALSE, NULL);
+  srv.snapshots = g_thread_pool_new(worker_run, &srv, (gint)CLAMP(config_env_uint("SNAPSHOT_THREADS", 2), 1, 16), FALSE, NULL);
+  // Likewise per shard on the front: requests to one shard stay in order.
+  if (s_routes == k_front_routes) {
+    for (guint i = 0; i < shard_front_count(); ++i) srv.shard_workers[i] = g_thread_pool_new(worker_run, &srv, 1, FALSE, NULL);
+  }
+
+  struct epoll_event events[64];
+  gint64 next_sweep = g_get_monotonic_time() + CTRL_TICK_MS * 1000;
   for (;;) {
-    int c = accept(s, NULL, NULL);
-    if (c < 0) continue;
-    char buf[1024]; ssize_t n = recv(c, buf, sizeof(buf)-1, 0);
-    if (n <= 0) { close(c); continue; }
-    buf[n] = '\0';
-    handle_request(c, buf);
-    close(c);
+    int n = epoll_wait(srv.epfd, events, G_N_ELEMENTS(events), CTRL_TICK_MS);
+    if (n < 0 && errno != EINTR) { LOG_ERR("CTRL: epoll_wait failed: %s", g_strerror(errno)); break; }
+    for (int i = 0; i < n; ++i) {
+      void *tag = events[i].data.ptr;
+      if (tag == &k_tag_listen) { accept_all(&srv); continue; }
+      if (tag == &k_tag_wake) { drain_done_jobs(&srv); continue; }
+      CtrlConn *conn = (CtrlConn*)tag;
+      if (conn->fd < 0) continue;
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) { conn_close(&srv, conn); continue; }
+      if ((events[i].events & EPOLLOUT) && !conn_flush(&srv, conn)) continue;
+      if (events[i].events & EPOLLIN) conn_read(&srv, conn);
+    }
+    for (GSList *l = srv.dead; l; l = l->next) conn_free((CtrlConn*)l->data);
+    g_slist_free(srv.dead);
+    srv.dead = NULL;
+    gint64 now = g_get_monotonic_time();
+    if (now >= next_sweep) { expire_idle(&srv); next_sweep = now + CTRL_TICK_MS * 1000; }
   }
   return NULL;
 }
-
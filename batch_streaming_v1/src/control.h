@@ -1,10 +1,13 @@
-// Tiny control HTTP server (/add_demo_stream, /status)
+// Tiny control HTTP server (/add_demo_stream, /add_streams, /remove_stream, /status)
 #ifndef CONTROL_H
 #define CONTROL_H
 
 #include <glib.h>
 
 gpointer control_http_thread(gpointer data);
+// Sharded front (shard.c): serve the routing table instead of the pipeline routes.
+// Call before starting control_http_thread.
+void control_use_front_routes(void);
 
 #endif // CONTROL_H
 
@@ -0,0 +1,130 @@
+// Core budget for software encoder branches (L2)
+// - Pure split of a CPU range over the running x264 branches (cpu_budget_allocate).
+// - New branches get a thread count sized to their share; existing encoders keep theirs
+//   (x264enc cannot change threads while PLAYING), so rebalancing moves CPU affinity only.
+// - Each branch queue is named q_sN; its streaming thread is "q_sN:src" and x264 worker
+//   threads inherit that name, so one /proc/self/task scan finds every thread of a branch.
+// - Slices are re-applied every 2s to catch encoder threads spawned after the first caps.
+#define _GNU_SOURCE
+#include <sched.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include "log.h"
+#include "config.h"
+#include "state.h"
+#include "cpu_budget.h"
+
+#define CPU_BUDGET_REAPPLY_S 2
+
+static GMutex s_lock;
+static guint s_budget = 0;          // 0 = allocator off
+static guint s_first_cpu = 0;
+static guint s_max_threads = 4;
+static CoreSlice s_slices[G_N_ELEMENTS(g_streams)];
+static gboolean s_pinned[G_N_ELEMENTS(g_streams)];
+static guint s_sw_count = 0;
+
+void cpu_budget_allocate(guint budget, guint first_cpu, guint max_threads, guint n, CoreSlice *out) {
+  if (n == 0 || budget == 0) return;
+  if (n > budget) {
+    // Oversubscribed: one CPU each, spread evenly so no CPU carries two more than another.
+    for (guint i = 0; i < n; ++i) {
+      out[i].first_cpu = first_cpu + (guint)(((guint64)i * budget) / n);
+      out[i].ncpus = 1;
+      out[i].threads = 1;
+    }
+    return;
+  }
+  guint base = budget / n, extra = budget % n, cpu = first_cpu;
+  for (guint i = 0; i < n; ++i) {
+    out[i].first_cpu = cpu;
+    out[i].ncpus = base + (i < extra ? 1 : 0);
+    out[i].threads = max_threads > 0 ? MIN(out[i].ncpus, max_threads) : out[i].ncpus;
+    cpu += out[i].ncpus;
+  }
+}
+
+guint cpu_budget_threads_for(guint n_sw) {
+  if (s_budget == 0) {
+    // Allocator off: the historical per-branch default.
+    guint cores = (guint) g_get_num_processors();
+    return MIN(MAX(1, cores / 2), s_max_threads);
+  }
+  if (n_sw == 0) n_sw = 1;
+  if (n_sw > s_budget) return 1;
+  return MIN(s_budget / n_sw, s_max_threads);
+}
+
+static void pin_tid(pid_t tid, const CoreSlice *sl) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (guint c = sl->first_cpu; c < sl->first_cpu + sl->ncpus && c < CPU_SETSIZE; ++c) CPU_SET(c, &set);
+  if (sched_setaffinity(tid, sizeof(set), &set) != 0) LOG_WRN("CPU budget: sched_setaffinity(%d) failed", (int)tid);
+}
+
+static gboolean reapply(gpointer data) {
+  (void)data;
+  if (s_budget == 0) return G_SOURCE_REMOVE;
+  CoreSlice slices[G_N_ELEMENTS(g_streams)];
+  gboolean pinned[G_N_ELEMENTS(g_streams)];
+  g_mutex_lock(&s_lock);
+  memcpy(slices, s_slices, sizeof(slices));
+  memcpy(pinned, s_pinned, sizeof(pinned));
+  g_mutex_unlock(&s_lock);
+
+  DIR *d = opendir("/proc/self/task");
+  if (!d) return G_SOURCE_CONTINUE;
+  struct dirent *de;
+  while ((de = readdir(d)) != NULL) {
+    if (de->d_name[0] == '.') continue;
+    gchar comm_path[64], comm[32] = { 0 };
+    g_snprintf(comm_path, sizeof(comm_path), "/proc/self/task/%s/comm", de->d_name);
+    FILE *f = fopen(comm_path, "r");
+    if (!f) continue;
+    gboolean got = fgets(comm, sizeof(comm), f) != NULL;
+    fclose(f);
+    guint index = 0;
+    char tail[8] = { 0 };
+    if (!got || sscanf(comm, "q_s%u:%7s", &index, tail) != 2 || strcmp(tail, "src") != 0) continue;
+    if (index >= G_N_ELEMENTS(g_streams) || !pinned[index]) continue;
+    pin_tid((pid_t) g_ascii_strtoull(de->d_name, NULL, 10), &slices[index]);
+  }
+  closedir(d);
+  return G_SOURCE_CONTINUE;
+}
+
+void cpu_budget_init(void) {
+  guint cpus = (guint) g_get_num_processors();
+  s_first_cpu = MIN(config_env_uint("CPU_BUDGET_FIRST", 0), cpus - 1);
+  s_budget = MIN(config_env_uint("CPU_BUDGET_CORES", cpus), cpus - s_first_cpu);
+  s_max_threads = MAX(1, config_env_uint("X264_THREADS", 4));
+  if (s_budget == 0) { LOG_INF("CPU budget: off (x264 threads=%u, no pinning)", s_max_threads); return; }
+  LOG_INF("CPU budget: x264 branches share CPUs %u-%u (max %u threads each)", s_first_cpu, s_first_cpu + s_budget - 1, s_max_threads);
+  g_timeout_add_seconds(CPU_BUDGET_REAPPLY_S, reapply, NULL);
+}
+
+void cpu_budget_rebalance(void) {
+  if (s_budget == 0) return;
+  guint sw_idx[G_N_ELEMENTS(g_streams)];
+  guint n = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(g_streams); ++i) {
+    if (g_streams[i].in_use && !g_streams[i].enc_is_hw) sw_idx[n++] = i;
+  }
+  CoreSlice alloc[G_N_ELEMENTS(g_streams)];
+  cpu_budget_allocate(s_budget, s_first_cpu, s_max_threads, n, alloc);
+
+  g_mutex_lock(&s_lock);
+  gboolean changed = (n != s_sw_count);
+  memset(s_pinned, 0, sizeof(s_pinned));
+  for (guint k = 0; k < n; ++k) {
+    s_slices[sw_idx[k]] = alloc[k];
+    s_pinned[sw_idx[k]] = TRUE;
+  }
+  s_sw_count = n;
+  g_mutex_unlock(&s_lock);
+
+  if (changed) LOG_INF("CPU budget: %u software branch(es) over %u CPU(s)", n, s_budget);
+  (void) reapply(NULL);
+}
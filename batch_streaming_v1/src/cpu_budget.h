@@ -0,0 +1,27 @@
+// Core budget for software encoder branches: thread count + CPU affinity per branch
+#ifndef CPU_BUDGET_H
+#define CPU_BUDGET_H
+
+#include <glib.h>
+
+typedef struct {
+  guint first_cpu; // first CPU of the slice
+  guint ncpus;     // slice width (consecutive CPUs)
+  guint threads;   // encoder threads for this branch
+} CoreSlice;
+
+// Pure split of CPUs [first_cpu, first_cpu+budget) over n branches. With n <= budget
+// each branch gets its own consecutive CPUs; beyond that branches share single CPUs.
+// max_threads caps the per-branch thread count (0 = no cap).
+void cpu_budget_allocate(guint budget, guint first_cpu, guint max_threads, guint n, CoreSlice *out);
+
+// CPU_BUDGET_CORES (default: all, 0 disables) and CPU_BUDGET_FIRST select the CPUs;
+// X264_THREADS caps threads per branch. Starts the periodic re-pin on the default context.
+void cpu_budget_init(void);
+// x264 threads for a new branch when n_sw software branches (itself included) will run.
+guint cpu_budget_threads_for(guint n_sw);
+// Recompute slices from g_streams and re-pin every software branch. Call with
+// g_state_lock held, after adding or removing branches.
+void cpu_budget_rebalance(void);
+
+#endif // CPU_BUDGET_H
@@ -0,0 +1,158 @@
+// Adaptive inference interval (L2)
+// - pgie.txt pins interval=0 (every batch inferred); under load that turns straight
+//   into dropped output. This raises nvinfer's interval while the mean batch time
+//   (pgie sink -> src, paired by PTS) sits near the frame budget, and lowers it again
+//   once the load predicted one step down is comfortably below it.
+// - Hysteresis: separate high/low thresholds plus consecutive-tick counts; one step
+//   of INFER_STEP per decision. One tick per second on the default context.
+// - Probes only touch atomics; the control law (infer_ctl_step) is pure.
+#include <string.h>
+#include "log.h"
+#include "config.h"
+#include "infer.h"
+
+#define INFER_RING 16
+
+typedef struct {
+  guint64 pts;
+  gint64 t_us;
+} InferSlot;
+
+static gboolean s_adapt = TRUE;
+static InferCtlParams s_params;
+static InferCtlState s_state;
+static GstElement *s_pgie = NULL;    // reffed; steered only when it has "interval"
+static gboolean s_steer = FALSE;
+static InferSlot s_ring[INFER_RING];
+static guint s_ring_w = 0;           // pgie sink streaming thread only
+static guint64 s_sum_us = 0, s_count = 0;
+static guint64 s_last_us = 0;        // mean batch time of the last tick (metrics)
+
+#define I_ADD(field, v) __atomic_fetch_add(&(field), (v), __ATOMIC_RELAXED)
+#define I_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define I_SET(field, v) __atomic_store_n(&(field), (v), __ATOMIC_RELAXED)
+#define I_TAKE(field) __atomic_exchange_n(&(field), 0, __ATOMIC_RELAXED)
+
+gboolean infer_ctl_step(InferCtlState *st, const InferCtlParams *p, guint64 batch_us) {
+  guint64 high = p->budget_us * p->high_pct / 100;
+  guint64 low = p->budget_us * p->low_pct / 100;
+  if (batch_us >= high) st->hot++;
+  else st->hot = 0;
+  // Inference cost is spread over interval+1 batches: predict the load one step down.
+  guint next = st->interval >= p->min_interval + p->step ? st->interval - p->step : p->min_interval;
+  guint64 predicted = batch_us * (st->interval + 1) / (next + 1);
+  if (st->interval > p->min_interval && batch_us < high && predicted <= low) st->cool++;
+  else st->cool = 0;
+
+  if (st->hot >= p->up_after && st->interval < p->max_interval) {
+    st->interval = MIN(st->interval + p->step, p->max_interval);
+    st->hot = 0;
+    return TRUE;
+  }
+  if (st->cool >= p->down_after) {
+    st->interval = next;
+    st->cool = 0;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static GstPadProbeReturn on_pgie_in(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad; (void)user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (!buf || !GST_BUFFER_PTS_IS_VALID(buf)) return GST_PAD_PROBE_OK;
+  // Single writer; pts is published last.
+  InferSlot *s = &s_ring[s_ring_w++ % INFER_RING];
+  __atomic_store_n(&s->t_us, g_get_monotonic_time(), __ATOMIC_RELAXED);
+  __atomic_store_n(&s->pts, GST_BUFFER_PTS(buf), __ATOMIC_RELEASE);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn on_pgie_out(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad; (void)user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (!buf || !GST_BUFFER_PTS_IS_VALID(buf)) return GST_PAD_PROBE_OK;
+  guint64 pts = GST_BUFFER_PTS(buf);
+  for (guint i = 0; i < INFER_RING; ++i) {
+    if (__atomic_load_n(&s_ring[i].pts, __ATOMIC_ACQUIRE) != pts) continue;
+    gint64 dt = g_get_monotonic_time() - __atomic_load_n(&s_ring[i].t_us, __ATOMIC_RELAXED);
+    if (dt < 0) break;
+    I_ADD(s_sum_us, (guint64)dt);
+    I_ADD(s_count, 1);
+    break;
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean on_tick(gpointer data) {
+  (void)data;
+  guint64 sum = I_TAKE(s_sum_us), count = I_TAKE(s_count);
+  // No batches (no streams yet, or stalled upstream): nothing to judge this second.
+  if (!count) return G_SOURCE_CONTINUE;
+  guint64 mean = sum / count;
+  I_SET(s_last_us, mean);
+  if (!s_steer) return G_SOURCE_CONTINUE;
+  guint before = s_state.interval;
+  if (!infer_ctl_step(&s_state, &s_params, mean)) return G_SOURCE_CONTINUE;
+  g_object_set(s_pgie, "interval", s_state.interval, NULL);
+  LOG_INF("Inference: batch %.1fms of %.1fms budget -> interval %u -> %u",
+          mean / 1000.0, s_params.budget_us / 1000.0, before, s_state.interval);
+  return G_SOURCE_CONTINUE;
+}
+
+void infer_init(void) {
+  const gchar *adapt = g_getenv("INFER_ADAPT");
+  s_adapt = !(adapt && (g_ascii_strcasecmp(adapt, "off") == 0 || g_strcmp0(adapt, "0") == 0));
+  memset(&s_params, 0, sizeof(s_params));
+  s_params.budget_us = (guint64) MAX(1, config_env_uint("INFER_BUDGET_MS", 33)) * 1000;
+  s_params.high_pct = CLAMP(config_env_uint("INFER_HIGH_PCT", 85), 2, 1000);
+  s_params.low_pct = CLAMP(config_env_uint("INFER_LOW_PCT", 60), 1, s_params.high_pct - 1);
+  s_params.up_after = MAX(1, config_env_uint("INFER_UP_S", 2));
+  s_params.down_after = MAX(1, config_env_uint("INFER_DOWN_S", 10));
+  s_params.step = MAX(1, config_env_uint("INFER_STEP", 1));
+  s_params.max_interval = config_env_uint("INFER_MAX_INTERVAL", 4);
+}
+
+void infer_attach(GstElement *pgie) {
+  if (!pgie) { LOG_WRN("Inference: no element named pgie; adaptive interval off"); return; }
+  s_pgie = gst_object_ref(pgie);
+  GstPad *sink = gst_element_get_static_pad(pgie, "sink");
+  GstPad *src = gst_element_get_static_pad(pgie, "src");
+  if (sink) { gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_BUFFER, on_pgie_in, NULL, NULL); gst_object_unref(sink); }
+  if (src) { gst_pad_add_probe(src, GST_PAD_PROBE_TYPE_BUFFER, on_pgie_out, NULL, NULL); gst_object_unref(src); }
+
+  GParamSpec *ps = g_object_class_find_property(G_OBJECT_GET_CLASS(pgie), "interval");
+  if (ps) {
+    guint base = 0;
+    g_object_get(pgie, "interval", &base, NULL);
+    s_params.min_interval = base;
+    s_params.max_interval = MAX(s_params.max_interval, base);
+    s_state.interval = base;
+    s_steer = s_adapt && s_params.max_interval > base;
+    if (s_steer && !(ps->flags & GST_PARAM_MUTABLE_PLAYING))
+      LOG_WRN("Inference: %s does not flag interval as settable while playing; steering anyway", GST_ELEMENT_NAME(pgie));
+  }
+  if (s_steer) {
+    LOG_INF("Inference: adaptive interval %u..%u (budget %" G_GUINT64_FORMAT "ms, up at %u%% for %us, down at %u%% for %us, step %u)",
+            s_params.min_interval, s_params.max_interval, s_params.budget_us / 1000, s_params.high_pct, s_params.up_after,
+            s_params.low_pct, s_params.down_after, s_params.step);
+  } else {
+    LOG_INF("Inference: fixed interval (%s); batch time is still measured",
+            !ps ? "no interval property" : (s_adapt ? "INFER_MAX_INTERVAL <= configured interval" : "INFER_ADAPT=off"));
+  }
+  g_timeout_add_seconds(1, on_tick, NULL);
+}
+
+guint infer_interval(void) { return s_state.interval; }
+
+void infer_render_metrics(GString *out) {
+  if (!s_pgie) return;
+  g_string_append_printf(out,
+    "# HELP batch_infer_interval Batches skipped by the primary detector between inferred ones.\n"
+    "# TYPE batch_infer_interval gauge\nbatch_infer_interval %u\n"
+    "# HELP batch_infer_batch_seconds Mean primary detector batch time over the last second.\n"
+    "# TYPE batch_infer_batch_seconds gauge\nbatch_infer_batch_seconds %.6f\n"
+    "# HELP batch_infer_budget_seconds Frame budget the interval controller holds batch time under.\n"
+    "# TYPE batch_infer_budget_seconds gauge\nbatch_infer_budget_seconds %.6f\n",
+    s_state.interval, I_GET(s_last_us) / 1e6, s_params.budget_us / 1e6);
+}
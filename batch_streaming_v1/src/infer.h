@@ -0,0 +1,39 @@
+// Adaptive inference interval: nvinfer skips batches while batch time nears the frame budget
+#ifndef INFER_H
+#define INFER_H
+
+#include <gst/gst.h>
+
+typedef struct {
+  guint64 budget_us;    // frame budget (one source frame period)
+  guint high_pct;       // load >= high_pct of the budget counts as hot
+  guint low_pct;        // predicted load one step down <= low_pct counts as cool
+  guint up_after;       // consecutive hot ticks before raising the interval
+  guint down_after;     // consecutive cool ticks before lowering it
+  guint step;           // interval change per step
+  guint min_interval;   // pgie.txt's interval (never goes below it)
+  guint max_interval;
+} InferCtlParams;
+
+typedef struct {
+  guint interval;
+  guint hot;   // consecutive hot ticks
+  guint cool;  // consecutive cool ticks
+} InferCtlState;
+
+// Pure one-tick step from the window's mean batch time (nvinfer sink -> src) measured
+// at st->interval. Returns TRUE when st->interval changed.
+gboolean infer_ctl_step(InferCtlState *st, const InferCtlParams *p, guint64 batch_us);
+
+// INFER_ADAPT=on|off (default on), INFER_BUDGET_MS (33), INFER_HIGH_PCT (85),
+// INFER_LOW_PCT (60), INFER_UP_S (2), INFER_DOWN_S (10), INFER_STEP (1),
+// INFER_MAX_INTERVAL (4).
+void infer_init(void);
+// Probes pgie (nvinfer, or the CPU backend's identity stand-in) and starts the 1s tick.
+// Batch times are measured either way; only an element with "interval" is steered.
+void infer_attach(GstElement *pgie);
+guint infer_interval(void);
+// Appends the Prometheus text for the controller (interval, batch time).
+void infer_render_metrics(GString *out);
+
+#endif // INFER_H
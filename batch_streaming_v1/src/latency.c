@@ -0,0 +1,162 @@
+// Branch latency (L2)
+// - Capture time is NvDsFrameMeta.ntp_timestamp: with attach-sys-ts the muxer stamps
+//   each frame with the system time (ns since the Unix epoch) it arrived at. The
+//   branch ingress probe (demux side of the queue) reads it and carries it down the
+//   branch as a GstReferenceTimestampMeta (timestamp/x-unix), which convert, encode
+//   and parse copy along; the egress probe compares it with the system clock.
+// - BACKEND=cpu has no batch meta: ingress derives the capture time from the PTS
+//   instead (its age on the pipeline clock, taken off the system time).
+// - The egress probe bumps one bucket of a fixed log-linear histogram (relaxed
+//   atomics); percentiles are read off the cumulative counts at query time.
+#include <string.h>
+#include "gstnvdsmeta.h"
+#include "state.h"
+#include "latency.h"
+
+#define LAT_UNIT_US 128  // linear step below 16 units (2ms)
+#define LAT_MAX_MSB 20   // clamp: 2^21 units ~ 268s
+
+typedef struct {
+  guint64 counts[LATENCY_BUCKETS];
+  guint64 frames;
+  guint64 sum_us;
+  guint64 max_us;
+  GstSegment segment;  // ingress pad segment, for the CPU fallback (streaming thread only)
+} LatencySlot;
+
+static LatencySlot s_slots[G_N_ELEMENTS(g_streams)];
+static GstStaticCaps s_capture_ref = GST_STATIC_CAPS("timestamp/x-unix");
+static GstCaps *s_capture_caps = NULL; // reference of the carried capture timestamp
+
+#define L_ADD(field, v) __atomic_fetch_add(&(field), (v), __ATOMIC_RELAXED)
+#define L_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define L_SET(field, v) __atomic_store_n(&(field), (v), __ATOMIC_RELAXED)
+
+guint latency_bucket(guint64 us) {
+  guint64 x = us / LAT_UNIT_US;
+  if (x < 16) return (guint)x;
+  guint msb = 63 - (guint)__builtin_clzll(x);
+  if (msb > LAT_MAX_MSB) return LATENCY_BUCKETS - 1;
+  guint sub = (guint)(x >> (msb - 3)) & 7;
+  return 16 + (msb - 4) * 8 + sub;
+}
+
+guint64 latency_bucket_upper_us(guint b) {
+  if (b < 16) return (guint64)(b + 1) * LAT_UNIT_US;
+  guint msb = 4 + (b - 16) / 8, sub = (b - 16) % 8;
+  return ((guint64)(8 + sub + 1) << (msb - 3)) * LAT_UNIT_US;
+}
+
+guint64 latency_percentile_us(const guint64 *counts, guint n, gdouble q) {
+  guint64 total = 0;
+  for (guint i = 0; i < n; ++i) total += counts[i];
+  if (total == 0) return 0;
+  guint64 rank = (guint64)(CLAMP(q, 0.0, 1.0) * (gdouble)total + 0.999999);
+  rank = MAX(rank, 1);
+  guint64 seen = 0;
+  for (guint i = 0; i < n; ++i) {
+    seen += counts[i];
+    if (seen >= rank) return latency_bucket_upper_us(i);
+  }
+  return latency_bucket_upper_us(n - 1);
+}
+
+// Capture time in ns since the Unix epoch; 0 if unknown.
+static guint64 capture_unix_ns(GstPad *pad, LatencySlot *s, GstBuffer *buf) {
+  NvDsBatchMeta *batch = gst_buffer_get_nvds_batch_meta(buf);
+  if (batch && batch->frame_meta_list) {
+    NvDsFrameMeta *frame = (NvDsFrameMeta*) batch->frame_meta_list->data;
+    if (frame && frame->ntp_timestamp) return frame->ntp_timestamp;
+  }
+  // CPU fallback: how long ago the PTS was on the pipeline clock, taken off the wall clock.
+  if (!GST_BUFFER_PTS_IS_VALID(buf) || s->segment.format != GST_FORMAT_TIME) return 0;
+  GstClockTime rt = gst_segment_to_running_time(&s->segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buf));
+  GstElement *el = GST_PAD_PARENT(pad);
+  GstClock *clock = el ? gst_element_get_clock(el) : NULL;
+  if (!clock || !GST_CLOCK_TIME_IS_VALID(rt)) { if (clock) gst_object_unref(clock); return 0; }
+  GstClockTime now = gst_clock_get_time(clock), at = gst_element_get_base_time(el) + rt;
+  gst_object_unref(clock);
+  guint64 wall_ns = (guint64) g_get_real_time() * 1000;
+  guint64 age_ns = now > at ? now - at : 0;
+  return wall_ns > age_ns ? wall_ns - age_ns : 0;
+}
+
+static GstPadProbeReturn on_ingress(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  LatencySlot *s = (LatencySlot*) user_data;
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *ev = GST_PAD_PROBE_INFO_EVENT(info);
+    if (GST_EVENT_TYPE(ev) == GST_EVENT_SEGMENT) gst_event_copy_segment(ev, &s->segment);
+    return GST_PAD_PROBE_OK;
+  }
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (!buf) return GST_PAD_PROBE_OK;
+  guint64 captured = capture_unix_ns(pad, s, buf);
+  if (!captured) return GST_PAD_PROBE_OK;
+  // A tee (CPU backend) hands every branch the same buffer: only its metadata is copied.
+  buf = gst_buffer_make_writable(buf);
+  gst_buffer_add_reference_timestamp_meta(buf, s_capture_caps, captured, GST_CLOCK_TIME_NONE);
+  GST_PAD_PROBE_INFO_DATA(info) = buf;
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn on_egress(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  LatencySlot *s = (LatencySlot*) user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  GstReferenceTimestampMeta *ref = buf ? gst_buffer_get_reference_timestamp_meta(buf, s_capture_caps) : NULL;
+  if (!ref) return GST_PAD_PROBE_OK;
+  guint64 now_ns = (guint64) g_get_real_time() * 1000;
+  guint64 us = now_ns > ref->timestamp ? (now_ns - ref->timestamp) / 1000 : 0;
+  L_ADD(s->counts[latency_bucket(us)], 1);
+  L_ADD(s->frames, 1);
+  L_ADD(s->sum_us, us);
+  guint64 max = L_GET(s->max_us);
+  while (us > max && !__atomic_compare_exchange_n(&s->max_us, &max, us, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+  return GST_PAD_PROBE_OK;
+}
+
+static void slot_reset(LatencySlot *s) {
+  for (guint b = 0; b < LATENCY_BUCKETS; ++b) L_SET(s->counts[b], 0);
+  L_SET(s->frames, 0);
+  L_SET(s->sum_us, 0);
+  L_SET(s->max_us, 0);
+}
+
+void latency_branch_attach(guint index, GstElement *ingress, GstElement *egress) {
+  if (index >= G_N_ELEMENTS(s_slots) || !ingress || !egress) return;
+  if (!s_capture_caps) s_capture_caps = gst_static_caps_get(&s_capture_ref);
+  LatencySlot *s = &s_slots[index];
+  slot_reset(s);
+  gst_segment_init(&s->segment, GST_FORMAT_UNDEFINED);
+  GstPad *in = gst_element_get_static_pad(ingress, "sink");
+  GstPad *out = gst_element_get_static_pad(egress, "sink");
+  if (in && out) {
+    gst_pad_add_probe(in, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, on_ingress, s, NULL);
+    gst_pad_add_probe(out, GST_PAD_PROBE_TYPE_BUFFER, on_egress, s, NULL);
+  }
+  if (in) gst_object_unref(in);
+  if (out) gst_object_unref(out);
+}
+
+void latency_render_json(GString *out, gboolean reset) {
+  g_string_append(out, "{\n  \"streams\": [\n");
+  gboolean first = TRUE;
+  for (guint i = 0; i < G_N_ELEMENTS(g_streams); ++i) {
+    if (!g_streams[i].in_use) continue;
+    LatencySlot *s = &s_slots[i];
+    guint64 counts[LATENCY_BUCKETS];
+    for (guint b = 0; b < LATENCY_BUCKETS; ++b) counts[b] = L_GET(s->counts[b]);
+    guint64 frames = L_GET(s->frames), sum = L_GET(s->sum_us), max = L_GET(s->max_us);
+    if (reset) slot_reset(s);
+    g_string_append_printf(out,
+      "%s    { \"stream\": \"/s%u\", \"frames\": %" G_GUINT64_FORMAT ", \"p50_ms\": %.1f, \"p95_ms\": %.1f, \"p99_ms\": %.1f,"
+      " \"max_ms\": %.1f, \"mean_ms\": %.1f }",
+      first ? "" : ",\n", i, frames,
+      latency_percentile_us(counts, LATENCY_BUCKETS, 0.50) / 1000.0,
+      latency_percentile_us(counts, LATENCY_BUCKETS, 0.95) / 1000.0,
+      latency_percentile_us(counts, LATENCY_BUCKETS, 0.99) / 1000.0,
+      max / 1000.0, frames ? sum / 1000.0 / frames : 0.0);
+    first = FALSE;
+  }
+  g_string_append(out, "\n  ]\n}\n");
+}
@@ -0,0 +1,25 @@
+// Per-branch end-to-end latency histograms (capture -> egress, system clock), fixed memory
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <gst/gst.h>
+
+// Log-linear buckets: 128us steps below 2ms, then 8 per power of two (<= 12.5% wide)
+// up to ~268s. Pure helpers, shared with the percentile math.
+#define LATENCY_BUCKETS 152
+guint latency_bucket(guint64 us);
+guint64 latency_bucket_upper_us(guint b);
+// Upper bound of the bucket holding quantile q (0..1); 0 when empty.
+guint64 latency_percentile_us(const guint64 *counts, guint n, gdouble q);
+
+// Resets slot `index`, stamps each frame's capture time (NvDsFrameMeta.ntp_timestamp,
+// or the PTS on the CPU backend) at the branch's ingress element (its queue) and
+// measures at the egress element (payloader, or appsink in hand-off mode). One bucket
+// increment per frame.
+void latency_branch_attach(guint index, GstElement *ingress, GstElement *egress);
+
+// {"streams": [{stream, frames, p50_ms, p95_ms, p99_ms, max_ms, mean_ms}, ...]} for
+// every active branch; reset starts a new window afterwards.
+void latency_render_json(GString *out, gboolean reset);
+
+#endif // LATENCY_H
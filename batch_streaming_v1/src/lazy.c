@@ -0,0 +1,207 @@
+// Viewer hooks: lazy encoding + keyframe on join (L2)
+// - Each branch has a valve after its queue, closed while nobody watches, so the
+//   convert/OSD/encode chain of an unwatched camera costs nothing.
+// - Viewers are tracked per mount through the factory's medias: media-configure opens
+//   the valve (plus a forced keyframe so the first viewer decodes at once); when the
+//   last media unprepares the valve closes after LAZY_IDLE_MS, unless a viewer returns.
+//   A pinned branch (recording) stays open with or without viewers.
+// - Every PLAY on /sN also asks that encoder for a keyframe, at most once per
+//   KEYFRAME_JOIN_MIN_MS per mount, so a late joiner of a shared media does not wait
+//   out the GOP.
+#include <stdio.h>
+#include <string.h>
+#include <gst/video/video.h>
+#include "log.h"
+#include "config.h"
+#include "state.h"
+#include "lazy.h"
+
+typedef struct {
+  GstElement *valve;   // reffed; NULL when lazy encoding is off
+  GstElement *enc;     // reffed; NULL = slot not attached
+  gint64 last_kf_us;   // last forced keyframe (rate limit)
+  GPtrArray *medias;   // prepared medias of this mount (identity only)
+  guint idle_id;       // pending close
+  gboolean open;
+  gboolean pinned;     // held open by a non-RTSP consumer
+} LazySlot;
+
+static gboolean s_enabled = TRUE;
+static guint s_idle_ms = 10000;
+static gboolean s_join_kf = TRUE;
+static guint s_join_kf_min_ms = 1000;
+static GMutex s_lock;
+static LazySlot s_slots[G_N_ELEMENTS(g_streams)];
+
+void lazy_init(void) {
+  const gchar *env = g_getenv("LAZY_ENCODE");
+  s_enabled = !(env && (g_strcmp0(env, "0") == 0 || g_ascii_strcasecmp(env, "off") == 0));
+  s_idle_ms = config_env_uint("LAZY_IDLE_MS", 10000);
+  env = g_getenv("KEYFRAME_ON_JOIN");
+  s_join_kf = !(env && (g_strcmp0(env, "0") == 0 || g_ascii_strcasecmp(env, "off") == 0));
+  s_join_kf_min_ms = config_env_uint("KEYFRAME_JOIN_MIN_MS", 1000);
+  LOG_INF("Lazy encoding: %s (idle after %ums without viewers); keyframe on join: %s (min %ums apart)",
+          s_enabled ? "on" : "off", s_idle_ms, s_join_kf ? "on" : "off", s_join_kf_min_ms);
+}
+
+gboolean lazy_enabled(void) {
+  return s_enabled;
+}
+
+void lazy_request_keyframe(GstElement *enc) {
+  GstPad *src = gst_element_get_static_pad(enc, "src");
+  if (!src) return;
+  (void)gst_pad_send_event(src, gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0));
+  gst_object_unref(src);
+}
+
+void lazy_branch_attach(guint index, GstElement *valve, GstElement *enc) {
+  if (index >= G_N_ELEMENTS(s_slots) || !enc) return;
+  if (valve) g_object_set(valve, "drop", TRUE, NULL);
+  g_mutex_lock(&s_lock);
+  LazySlot *s = &s_slots[index];
+  s->valve = valve ? gst_object_ref(valve) : NULL;
+  s->enc = gst_object_ref(enc);
+  s->last_kf_us = 0;
+  s->medias = g_ptr_array_new();
+  s->idle_id = 0;
+  s->open = (valve == NULL);
+  g_mutex_unlock(&s_lock);
+}
+
+void lazy_branch_detach(guint index) {
+  if (index >= G_N_ELEMENTS(s_slots)) return;
+  g_mutex_lock(&s_lock);
+  LazySlot *s = &s_slots[index];
+  if (s->idle_id) g_source_remove(s->idle_id);
+  if (s->valve) gst_object_unref(s->valve);
+  if (s->enc) gst_object_unref(s->enc);
+  if (s->medias) g_ptr_array_free(s->medias, TRUE);
+  memset(s, 0, sizeof(*s));
+  g_mutex_unlock(&s_lock);
+}
+
+void lazy_branch_set_encoder(guint index, GstElement *enc) {
+  if (index >= G_N_ELEMENTS(s_slots)) return;
+  g_mutex_lock(&s_lock);
+  LazySlot *s = &s_slots[index];
+  if (s->enc) {
+    gst_object_unref(s->enc);
+    s->enc = gst_object_ref(enc);
+  }
+  g_mutex_unlock(&s_lock);
+}
+
+static gboolean on_idle(gpointer user_data);
+
+void lazy_branch_pin(guint index, gboolean pinned) {
+  if (index >= G_N_ELEMENTS(s_slots)) return;
+  GstElement *resume_enc = NULL;
+  g_mutex_lock(&s_lock);
+  LazySlot *s = &s_slots[index];
+  s->pinned = pinned;
+  if (s->valve && pinned && !s->open) {
+    if (s->idle_id) { g_source_remove(s->idle_id); s->idle_id = 0; }
+    g_object_set(s->valve, "drop", FALSE, NULL);
+    s->open = TRUE;
+    s->last_kf_us = g_get_monotonic_time();
+    resume_enc = gst_object_ref(s->enc);
+  } else if (s->valve && !pinned && s->open && s->medias->len == 0 && !s->idle_id) {
+    s->idle_id = g_timeout_add(s_idle_ms, on_idle, GUINT_TO_POINTER(index));
+  }
+  g_mutex_unlock(&s_lock);
+  if (resume_enc) {
+    LOG_INF("Lazy: /s%u resumed (pinned)", index);
+    lazy_request_keyframe(resume_enc);
+    gst_object_unref(resume_enc);
+  }
+}
+
+static gboolean on_idle(gpointer user_data) {
+  guint index = GPOINTER_TO_UINT(user_data);
+  guint self = g_source_get_id(g_main_current_source());
+  g_mutex_lock(&s_lock);
+  LazySlot *s = &s_slots[index];
+  if (s->idle_id == self) {
+    s->idle_id = 0;
+    if (s->valve && s->open && !s->pinned && s->medias->len == 0) {
+      g_object_set(s->valve, "drop", TRUE, NULL);
+      s->open = FALSE;
+      LOG_INF("Lazy: /s%u idle (no viewers)", index);
+    }
+  }
+  g_mutex_unlock(&s_lock);
+  return G_SOURCE_REMOVE;
+}
+
+static void on_media_unprepared(GstRTSPMedia *media, gpointer user_data) {
+  guint index = GPOINTER_TO_UINT(user_data);
+  g_mutex_lock(&s_lock);
+  LazySlot *s = &s_slots[index];
+  // Medias of a branch that was since removed (or replaced) are not in the set.
+  if (s->valve && g_ptr_array_remove_fast(s->medias, media) && s->medias->len == 0 && s->open && !s->idle_id) {
+    s->idle_id = g_timeout_add(s_idle_ms, on_idle, user_data);
+  }
+  g_mutex_unlock(&s_lock);
+}
+
+static void on_media_configure(GstRTSPMediaFactory *factory, GstRTSPMedia *media, gpointer user_data) {
+  (void)factory;
+  guint index = GPOINTER_TO_UINT(user_data);
+  GstElement *resume_enc = NULL;
+  g_mutex_lock(&s_lock);
+  LazySlot *s = &s_slots[index];
+  if (s->valve) {
+    g_ptr_array_add(s->medias, media);
+    if (s->idle_id) { g_source_remove(s->idle_id); s->idle_id = 0; }
+    if (!s->open) {
+      g_object_set(s->valve, "drop", FALSE, NULL);
+      s->open = TRUE;
+      s->last_kf_us = g_get_monotonic_time();
+      resume_enc = gst_object_ref(s->enc);
+    }
+  }
+  g_mutex_unlock(&s_lock);
+  g_signal_connect(media, "unprepared", G_CALLBACK(on_media_unprepared), user_data);
+  if (resume_enc) {
+    LOG_INF("Lazy: /s%u resumed (viewer joined)", index);
+    lazy_request_keyframe(resume_enc);
+    gst_object_unref(resume_enc);
+  }
+}
+
+void lazy_watch_factory(guint index, GstRTSPMediaFactory *factory) {
+  if (!s_enabled || index >= G_N_ELEMENTS(s_slots)) return;
+  g_signal_connect(factory, "media-configure", G_CALLBACK(on_media_configure), GUINT_TO_POINTER(index));
+}
+
+// --- Keyframe on join
+static void on_play_request(GstRTSPClient *client, GstRTSPContext *ctx, gpointer user_data) {
+  (void)client; (void)user_data;
+  guint index = 0;
+  if (!ctx || !ctx->uri || !ctx->uri->abspath || sscanf(ctx->uri->abspath, "/s%u", &index) != 1) return;
+  if (index >= G_N_ELEMENTS(s_slots)) return;
+  GstElement *enc = NULL;
+  gint64 now = g_get_monotonic_time();
+  g_mutex_lock(&s_lock);
+  LazySlot *s = &s_slots[index];
+  if (s->enc && s->open && now - s->last_kf_us >= (gint64)s_join_kf_min_ms * 1000) {
+    s->last_kf_us = now;
+    enc = gst_object_ref(s->enc);
+  }
+  g_mutex_unlock(&s_lock);
+  if (enc) {
+    lazy_request_keyframe(enc);
+    gst_object_unref(enc);
+  }
+}
+
+static void on_client_connected(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+  (void)server;
+  g_signal_connect(client, "play-request", G_CALLBACK(on_play_request), user_data);
+}
+
+void lazy_watch_server(GstRTSPServer *server) {
+  if (!s_join_kf) return;
+  g_signal_connect(server, "client-connected", G_CALLBACK(on_client_connected), NULL);
+}
@@ -0,0 +1,32 @@
+// Viewer hooks: a branch only runs while its mount has viewers; joins get a keyframe
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+// LAZY_ENCODE (default on; 0/off disables) and LAZY_IDLE_MS (default 10000): how long
+// a mount stays encoding after its last viewer leaves.
+void lazy_init(void);
+gboolean lazy_enabled(void);
+
+// valve sits right after the branch queue and starts closed (NULL when lazy encoding
+// is off); enc receives the force-key-unit on resume and join. Both are reffed until detach.
+void lazy_branch_attach(guint index, GstElement *valve, GstElement *enc);
+void lazy_branch_detach(guint index);
+// The branch encoder was replaced (live reconfiguration).
+void lazy_branch_set_encoder(guint index, GstElement *enc);
+// Hold the valve open without viewers (e.g. while recording); unpin lets it idle again.
+void lazy_branch_pin(guint index, gboolean pinned);
+// Track the mount's medias: first prepared media opens the valve, the last one to go
+// starts the idle timer.
+void lazy_watch_factory(guint index, GstRTSPMediaFactory *factory);
+
+// KEYFRAME_ON_JOIN (default on) / KEYFRAME_JOIN_MIN_MS (default 1000): force a keyframe
+// on every PLAY of /sN, rate limited per mount.
+void lazy_watch_server(GstRTSPServer *server);
+
+// Ask the encoder for an IDR (upstream force-key-unit with SPS/PPS).
+void lazy_request_keyframe(GstElement *enc);
+
+#endif // LAZY_H
@@ -10,6 +10,7 @@
 #include <gst/gst.h>
 #include "app.h"
 #include "config.h"
+#include "shard.h"
 #include "log.h"
 
 int main(int argc, char *argv[]) {
@@ -19,9 +20,16 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  // SHARDS=K: this process only supervises K pipeline processes and routes control calls.
+  if (shard_front_enabled()) {
+    int rc = shard_front_run(&cfg);
+    cleanup_config(&cfg);
+    return rc;
+  }
+
   gst_init(&argc, &argv);
 
-  if (!sanity_check_plugins()) {
+  if (!sanity_check_plugins(&cfg)) {
     cleanup_config(&cfg);
     return 3;
   }
@@ -0,0 +1,259 @@
+// Branch metrics (L2)
+// - Probes: queue sink/src (in/out), encoder sink/src (frames, latency),
+//   sink sink pad (bytes leaving the branch). Each probe is a couple of relaxed atomics.
+// - Drops: in - out - current-level-buffers of the leaky queue, sampled on read. The
+//   "overrun" signal fires once per fill, not per discarded buffer, so it under-counts.
+//   A sample can be one buffer high per streaming thread caught between its probe and
+//   the queue; only a value seen on two consecutive samples is latched.
+// - Encoder latency pairs input and output PTS through a small per-branch ring.
+// - fps is derived at scrape time from the frame counter.
+// - METRICS=off skips the encoder and sink probes (and their series). The queue
+//   counters stay: the overload ladder and the push-timeout controller read them.
+#include <string.h>
+#include "log.h"
+#include "state.h"
+#include "metrics.h"
+#include "overload.h"
+
+#define METRICS_LAT_RING 32
+
+typedef struct {
+  guint64 pts;
+  gint64 t_us;
+} LatSlot;
+
+typedef struct {
+  guint64 queue_in;
+  guint64 queue_out;
+  guint64 dropped;
+  guint64 frames;          // encoded frames
+  guint64 bytes;           // bytes handed to udpsink/appsink
+  guint64 enc_lat_sum_us;
+  guint64 enc_lat_count;
+  guint64 enc_lat_max_us;
+  guint lat_w;
+  gboolean leaky;
+  guint64 drop_sample;     // previous in - out - level (drop lock)
+  LatSlot lat[METRICS_LAT_RING];
+} BranchMetrics;
+
+static BranchMetrics s_m[G_N_ELEMENTS(g_streams)];
+static GWeakRef s_queue[G_N_ELEMENTS(g_streams)];
+static GMutex s_drop_lock;
+static gboolean s_enabled = TRUE;
+
+// fps window (scrape side only)
+static GMutex s_fps_lock;
+static guint64 s_fps_frames[G_N_ELEMENTS(g_streams)];
+static gint64 s_fps_t_us[G_N_ELEMENTS(g_streams)];
+static gdouble s_fps[G_N_ELEMENTS(g_streams)];
+
+#define M_ADD(field, v) __atomic_fetch_add(&(field), (v), __ATOMIC_RELAXED)
+#define M_GET(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+static GstPadProbeReturn on_queue_in(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad; (void)info;
+  M_ADD(((BranchMetrics*)user_data)->queue_in, 1);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn on_queue_out(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad; (void)info;
+  M_ADD(((BranchMetrics*)user_data)->queue_out, 1);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn on_enc_in(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  BranchMetrics *m = (BranchMetrics*) user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (!buf || !GST_BUFFER_PTS_IS_VALID(buf)) return GST_PAD_PROBE_OK;
+  // Single writer (the branch streaming thread); pts is published last.
+  LatSlot *s = &m->lat[m->lat_w++ % METRICS_LAT_RING];
+  __atomic_store_n(&s->t_us, g_get_monotonic_time(), __ATOMIC_RELAXED);
+  __atomic_store_n(&s->pts, GST_BUFFER_PTS(buf), __ATOMIC_RELEASE);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn on_enc_out(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  BranchMetrics *m = (BranchMetrics*) user_data;
+  M_ADD(m->frames, 1);
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (!buf || !GST_BUFFER_PTS_IS_VALID(buf)) return GST_PAD_PROBE_OK;
+  guint64 pts = GST_BUFFER_PTS(buf);
+  for (guint i = 0; i < METRICS_LAT_RING; ++i) {
+    if (__atomic_load_n(&m->lat[i].pts, __ATOMIC_ACQUIRE) != pts) continue;
+    gint64 dt = g_get_monotonic_time() - __atomic_load_n(&m->lat[i].t_us, __ATOMIC_RELAXED);
+    if (dt < 0) break;
+    M_ADD(m->enc_lat_sum_us, (guint64)dt);
+    M_ADD(m->enc_lat_count, 1);
+    guint64 cur = M_GET(m->enc_lat_max_us);
+    while ((guint64)dt > cur && !__atomic_compare_exchange_n(&m->enc_lat_max_us, &cur, (guint64)dt, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+    break;
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean add_list_bytes(GstBuffer **buf, guint idx, gpointer user_data) {
+  (void)idx;
+  *(guint64*)user_data += gst_buffer_get_size(*buf);
+  return TRUE;
+}
+
+static GstPadProbeReturn on_sink_in(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  BranchMetrics *m = (BranchMetrics*) user_data;
+  guint64 n = 0;
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) n = gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info));
+  else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) gst_buffer_list_foreach(GST_PAD_PROBE_INFO_BUFFER_LIST(info), add_list_bytes, &n);
+  M_ADD(m->bytes, n);
+  return GST_PAD_PROBE_OK;
+}
+
+static void add_probe(GstElement *el, const gchar *pad_name, GstPadProbeType type, GstPadProbeCallback cb, BranchMetrics *m) {
+  GstPad *pad = gst_element_get_static_pad(el, pad_name);
+  if (!pad) return;
+  gst_pad_add_probe(pad, type, cb, m, NULL);
+  gst_object_unref(pad);
+}
+
+void metrics_init(void) {
+  const gchar *env = g_getenv("METRICS");
+  s_enabled = !(env && (g_strcmp0(env, "0") == 0 || g_ascii_strcasecmp(env, "off") == 0));
+  LOG_INF("Branch metrics: %s", s_enabled ? "on" : "off (queue counters only)");
+}
+
+void metrics_branch_attach(guint index, GstElement *queue, GstElement *enc, GstElement *sink) {
+  if (index >= G_N_ELEMENTS(s_m)) return;
+  BranchMetrics *m = &s_m[index];
+  memset(m, 0, sizeof(*m));
+  gint leaky = 0;
+  g_object_get(queue, "leaky", &leaky, NULL);
+  m->leaky = leaky != 0;
+  g_weak_ref_set(&s_queue[index], queue);
+  g_mutex_lock(&s_fps_lock);
+  s_fps_frames[index] = 0; s_fps_t_us[index] = g_get_monotonic_time(); s_fps[index] = 0.0;
+  g_mutex_unlock(&s_fps_lock);
+
+  add_probe(queue, "sink", GST_PAD_PROBE_TYPE_BUFFER, on_queue_in, m);
+  add_probe(queue, "src", GST_PAD_PROBE_TYPE_BUFFER, on_queue_out, m);
+  if (!s_enabled) return;
+  metrics_encoder_attach(index, enc);
+  add_probe(sink, "sink", GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST, on_sink_in, m);
+}
+
+void metrics_encoder_attach(guint index, GstElement *enc) {
+  if (index >= G_N_ELEMENTS(s_m) || !s_enabled) return;
+  BranchMetrics *m = &s_m[index];
+  add_probe(enc, "sink", GST_PAD_PROBE_TYPE_BUFFER, on_enc_in, m);
+  add_probe(enc, "src", GST_PAD_PROBE_TYPE_BUFFER, on_enc_out, m);
+}
+
+guint64 metrics_branch_frames_in(guint index) {
+  return index < G_N_ELEMENTS(s_m) ? M_GET(s_m[index].queue_in) : 0;
+}
+
+// Buffers in the queue now (0 if the queue is gone).
+static guint queue_level(guint index) {
+  GstElement *q = g_weak_ref_get(&s_queue[index]);
+  guint level = 0;
+  if (q) { g_object_get(q, "current-level-buffers", &level, NULL); gst_object_unref(q); }
+  return level;
+}
+
+// Reads in first and out last: buffers arriving or leaving during the read lower
+// the estimate instead of raising it.
+static guint64 sample_dropped(guint index) {
+  BranchMetrics *m = &s_m[index];
+  if (!m->leaky) return 0;
+  guint64 in = M_GET(m->queue_in);
+  guint level = queue_level(index);
+  guint64 outq = M_GET(m->queue_out);
+  guint64 est = in > outq + level ? in - outq - level : 0;
+  g_mutex_lock(&s_drop_lock);
+  guint64 confirmed = MIN(est, m->drop_sample);
+  m->drop_sample = est;
+  if (confirmed > M_GET(m->dropped)) __atomic_store_n(&m->dropped, confirmed, __ATOMIC_RELAXED);
+  guint64 dropped = M_GET(m->dropped);
+  g_mutex_unlock(&s_drop_lock);
+  return dropped;
+}
+
+guint64 metrics_branch_dropped(guint index) {
+  return index < G_N_ELEMENTS(s_m) ? sample_dropped(index) : 0;
+}
+
+// --- Rendering
+typedef enum { COL_FPS, COL_FRAMES, COL_QUEUE, COL_DROPPED, COL_BYTES, COL_LAT_SUM, COL_LAT_COUNT, COL_LAT_MAX, COL_DEGRADE } MetricCol;
+
+// name: series name; family/type/help: metadata (help NULL = continues the previous family);
+// probed: fed by the encoder/sink probes, so left out with METRICS=off.
+static const struct { const char *name, *family, *type, *help; gboolean probed; } k_metrics[] = {
+  [COL_FPS]       = { "batch_stream_fps", "batch_stream_fps", "gauge", "Encoded frames per second since the previous scrape.", TRUE },
+  [COL_FRAMES]    = { "batch_stream_frames_total", "batch_stream_frames_total", "counter", "Frames out of the encoder.", TRUE },
+  [COL_QUEUE]     = { "batch_stream_queue_level_buffers", "batch_stream_queue_level_buffers", "gauge", "Buffers waiting in the branch queue.", FALSE },
+  [COL_DROPPED]   = { "batch_stream_dropped_buffers_total", "batch_stream_dropped_buffers_total", "counter", "Buffers dropped by the leaky branch queue.", FALSE },
+  [COL_BYTES]     = { "batch_stream_bytes_sent_total", "batch_stream_bytes_sent_total", "counter", "Encoded bytes handed to the RTSP egress.", TRUE },
+  [COL_LAT_SUM]   = { "batch_stream_encoder_latency_seconds_sum", "batch_stream_encoder_latency_seconds", "summary", "Encoder input-to-output time.", TRUE },
+  [COL_LAT_COUNT] = { "batch_stream_encoder_latency_seconds_count", NULL, NULL, NULL, TRUE },
+  [COL_LAT_MAX]   = { "batch_stream_encoder_latency_max_seconds", "batch_stream_encoder_latency_max_seconds", "gauge", "Worst encoder latency since the branch started.", TRUE },
+  [COL_DEGRADE]   = { "batch_stream_degrade_level", "batch_stream_degrade_level", "gauge", "Overload ladder step (0 = full quality).", FALSE },
+};
+
+void metrics_render(GString *out, const StatusSnapshot *snap) {
+  guint active[G_N_ELEMENTS(g_streams)];
+  const gchar *encoder[G_N_ELEMENTS(g_streams)];
+  guint64 dropped[G_N_ELEMENTS(g_streams)];
+  guint level[G_N_ELEMENTS(g_streams)];
+  guint n = 0;
+  for (guint k = 0; k < snap->n_streams; ++k) {
+    guint i = snap->streams[k].index;
+    if (i >= G_N_ELEMENTS(g_streams)) continue;
+    active[n++] = i;
+    encoder[i] = snap->streams[k].encoder;
+    dropped[i] = sample_dropped(i);
+    level[i] = queue_level(i);
+  }
+
+  // Refresh the fps window (at most once per half second per branch).
+  gint64 now = g_get_monotonic_time();
+  gdouble fps[G_N_ELEMENTS(g_streams)];
+  g_mutex_lock(&s_fps_lock);
+  for (guint k = 0; k < n; ++k) {
+    guint i = active[k];
+    guint64 frames = M_GET(s_m[i].frames);
+    gint64 dt = now - s_fps_t_us[i];
+    if (dt >= G_USEC_PER_SEC / 2) {
+      s_fps[i] = (gdouble)(frames - s_fps_frames[i]) * G_USEC_PER_SEC / (gdouble)dt;
+      s_fps_frames[i] = frames; s_fps_t_us[i] = now;
+    }
+    fps[i] = s_fps[i];
+  }
+  g_mutex_unlock(&s_fps_lock);
+
+  g_string_append_printf(out, "# HELP batch_stream_active_streams Branches currently mounted.\n"
+                              "# TYPE batch_stream_active_streams gauge\nbatch_stream_active_streams %u\n", n);
+  for (guint c = 0; c < G_N_ELEMENTS(k_metrics); ++c) {
+    if (k_metrics[c].probed && !s_enabled) continue;
+    if (k_metrics[c].help) {
+      g_string_append_printf(out, "# HELP %s %s\n# TYPE %s %s\n", k_metrics[c].family, k_metrics[c].help, k_metrics[c].family, k_metrics[c].type);
+    }
+    for (guint k = 0; k < n; ++k) {
+      guint i = active[k];
+      BranchMetrics *m = &s_m[i];
+      g_string_append_printf(out, "%s{stream=\"s%u\",encoder=\"%s\"} ", k_metrics[c].name, i, encoder[i]);
+      switch ((MetricCol)c) {
+        case COL_FPS: g_string_append_printf(out, "%.2f\n", fps[i]); break;
+        case COL_FRAMES: g_string_append_printf(out, "%" G_GUINT64_FORMAT "\n", M_GET(m->frames)); break;
+        case COL_QUEUE: g_string_append_printf(out, "%u\n", level[i]); break;
+        case COL_DROPPED: g_string_append_printf(out, "%" G_GUINT64_FORMAT "\n", dropped[i]); break;
+        case COL_BYTES: g_string_append_printf(out, "%" G_GUINT64_FORMAT "\n", M_GET(m->bytes)); break;
+        case COL_LAT_SUM: g_string_append_printf(out, "%.6f\n", M_GET(m->enc_lat_sum_us) / 1e6); break;
+        case COL_LAT_COUNT: g_string_append_printf(out, "%" G_GUINT64_FORMAT "\n", M_GET(m->enc_lat_count)); break;
+        case COL_LAT_MAX: g_string_append_printf(out, "%.6f\n", M_GET(m->enc_lat_max_us) / 1e6); break;
+        case COL_DEGRADE: g_string_append_printf(out, "%u\n", overload_level(i)); break;
+      }
+    }
+  }
+}
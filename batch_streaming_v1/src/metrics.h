@@ -0,0 +1,29 @@
+// Per-branch counters fed by pad probes, rendered as Prometheus text
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <gst/gst.h>
+#include "status.h"
+
+// METRICS (default on; 0/off skips the encoder and sink probes and their series).
+void metrics_init(void);
+
+// Resets slot `index` and installs probes on the branch queue, encoder and sink.
+// Call before the branch is linked to demux. Probes only touch atomics.
+void metrics_branch_attach(guint index, GstElement *queue, GstElement *enc, GstElement *sink);
+
+// Re-installs the encoder probes after the branch encoder was replaced.
+void metrics_encoder_attach(guint index, GstElement *enc);
+
+// Frames that reached the branch queue so far, i.e. the source's arrivals (0 for an unused slot).
+guint64 metrics_branch_frames_in(guint index);
+
+// Buffers dropped by the branch queue so far (0 for an unused slot). Samples the
+// queue level, so call it from a control path, not from a pad probe.
+guint64 metrics_branch_dropped(guint index);
+
+// Appends the Prometheus text exposition (format 0.0.4) for every branch in the
+// status snapshot (no g_state_lock).
+void metrics_render(GString *out, const StatusSnapshot *snap);
+
+#endif // METRICS_H
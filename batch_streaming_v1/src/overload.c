@@ -0,0 +1,98 @@
+// Branch overload policy (L2)
+// - Queue: leaky downstream by default, so a slow encoder drops its own oldest frames
+//   instead of backpressuring nvstreamdemux (and with it every stream in the batch).
+// - Ladder: a branch that keeps dropping steps down (bitrate, then fps via videorate
+//   max-rate) relative to its enc_cfg; after a quiet spell it steps back up. One tick
+//   per second on the default context; drops come from the metrics probes.
+#include <string.h>
+#include "log.h"
+#include "config.h"
+#include "state.h"
+#include "metrics.h"
+#include "overload.h"
+
+static const struct { guint max_fps; guint bitrate_pct; } k_ladder[] = {
+  { 0,  100 },  // full quality (no fps cap)
+  { 0,  70  },
+  { 15, 50  },
+  { 10, 35  },
+};
+
+static gboolean s_leaky = TRUE;
+static guint64 s_queue_ns = 200000000;
+static gboolean s_ladder = TRUE;
+static guint s_down_s = 2, s_up_s = 10;
+static DegradeState s_state[G_N_ELEMENTS(g_streams)];
+static guint64 s_prev_dropped[G_N_ELEMENTS(g_streams)];
+
+gboolean overload_step(DegradeState *st, guint64 dropped_delta, guint max_level, guint down_after_s, guint up_after_s) {
+  if (dropped_delta > 0) { st->bad_s++; st->good_s = 0; }
+  else { st->good_s++; st->bad_s = 0; }
+  if (st->bad_s >= down_after_s && st->level < max_level) {
+    st->level++; st->bad_s = 0;
+    return TRUE;
+  }
+  if (st->good_s >= up_after_s && st->level > 0) {
+    st->level--; st->good_s = 0;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+void overload_apply(guint index) {
+  StreamInfo *si = &g_streams[index];
+  guint level = s_state[index].level;
+  guint fps = k_ladder[level].max_fps;
+  if (si->enc_cfg.fps && (!fps || si->enc_cfg.fps < fps)) fps = si->enc_cfg.fps;
+  if (si->rate) g_object_set(si->rate, "max-rate", fps ? (gint)fps : G_MAXINT, NULL);
+  // Bitrate is live-settable on both; the other software fallbacks only get the fps cap.
+  guint kbps = si->enc_cfg.bitrate_kbps * k_ladder[level].bitrate_pct / 100;
+  if (si->enc_is_hw) g_object_set(si->enc, "bitrate", kbps * 1000, NULL);
+  else if (g_strcmp0(si->enc_kind, "x264") == 0) g_object_set(si->enc, "bitrate", kbps, NULL);
+}
+
+static gboolean on_tick(gpointer data) {
+  (void)data;
+  // Never stall the main context behind a branch add/remove: skip this second instead.
+  if (!g_mutex_trylock(&g_state_lock)) return G_SOURCE_CONTINUE;
+  for (guint i = 0; i < G_N_ELEMENTS(g_streams); ++i) {
+    StreamInfo *si = &g_streams[i];
+    if (!si->in_use) continue;
+    guint64 dropped = metrics_branch_dropped(i);
+    guint64 delta = dropped >= s_prev_dropped[i] ? dropped - s_prev_dropped[i] : 0;
+    s_prev_dropped[i] = dropped;
+    if (!overload_step(&s_state[i], delta, G_N_ELEMENTS(k_ladder) - 1, s_down_s, s_up_s)) continue;
+    overload_apply(i);
+    guint level = s_state[i].level;
+    LOG_INF("Overload: %s -> level %u (fps cap %u, bitrate %u%%)", si->path, level, k_ladder[level].max_fps, k_ladder[level].bitrate_pct);
+  }
+  g_mutex_unlock(&g_state_lock);
+  return G_SOURCE_CONTINUE;
+}
+
+void overload_init(void) {
+  const gchar *policy = g_getenv("BRANCH_QUEUE_POLICY");
+  s_leaky = !(policy && g_ascii_strcasecmp(policy, "block") == 0);
+  s_queue_ns = (guint64) MAX(1, config_env_uint("BRANCH_QUEUE_MS", 200)) * GST_MSECOND;
+  const gchar *ladder = g_getenv("DEGRADE");
+  s_ladder = s_leaky && !(ladder && (g_ascii_strcasecmp(ladder, "off") == 0 || g_strcmp0(ladder, "0") == 0));
+  s_down_s = MAX(1, config_env_uint("DEGRADE_DOWN_S", 2));
+  s_up_s = MAX(1, config_env_uint("DEGRADE_UP_S", 10));
+  LOG_INF("Overload: branch queue %s %" G_GUINT64_FORMAT "ms, degrade ladder %s (down after %us, up after %us)",
+          s_leaky ? "leaky" : "blocking", s_queue_ns / GST_MSECOND, s_ladder ? "on" : "off", s_down_s, s_up_s);
+  if (s_ladder) g_timeout_add_seconds(1, on_tick, NULL);
+}
+
+gboolean overload_queue_leaky(void) { return s_leaky; }
+guint64 overload_queue_time_ns(void) { return s_queue_ns; }
+gboolean overload_ladder_enabled(void) { return s_ladder; }
+
+void overload_branch_reset(guint index) {
+  if (index >= G_N_ELEMENTS(s_state)) return;
+  memset(&s_state[index], 0, sizeof(s_state[index]));
+  s_prev_dropped[index] = 0;
+}
+
+guint overload_level(guint index) {
+  return index < G_N_ELEMENTS(s_state) ? s_state[index].level : 0;
+}
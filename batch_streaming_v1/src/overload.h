@@ -0,0 +1,29 @@
+// Per-branch overload policy: leaky branch queue + degrade ladder (fps/bitrate steps)
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+
+#include <glib.h>
+
+typedef struct {
+  guint level;   // 0 = full quality
+  guint bad_s;   // consecutive seconds with drops
+  guint good_s;  // consecutive seconds without drops
+} DegradeState;
+
+// Pure one-second step: returns TRUE when st->level changed.
+gboolean overload_step(DegradeState *st, guint64 dropped_delta, guint max_level, guint down_after_s, guint up_after_s);
+
+// BRANCH_QUEUE_POLICY=leaky|block (default leaky), BRANCH_QUEUE_MS (200),
+// DEGRADE=on|off (default on), DEGRADE_DOWN_S (2), DEGRADE_UP_S (10).
+void overload_init(void);
+gboolean overload_queue_leaky(void);
+guint64 overload_queue_time_ns(void);
+gboolean overload_ladder_enabled(void);
+// Forget a slot's ladder state (call when a branch is created in it).
+void overload_branch_reset(guint index);
+guint overload_level(guint index);
+// Push enc_cfg scaled by the branch's current step to its videorate and encoder.
+// Caller holds g_state_lock.
+void overload_apply(guint index);
+
+#endif // OVERLOAD_H
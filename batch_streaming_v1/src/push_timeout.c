@@ -0,0 +1,118 @@
+// Adaptive batched-push-timeout (L2)
+// - max-batch-size is the stream cap, so with fewer cameras connected a batch is only
+//   ever pushed by the timeout: too long holds frames that are already there, too short
+//   splits one round of frames over several underfilled batches.
+// - The timeout follows the fastest live source's frame period (plus a margin), i.e.
+//   1/max_fps: a batch goes out once per frame of the fastest camera, so it never
+//   waits on a slower one and holds no frame for longer than one period. Slower
+//   cameras just miss some batches. Stalled sources (below live_fps) are ignored.
+//   Bounded by PUSH_TIMEOUT_MIN/MAX_MS, with a deadband so arrival jitter does not
+//   rewrite the property every second.
+// - Frame rates come from the branch queue arrival counters (before the lazy valve,
+//   so idle mounts still count). One tick per second on the default context.
+#include <string.h>
+#include "log.h"
+#include "config.h"
+#include "state.h"
+#include "metrics.h"
+#include "push_timeout.h"
+
+static gboolean s_adapt = TRUE;
+static PushTimeoutParams s_params;
+static GstElement *s_target = NULL;  // reffed nvstreammux (or the bin when it has none)
+static guint64 s_timeout_us = 0;
+static guint64 s_prev_in[G_N_ELEMENTS(g_streams)];
+static gint64 s_prev_t_us = 0;
+
+guint64 push_timeout_target(const gdouble *fps, guint n, const PushTimeoutParams *p) {
+  gdouble fastest = 0.0;
+  for (guint i = 0; i < n; ++i) {
+    if (fps[i] >= p->live_fps && fps[i] > fastest) fastest = fps[i];
+  }
+  if (fastest == 0.0) return 0;
+  guint64 us = (guint64)(1e6 / fastest * (100 + p->margin_pct) / 100.0);
+  return CLAMP(us, p->min_us, p->max_us);
+}
+
+gboolean push_timeout_step(guint64 *timeout_us, const gdouble *fps, guint n, const PushTimeoutParams *p) {
+  guint64 target = push_timeout_target(fps, n, p);
+  if (!target || target == *timeout_us) return FALSE;
+  guint64 diff = target > *timeout_us ? target - *timeout_us : *timeout_us - target;
+  // Always honour the bounds; inside them, only move for a real change.
+  gboolean in_bounds = *timeout_us >= p->min_us && *timeout_us <= p->max_us;
+  if (in_bounds && diff * 100 < *timeout_us * p->deadband_pct) return FALSE;
+  *timeout_us = target;
+  return TRUE;
+}
+
+static gboolean on_tick(gpointer data) {
+  (void)data;
+  if (!g_mutex_trylock(&g_state_lock)) return G_SOURCE_CONTINUE;
+  gint64 now = g_get_monotonic_time();
+  gdouble dt = (now - s_prev_t_us) / (gdouble)G_USEC_PER_SEC;
+  s_prev_t_us = now;
+  gdouble fps[G_N_ELEMENTS(g_streams)];
+  guint n = 0;
+  for (guint i = 0; i < G_N_ELEMENTS(g_streams); ++i) {
+    guint64 in = metrics_branch_frames_in(i);
+    guint64 delta = in >= s_prev_in[i] ? in - s_prev_in[i] : in; // slot reused: counter restarted
+    s_prev_in[i] = in;
+    if (g_streams[i].in_use && dt > 0) fps[n++] = delta / dt;
+  }
+  g_mutex_unlock(&g_state_lock);
+
+  guint64 before = s_timeout_us;
+  if (!push_timeout_step(&s_timeout_us, fps, n, &s_params)) return G_SOURCE_CONTINUE;
+  g_object_set(s_target, "batched-push-timeout", (gint)s_timeout_us, NULL);
+  LOG_INF("Batching: %u streams -> batched-push-timeout %" G_GUINT64_FORMAT "us -> %" G_GUINT64_FORMAT "us",
+          n, before, s_timeout_us);
+  return G_SOURCE_CONTINUE;
+}
+
+void push_timeout_init(void) {
+  const gchar *adapt = g_getenv("PUSH_TIMEOUT_ADAPT");
+  s_adapt = !(adapt && (g_ascii_strcasecmp(adapt, "off") == 0 || g_strcmp0(adapt, "0") == 0));
+  memset(&s_params, 0, sizeof(s_params));
+  s_params.min_us = (guint64) MAX(1, config_env_uint("PUSH_TIMEOUT_MIN_MS", 5)) * 1000;
+  s_params.max_us = MAX(s_params.min_us, (guint64) config_env_uint("PUSH_TIMEOUT_MAX_MS", 100) * 1000);
+  s_params.margin_pct = config_env_uint("PUSH_TIMEOUT_MARGIN_PCT", 20);
+  s_params.deadband_pct = config_env_uint("PUSH_TIMEOUT_DEADBAND_PCT", 10);
+  s_params.live_fps = 1.0;
+}
+
+// nvmultiurisrcbin owns an nvstreammux; set the timeout there (the bin only forwards
+// its own copy at build time).
+static GstElement *find_mux(GstElement *src) {
+  GstElement *mux = NULL;
+  if (GST_IS_BIN(src)) {
+    GstIterator *it = gst_bin_iterate_all_by_element_factory_name(GST_BIN(src), "nvstreammux");
+    GValue v = G_VALUE_INIT;
+    if (it && gst_iterator_next(it, &v) == GST_ITERATOR_OK) {
+      mux = gst_object_ref(g_value_get_object(&v));
+      g_value_unset(&v);
+    }
+    if (it) gst_iterator_free(it);
+  }
+  return mux ? mux : gst_object_ref(src);
+}
+
+void push_timeout_attach(GstElement *src) {
+  if (!s_adapt || !src) return;
+  if (!g_object_class_find_property(G_OBJECT_GET_CLASS(src), "batched-push-timeout")) return;
+  gint initial = 0;
+  g_object_get(src, "batched-push-timeout", &initial, NULL);
+  s_timeout_us = initial > 0 ? (guint64)initial : s_params.max_us;
+  s_target = find_mux(src);
+  s_prev_t_us = g_get_monotonic_time();
+  LOG_INF("Batching: adaptive batched-push-timeout %" G_GUINT64_FORMAT "..%" G_GUINT64_FORMAT "ms on %s "
+          "(fastest source period +%u%%, deadband %u%%)", s_params.min_us / 1000, s_params.max_us / 1000,
+          GST_ELEMENT_NAME(s_target), s_params.margin_pct, s_params.deadband_pct);
+  g_timeout_add_seconds(1, on_tick, NULL);
+}
+
+void push_timeout_render_metrics(GString *out) {
+  if (!s_target) return;
+  g_string_append_printf(out,
+    "# HELP batch_push_timeout_seconds Current nvstreammux batched-push-timeout.\n"
+    "# TYPE batch_push_timeout_seconds gauge\nbatch_push_timeout_seconds %.6f\n", s_timeout_us / 1e6);
+}
@@ -0,0 +1,32 @@
+// Adaptive batched-push-timeout: size the muxer's batch wait from live source frame rates
+#ifndef PUSH_TIMEOUT_H
+#define PUSH_TIMEOUT_H
+
+#include <gst/gst.h>
+
+typedef struct {
+  guint64 min_us;        // bounds for the timeout
+  guint64 max_us;
+  guint margin_pct;      // wait this much past the fastest live source's frame period
+  guint deadband_pct;    // ignore targets within this much of the current timeout
+  gdouble live_fps;      // sources below this rate are stalled and do not set the wait
+} PushTimeoutParams;
+
+// Pure: the fastest live source's frame period plus the margin (one batch per frame
+// of the fastest camera), clamped to [min_us, max_us]; 0 when no source is live
+// (keep the current one).
+guint64 push_timeout_target(const gdouble *fps, guint n, const PushTimeoutParams *p);
+// Pure one-tick step: moves *timeout_us to the target unless it is within the
+// deadband. Returns TRUE when *timeout_us changed.
+gboolean push_timeout_step(guint64 *timeout_us, const gdouble *fps, guint n, const PushTimeoutParams *p);
+
+// PUSH_TIMEOUT_ADAPT=on|off (default on), PUSH_TIMEOUT_MIN_MS (5), PUSH_TIMEOUT_MAX_MS (100),
+// PUSH_TIMEOUT_MARGIN_PCT (20), PUSH_TIMEOUT_DEADBAND_PCT (10).
+void push_timeout_init(void);
+// Steers the nvstreammux inside src (nvmultiurisrcbin) once a second from the branch
+// arrival counters. No-op for a source without batched-push-timeout (CPU backend).
+void push_timeout_attach(GstElement *src);
+// Appends the Prometheus text for the current timeout.
+void push_timeout_render_metrics(GString *out);
+
+#endif // PUSH_TIMEOUT_H
@@ -0,0 +1,281 @@
+// Recording tap (L2)
+// - Every branch has a tee after h264parse. Recording requests a tee pad and hangs
+//   queue (leaky) ! h264parse ! splitmuxsink off it: the live path never waits on the
+//   disk, a slow disk only drops frames from the recording.
+// - The recording resumes on a keyframe: at start, and after every overrun (the full
+//   queue drops the incoming frame, leaky=upstream, so the drop happens on the thread
+//   that filters), delta units are dropped until one arrives and the encoder is asked
+//   for one. Each overrun counts as a gap. splitmuxsink cuts at the first keyframe
+//   past the segment duration and deletes the oldest file beyond max-files.
+// - Stop unlinks the tap, pushes EOS into it alone so the open segment is finalized,
+//   and waits for the file sink EOS that follows that EOS reaching the muxer (every
+//   rollover also ends in one), then tears the tap down. The waits happen without
+//   g_state_lock: taps are only started and stopped by the control worker.
+#include <errno.h>
+#include <string.h>
+#include <gst/video/video.h>
+#include "log.h"
+#include "config.h"
+#include "state.h"
+#include "lazy.h"
+#include "record.h"
+
+#define RECORD_FINALIZE_MS 3000
+
+typedef struct {
+  GstPad *tee_pad;     // requested tee src pad; NULL = not recording
+  GstElement *queue, *parse, *mux, *muxer, *fsink;
+  RecordInfo info;
+  gint64 started_us;
+  gboolean resync;     // tee thread only: dropping delta units until a keyframe
+  gint gaps;           // atomic: overruns since start
+  GMutex lock;         // guards the fields below (streaming threads set them)
+  GCond cond;
+  guint32 eos_seqnum;  // the stop EOS
+  gboolean unlinked, eos_in, eos;
+} RecordTap;
+
+static gchar *s_dir = NULL;
+static guint s_segment_s = 60;
+static guint s_max_files = 60;
+static guint64 s_queue_ns = 2 * GST_SECOND;
+static RecordTap s_taps[G_N_ELEMENTS(g_streams)];
+
+void record_init(void) {
+  const gchar *dir = g_getenv("RECORD_DIR");
+  s_dir = g_strdup(dir && *dir ? dir : "/recordings");
+  s_segment_s = MAX(1, config_env_uint("RECORD_SEGMENT_S", 60));
+  s_max_files = config_env_uint("RECORD_MAX_FILES", 60);
+  s_queue_ns = (guint64) MAX(100, config_env_uint("RECORD_QUEUE_MS", 2000)) * GST_MSECOND;
+  for (guint i = 0; i < G_N_ELEMENTS(s_taps); ++i) { g_mutex_init(&s_taps[i].lock); g_cond_init(&s_taps[i].cond); }
+  LOG_INF("Recording: %s, %us segments, keep %u (0 = all)", s_dir, s_segment_s, s_max_files);
+}
+
+// Tee thread, ahead of the queue: after a start or an overrun, drop until a keyframe.
+static GstPadProbeReturn on_tap_in(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  RecordTap *t = (RecordTap*)user_data;
+  if (!t->resync) return GST_PAD_PROBE_OK;
+  if (GST_BUFFER_FLAG_IS_SET(GST_PAD_PROBE_INFO_BUFFER(info), GST_BUFFER_FLAG_DELTA_UNIT)) return GST_PAD_PROBE_DROP;
+  t->resync = FALSE;
+  return GST_PAD_PROBE_OK;
+}
+
+// Tee thread, right before the full queue drops the frame on_tap_in just let through.
+static void on_tap_overrun(GstElement *queue, gpointer user_data) {
+  RecordTap *t = (RecordTap*)user_data;
+  t->resync = TRUE;
+  g_atomic_int_inc(&t->gaps);
+  GstPad *qsink = gst_element_get_static_pad(queue, "sink");
+  (void)gst_pad_push_event(qsink, gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0));
+  gst_object_unref(qsink);
+}
+
+// The stop EOS at the muxer input: splitmuxsink has finished every rollover queued ahead of it.
+static GstPadProbeReturn on_muxer_eos(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  RecordTap *t = (RecordTap*)user_data;
+  GstEvent *ev = GST_PAD_PROBE_INFO_EVENT(info);
+  if (GST_EVENT_TYPE(ev) != GST_EVENT_EOS) return GST_PAD_PROBE_OK;
+  g_mutex_lock(&t->lock);
+  if (t->eos_seqnum && gst_event_get_seqnum(ev) == t->eos_seqnum) t->eos_in = TRUE;
+  g_mutex_unlock(&t->lock);
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean add_muxer_probe(GstElement *muxer, GstPad *pad, gpointer user_data) {
+  (void)muxer;
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, on_muxer_eos, user_data, NULL);
+  return TRUE;
+}
+
+// The file sink sees an EOS at every rollover; only the one after on_muxer_eos closes the last file.
+static GstPadProbeReturn on_tap_eos(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  RecordTap *t = (RecordTap*)user_data;
+  if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_EOS) return GST_PAD_PROBE_OK;
+  g_mutex_lock(&t->lock);
+  if (t->eos_in) {
+    t->eos = TRUE;
+    g_cond_signal(&t->cond);
+  }
+  g_mutex_unlock(&t->lock);
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn on_tee_pad_idle(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)info;
+  RecordTap *t = (RecordTap*)user_data;
+  GstPad *peer = gst_pad_get_peer(pad);
+  if (peer) { gst_pad_unlink(pad, peer); gst_object_unref(peer); }
+  g_mutex_lock(&t->lock);
+  t->unlinked = TRUE;
+  g_cond_signal(&t->cond);
+  g_mutex_unlock(&t->lock);
+  return GST_PAD_PROBE_REMOVE;
+}
+
+// Waits for flag under t->lock; FALSE on timeout.
+static gboolean tap_wait(RecordTap *t, gboolean *flag, guint timeout_ms) {
+  gint64 deadline = g_get_monotonic_time() + (gint64)timeout_ms * 1000;
+  g_mutex_lock(&t->lock);
+  while (!*flag && g_cond_wait_until(&t->cond, &t->lock, deadline)) {}
+  gboolean ok = *flag;
+  g_mutex_unlock(&t->lock);
+  return ok;
+}
+
+static void tap_remove_elements(RecordTap *t) {
+  GstElement *els[] = { t->queue, t->parse, t->mux };
+  for (guint i = 0; i < G_N_ELEMENTS(els); ++i) if (els[i]) gst_element_set_state(els[i], GST_STATE_NULL);
+  for (guint i = 0; i < G_N_ELEMENTS(els); ++i) if (els[i]) gst_bin_remove(GST_BIN(g_pre_bin), els[i]);
+  t->queue = t->parse = t->mux = t->muxer = t->fsink = NULL;
+}
+
+// Control worker, without g_state_lock (it waits up to 2 x RECORD_FINALIZE_MS).
+// The worker is also the only thread that starts taps and removes branches, so
+// the tap and the branch tee stay put meanwhile.
+static void tap_stop(guint index) {
+  RecordTap *t = &s_taps[index];
+  StreamInfo *si = &g_streams[index];
+  if (!t->tee_pad) return;
+
+  g_mutex_lock(&t->lock);
+  t->unlinked = t->eos_in = t->eos = FALSE;
+  t->eos_seqnum = 0;
+  g_mutex_unlock(&t->lock);
+  gst_pad_add_probe(t->tee_pad, GST_PAD_PROBE_TYPE_IDLE, on_tee_pad_idle, t, NULL);
+  // The tee pushes at frame rate (or not at all while lazy-closed), so this is short.
+  if (!tap_wait(t, &t->unlinked, RECORD_FINALIZE_MS)) LOG_WRN("Recording /s%u: tee pad did not go idle", index);
+  gst_element_release_request_pad(si->tee, t->tee_pad);
+  gst_object_unref(t->tee_pad);
+  t->tee_pad = NULL;
+
+  GstEvent *eos = gst_event_new_eos();
+  g_mutex_lock(&t->lock);
+  t->eos_seqnum = gst_event_get_seqnum(eos);
+  g_mutex_unlock(&t->lock);
+  GstPad *qsink = gst_element_get_static_pad(t->queue, "sink");
+  gst_pad_send_event(qsink, eos);
+  gst_object_unref(qsink);
+  gboolean finalized = tap_wait(t, &t->eos, RECORD_FINALIZE_MS);
+  tap_remove_elements(t);
+  lazy_branch_pin(index, FALSE);
+  guint gaps = (guint)g_atomic_int_get(&t->gaps);
+  if (finalized) LOG_INF("Recording /s%u stopped (%s, %u gaps)", index, t->info.location, gaps);
+  else LOG_WRN("Recording /s%u stopped without finalizing the last segment (%s)", index, t->info.location);
+  g_mutex_lock(&g_state_lock);
+  t->info.active = FALSE;
+  t->info.gaps = gaps;
+  g_mutex_unlock(&g_state_lock);
+}
+
+RecordResult record_start(guint index, guint segment_s, guint max_files, RecordInfo *out) {
+  if (index >= G_N_ELEMENTS(g_streams)) return RECORD_NO_STREAM;
+  g_mutex_lock(&g_state_lock);
+  StreamInfo *si = &g_streams[index];
+  RecordTap *t = &s_taps[index];
+  RecordResult rc = RECORD_OK;
+  if (!si->in_use || !si->tee) { rc = RECORD_NO_STREAM; goto out; }
+  if (t->tee_pad) { rc = RECORD_BUSY; goto out; }
+  if (g_mkdir_with_parents(s_dir, 0755) != 0) {
+    LOG_ERR("Recording: cannot create %s: %s", s_dir, g_strerror(errno));
+    rc = RECORD_FAILED; goto out;
+  }
+
+  t->queue = gst_element_factory_make("queue", NULL);
+  t->parse = gst_element_factory_make("h264parse", NULL);
+  t->mux = gst_element_factory_make("splitmuxsink", NULL);
+  t->muxer = gst_element_factory_make("mp4mux", NULL);
+  t->fsink = gst_element_factory_make("filesink", NULL);
+  if (!t->queue || !t->parse || !t->mux || !t->muxer || !t->fsink) {
+    LOG_ERR("Recording: element creation failed (splitmuxsink/mp4mux/h264parse)");
+    GstElement *els[] = { t->queue, t->parse, t->mux, t->muxer, t->fsink };
+    for (guint i = 0; i < G_N_ELEMENTS(els); ++i) if (els[i]) gst_object_unref(els[i]);
+    t->queue = t->parse = t->mux = t->muxer = t->fsink = NULL;
+    rc = RECORD_FAILED; goto out;
+  }
+
+  memset(&t->info, 0, sizeof(t->info));
+  t->info.segment_s = segment_s ? segment_s : s_segment_s;
+  t->info.max_files = max_files != G_MAXUINT ? max_files : s_max_files;
+  GDateTime *now = g_date_time_new_now_local();
+  gchar *stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+  g_date_time_unref(now);
+  g_snprintf(t->info.location, sizeof(t->info.location), "%s/s%u_%s_%%05d.mp4", s_dir, index, stamp);
+  g_free(stamp);
+
+  t->resync = TRUE;
+  g_atomic_int_set(&t->gaps, 0);
+  g_object_set(t->queue, "leaky", 1, "max-size-time", s_queue_ns, "max-size-buffers", 0, "max-size-bytes", 0, NULL);
+  g_signal_connect(t->queue, "overrun", G_CALLBACK(on_tap_overrun), t);
+  g_object_set(t->mux, "location", t->info.location, "max-size-time", (guint64)t->info.segment_s * GST_SECOND,
+               "max-files", t->info.max_files, "muxer", t->muxer, "sink", t->fsink, NULL);
+  GstPad *fsink_pad = gst_element_get_static_pad(t->fsink, "sink");
+  gst_pad_add_probe(fsink_pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, on_tap_eos, t, NULL);
+  gst_object_unref(fsink_pad);
+  GstPad *qsink = gst_element_get_static_pad(t->queue, "sink");
+  gst_pad_add_probe(qsink, GST_PAD_PROBE_TYPE_BUFFER, on_tap_in, t, NULL);
+
+  gst_bin_add_many(GST_BIN(g_pre_bin), t->queue, t->parse, t->mux, NULL);
+  gboolean ok = gst_element_link_many(t->queue, t->parse, t->mux, NULL);
+  // Linking requested the muxer's sink pad (splitmuxsink does it with its own pad).
+  if (ok) gst_element_foreach_sink_pad(t->muxer, add_muxer_probe, t);
+  gst_element_sync_state_with_parent(t->mux);
+  gst_element_sync_state_with_parent(t->parse);
+  gst_element_sync_state_with_parent(t->queue);
+  t->tee_pad = ok ? gst_element_request_pad_simple(si->tee, "src_%u") : NULL;
+  ok = t->tee_pad && gst_pad_link(t->tee_pad, qsink) == GST_PAD_LINK_OK;
+  gst_object_unref(qsink);
+  if (!ok) {
+    LOG_ERR("Recording /s%u: tap link failed", index);
+    if (t->tee_pad) { gst_element_release_request_pad(si->tee, t->tee_pad); gst_object_unref(t->tee_pad); t->tee_pad = NULL; }
+    tap_remove_elements(t);
+    rc = RECORD_FAILED; goto out;
+  }
+
+  // Recording counts as a consumer for lazy encoding; the keyframe opens the first segment.
+  lazy_branch_pin(index, TRUE);
+  lazy_request_keyframe(si->enc);
+  t->started_us = g_get_monotonic_time();
+  t->info.active = TRUE;
+  LOG_INF("Recording /s%u -> %s (%us segments, keep %u)", index, t->info.location, t->info.segment_s, t->info.max_files);
+
+out:
+  if (out) *out = t->info;
+  g_mutex_unlock(&g_state_lock);
+  return rc;
+}
+
+RecordResult record_stop(guint index) {
+  if (index >= G_N_ELEMENTS(g_streams)) return RECORD_NO_STREAM;
+  g_mutex_lock(&g_state_lock);
+  RecordResult rc = !g_streams[index].in_use ? RECORD_NO_STREAM : (!s_taps[index].tee_pad ? RECORD_BUSY : RECORD_OK);
+  g_mutex_unlock(&g_state_lock);
+  if (rc == RECORD_OK) tap_stop(index);
+  return rc;
+}
+
+gboolean record_info(guint index, RecordInfo *out) {
+  if (index >= G_N_ELEMENTS(g_streams)) return FALSE;
+  g_mutex_lock(&g_state_lock);
+  gboolean ok = g_streams[index].in_use;
+  if (ok) {
+    RecordTap *t = &s_taps[index];
+    *out = t->info;
+    if (t->info.active) {
+      out->elapsed_s = (guint)((g_get_monotonic_time() - t->started_us) / G_USEC_PER_SEC);
+      out->gaps = (guint)g_atomic_int_get(&t->gaps);
+    }
+  }
+  g_mutex_unlock(&g_state_lock);
+  return ok;
+}
+
+void record_branch_detach(guint index) {
+  if (index >= G_N_ELEMENTS(s_taps)) return;
+  tap_stop(index);
+  g_mutex_lock(&g_state_lock);
+  memset(&s_taps[index].info, 0, sizeof(s_taps[index].info));
+  g_mutex_unlock(&g_state_lock);
+}
@@ -0,0 +1,36 @@
+// Per-stream recording tap: segmented MP4 from the branch's encoded H.264 (no re-encode)
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <glib.h>
+
+typedef enum {
+  RECORD_OK = 0,
+  RECORD_NO_STREAM,  // slot not in use
+  RECORD_BUSY,       // start while recording / stop while not
+  RECORD_FAILED,
+} RecordResult;
+
+typedef struct {
+  gboolean active;
+  gchar location[256]; // splitmuxsink pattern, e.g. /recordings/s3_20260101-120000_%05d.mp4
+  guint segment_s;
+  guint max_files;     // 0 = keep every segment
+  guint elapsed_s;
+  guint gaps;          // queue overruns, each dropping frames up to the next keyframe
+} RecordInfo;
+
+// RECORD_DIR (default /recordings), RECORD_SEGMENT_S (60), RECORD_MAX_FILES (60),
+// RECORD_QUEUE_MS (2000: how much the tap may lag before it drops).
+void record_init(void);
+
+// Take g_state_lock (stop only around its waits for the tap to drain, up to 6 s).
+// segment_s 0 / max_files G_MAXUINT pick the defaults.
+RecordResult record_start(guint index, guint segment_s, guint max_files, RecordInfo *out);
+RecordResult record_stop(guint index);
+gboolean record_info(guint index, RecordInfo *out);
+
+// Branch teardown, before the caller takes g_state_lock: finalize and drop any tap on index.
+void record_branch_detach(guint index);
+
+#endif // RECORD_H
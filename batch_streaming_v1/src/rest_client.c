@@ -0,0 +1,312 @@
+// Keep-alive REST client for nvmultiurisrcbin (L2)
+// - One sender thread drains a FIFO of jobs, so adds/removes keep their order.
+// - Idle keep-alive sockets are pooled; the port that answered is cached and only
+//   re-probed when connecting to it fails.
+// - A request is only sent again when it provably never left (connect failure, or
+//   no byte of it written), with exponential backoff. A timeout, a dropped
+//   connection after sending, or a 5xx fails it: a camera_add must not run twice.
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "log.h"
+#include "config.h"
+#include "rest_client.h"
+
+typedef struct {
+  gchar *path;
+  gchar **bodies;
+  guint n;
+  gint64 enqueued_us;
+  gboolean wait;        // caller blocks until done (otherwise the sender frees the job)
+  GMutex lock;
+  GCond cond;
+  gboolean done;
+  guint acked;          // requests answered with 2xx
+} RestJob;
+
+static GAsyncQueue *s_jobs = NULL;
+static gchar **s_ports = NULL;     // candidate ports, in probe order
+static gint s_port_idx = -1;       // cached index into s_ports (sender thread only)
+static GQueue s_pool = G_QUEUE_INIT; // idle keep-alive fds (sender thread only)
+static guint s_pool_max = 2;
+static guint s_retries = 3;
+static guint s_backoff_ms = 100;
+static guint s_timeout_ms = 5000;
+
+static GMutex s_stats_lock;
+static RestClientStats s_stats;
+
+// nvmultiurisrcbin answers with a few hundred bytes; anything claiming more is garbage.
+#define REST_MAX_RESPONSE (1024 * 1024)
+
+static int connect_port(const char *port_str) {
+  struct addrinfo hints; memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC; hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *res = NULL;
+  int err = getaddrinfo("127.0.0.1", port_str, &hints, &res);
+  if (err != 0 || !res) { LOG_WRN("REST: getaddrinfo failed: %s", gai_strerror(err)); if (res) freeaddrinfo(res); return -1; }
+  int s = -1; for (struct addrinfo *rp = res; rp != NULL; rp = rp->ai_next) {
+    s = socket(rp->ai_family, rp->ai_socktype | SOCK_CLOEXEC, rp->ai_protocol);
+    if (s == -1) continue;
+    // A server that accepts but never answers must not hold the sender thread.
+    struct timeval tv = { .tv_sec = s_timeout_ms / 1000, .tv_usec = (s_timeout_ms % 1000) * 1000 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (connect(s, rp->ai_addr, rp->ai_addrlen) == 0) break;
+    close(s); s = -1;
+  }
+  freeaddrinfo(res);
+  g_mutex_lock(&s_stats_lock); s_stats.connects++; g_mutex_unlock(&s_stats_lock);
+  return s;
+}
+
+// Fresh connection: cached port first, then probe the others and cache the winner.
+static int connect_any(void) {
+  guint nports = g_strv_length(s_ports);
+  for (guint k = 0; k < nports; ++k) {
+    guint idx = s_port_idx >= 0 ? ((guint)s_port_idx + k) % nports : k;
+    int s = connect_port(s_ports[idx]);
+    if (s < 0) continue;
+    if (s_port_idx != (gint)idx) {
+      s_port_idx = (gint)idx;
+      LOG_INF("REST: using nvmultiurisrcbin on port %s", s_ports[idx]);
+      g_mutex_lock(&s_stats_lock); s_stats.port = (guint) g_ascii_strtoull(s_ports[idx], NULL, 10); g_mutex_unlock(&s_stats_lock);
+    }
+    return s;
+  }
+  return -1;
+}
+
+// Idle keep-alive socket the server has not closed (nothing pending, not even EOF).
+static gboolean pool_alive(int s) {
+  char c;
+  ssize_t n = recv(s, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+// Sockets the server dropped while pooled are discarded before anything is written.
+static int pool_take(gboolean *reused) {
+  while (!g_queue_is_empty(&s_pool)) {
+    int s = GPOINTER_TO_INT(g_queue_pop_head(&s_pool));
+    if (pool_alive(s)) { *reused = TRUE; return s; }
+    close(s);
+  }
+  *reused = FALSE;
+  return connect_any();
+}
+
+static void pool_put(int s) {
+  if (g_queue_get_length(&s_pool) >= s_pool_max) { close(s); return; }
+  g_queue_push_tail(&s_pool, GINT_TO_POINTER(s));
+}
+
+static void pool_drop_all(void) {
+  while (!g_queue_is_empty(&s_pool)) close(GPOINTER_TO_INT(g_queue_pop_head(&s_pool)));
+}
+
+// Bytes written before the connection failed or timed out (len if all of them).
+static gsize send_all(int s, const char *buf, gsize len) {
+  gsize sent = 0;
+  while (sent < len) {
+    ssize_t n = send(s, buf + sent, len - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    sent += (gsize)n;
+  }
+  return sent;
+}
+
+// Read one HTTP response off s (acc buffers bytes across responses).
+// Returns FALSE if the peer went away or went quiet for REST_TIMEOUT_MS before a
+// complete response, or sent a Content-Length that is not a number up to
+// REST_MAX_RESPONSE.
+static gboolean read_response(int s, GString *acc, guint *status, gboolean *server_close) {
+  char buf[1024];
+  for (;;) {
+    const gchar *hdr_end = g_strstr_len(acc->str, (gssize)acc->len, "\r\n\r\n");
+    gssize content_len = -1;
+    if (hdr_end) {
+      *status = g_str_has_prefix(acc->str, "HTTP/1.") ? (guint) g_ascii_strtoull(acc->str + 9, NULL, 10) : 0;
+      *server_close = FALSE;
+      for (const gchar *p = acc->str; p < hdr_end; ++p) {
+        if (p != acc->str && p[-1] != '\n') continue;
+        if (g_ascii_strncasecmp(p, "Content-Length:", 15) == 0) {
+          gchar *v = g_strstrip(g_strndup(p + 15, strcspn(p + 15, "\r\n")));
+          guint64 len = 0;
+          gboolean ok = g_ascii_string_to_unsigned(v, 10, 0, REST_MAX_RESPONSE, &len, NULL);
+          if (!ok) LOG_WRN("REST: bad response Content-Length '%s'", v);
+          g_free(v);
+          if (!ok) return FALSE;
+          content_len = (gssize) len;
+        } else if (g_ascii_strncasecmp(p, "Connection: close", 17) == 0) *server_close = TRUE;
+      }
+      gsize total = (gsize)(hdr_end - acc->str) + 4 + (content_len > 0 ? (gsize)content_len : 0);
+      if (content_len >= 0 && acc->len >= total) { g_string_erase(acc, 0, (gssize)total); return TRUE; }
+    }
+    ssize_t n = recv(s, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      // No Content-Length: the response runs to EOF (a timeout is not an EOF).
+      if (n == 0 && hdr_end && content_len < 0) { g_string_truncate(acc, 0); *server_close = TRUE; return TRUE; }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) LOG_WRN("REST: no response within %u ms", s_timeout_ms);
+      return FALSE;
+    }
+    g_string_append_len(acc, buf, n);
+  }
+}
+
+static void run_job(RestJob *job) {
+  guint attempt = 0;
+  guint backoff_ms = s_backoff_ms;
+  guint next = 0; // first request not yet answered
+  gboolean any_error = FALSE;
+  gsize *starts = g_new(gsize, job->n); // offset of each pipelined request in this attempt's send
+  while (next < job->n) {
+    gboolean reused = FALSE;
+    int s = pool_take(&reused);
+    gboolean transport_ok = FALSE;
+    gboolean unsent = TRUE; // no byte of request `next` left: sending it again is safe
+    if (s >= 0) {
+      const gchar *port = s_ports[s_port_idx >= 0 ? s_port_idx : 0];
+      GString *req = g_string_new(NULL);
+      guint first = next;
+      for (guint i = next; i < job->n; ++i) {
+        starts[i] = req->len;
+        g_string_append_printf(req,
+          "POST %s HTTP/1.1\r\nHost: 127.0.0.1:%s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: keep-alive\r\n\r\n%s",
+          job->path, port, strlen(job->bodies[i]), job->bodies[i]);
+      }
+      // Read back whatever was answered even if the server cut the send short.
+      gsize sent = send_all(s, req->str, req->len);
+      g_string_free(req, TRUE);
+      GString *acc = g_string_new(NULL);
+      gboolean server_close = FALSE;
+      guint status = 0;
+      transport_ok = sent > 0;
+      while (transport_ok && next < job->n) {
+        if (!read_response(s, acc, &status, &server_close)) { transport_ok = FALSE; break; }
+        // Answered, 5xx included: the server saw it, so it is never sent again.
+        if (status >= 200 && status < 300) job->acked++;
+        else { any_error = TRUE; LOG_WRN("REST: %s answered %u", job->path, status); }
+        next++;
+        if (server_close) break;
+      }
+      g_string_free(acc, TRUE);
+      if (transport_ok && !server_close) pool_put(s);
+      else close(s);
+      if (next < job->n) unsent = sent <= starts[next] - starts[first];
+    }
+    if (next >= job->n) break;
+    // Connection: close after an answer: the server drops the rest unread, so go again.
+    if (s >= 0 && transport_ok) continue;
+    if (!unsent) {
+      LOG_WRN("REST: %s lost the connection after sending request %u; not resending", job->path, next + 1);
+      any_error = TRUE;
+      break;
+    }
+    // A pooled socket that failed before taking a byte is not a failure: reconnect at once.
+    if (reused) { pool_drop_all(); continue; }
+    if (s < 0) s_port_idx = -1; // nothing answered: re-probe every port next time
+    if (attempt++ >= s_retries) { any_error = TRUE; break; }
+    g_mutex_lock(&s_stats_lock); s_stats.retries++; g_mutex_unlock(&s_stats_lock);
+    g_usleep((gulong)backoff_ms * 1000);
+    backoff_ms *= 2;
+  }
+  g_free(starts);
+  if (next < job->n) LOG_WRN("REST: %s failed for %u of %u request(s)", job->path, job->n - next, job->n);
+
+  guint64 lat = (guint64)(g_get_monotonic_time() - job->enqueued_us);
+  g_mutex_lock(&s_stats_lock);
+  s_stats.calls++;
+  if (any_error || job->acked < job->n) s_stats.failures++;
+  s_stats.last_us = lat;
+  s_stats.total_us += lat;
+  if (lat > s_stats.max_us) s_stats.max_us = lat;
+  g_mutex_unlock(&s_stats_lock);
+}
+
+static void job_free(RestJob *job) {
+  g_free(job->path);
+  g_strfreev(job->bodies);
+  g_mutex_clear(&job->lock);
+  g_cond_clear(&job->cond);
+  g_free(job);
+}
+
+static gpointer sender_thread(gpointer data) {
+  (void)data;
+  for (;;) {
+    RestJob *job = (RestJob*) g_async_queue_pop(s_jobs);
+    run_job(job);
+    if (!job->wait) { job_free(job); continue; }
+    g_mutex_lock(&job->lock);
+    job->done = TRUE;
+    g_cond_signal(&job->cond);
+    g_mutex_unlock(&job->lock);
+  }
+  return NULL;
+}
+
+void rest_client_init(void) {
+  if (s_jobs) return;
+  const gchar *env = g_getenv("REST_PORTS");
+  s_ports = g_strsplit(env && *env ? env : "9010,9000", ",", -1);
+  s_pool_max = MAX(1, config_env_uint("REST_POOL_SIZE", 2));
+  s_retries = config_env_uint("REST_RETRIES", 3);
+  s_backoff_ms = MAX(1, config_env_uint("REST_BACKOFF_MS", 100));
+  s_timeout_ms = MAX(1, config_env_uint("REST_TIMEOUT_MS", 5000));
+  s_jobs = g_async_queue_new();
+  (void)g_thread_new("rest_client", sender_thread, NULL);
+}
+
+static RestJob *job_new(const gchar *path, gchar **bodies, guint n, gboolean wait) {
+  RestJob *job = g_new0(RestJob, 1);
+  job->path = g_strdup(path);
+  job->bodies = bodies;
+  job->n = n;
+  job->wait = wait;
+  job->enqueued_us = g_get_monotonic_time();
+  g_mutex_init(&job->lock);
+  g_cond_init(&job->cond);
+  return job;
+}
+
+static guint submit_and_wait(RestJob *job) {
+  g_async_queue_push(s_jobs, job);
+  g_mutex_lock(&job->lock);
+  while (!job->done) g_cond_wait(&job->cond, &job->lock);
+  g_mutex_unlock(&job->lock);
+  guint acked = job->acked;
+  job_free(job);
+  return acked;
+}
+
+void rest_client_post_async(const gchar *path, const gchar *body) {
+  gchar **bodies = g_new0(gchar*, 2);
+  bodies[0] = g_strdup(body);
+  g_async_queue_push(s_jobs, job_new(path, bodies, 1, FALSE));
+}
+
+gboolean rest_client_post(const gchar *path, const gchar *body) {
+  gchar **bodies = g_new0(gchar*, 2);
+  bodies[0] = g_strdup(body);
+  return submit_and_wait(job_new(path, bodies, 1, TRUE)) == 1;
+}
+
+guint rest_client_post_batch(const gchar *path, gchar **bodies, guint n) {
+  if (n == 0) return 0;
+  gchar **copy = g_new0(gchar*, n + 1);
+  for (guint i = 0; i < n; ++i) copy[i] = g_strdup(bodies[i]);
+  return submit_and_wait(job_new(path, copy, n, TRUE));
+}
+
+void rest_client_get_stats(RestClientStats *out) {
+  g_mutex_lock(&s_stats_lock);
+  *out = s_stats;
+  g_mutex_unlock(&s_stats_lock);
+  out->queued = s_jobs ? (guint) MAX(0, g_async_queue_length(s_jobs)) : 0;
+}
@@ -0,0 +1,31 @@
+// Keep-alive client for the nvmultiurisrcbin REST API (localhost 9010, then 9000)
+#ifndef REST_CLIENT_H
+#define REST_CLIENT_H
+
+#include <glib.h>
+
+typedef struct {
+  guint64 calls;      // API calls completed (a batch counts once)
+  guint64 failures;   // calls that ended without a 2xx for every request
+  guint64 retries;    // extra attempts for requests that never left (connect or send failed)
+  guint64 connects;   // TCP connects (pool misses, stale reconnects, port probes)
+  guint64 last_us;    // latency of the last call (enqueue -> final response)
+  guint64 max_us;
+  guint64 total_us;
+  guint queued;       // jobs waiting for the sender thread
+  guint port;         // REST port currently cached (0 = not found yet)
+} RestClientStats;
+
+// Starts the sender thread. REST_PORTS (default "9010,9000"), REST_POOL_SIZE,
+// REST_RETRIES, REST_BACKOFF_MS and REST_TIMEOUT_MS (per send/receive) tune it.
+void rest_client_init(void);
+
+// All calls go through one FIFO, so requests reach the server in call order.
+void rest_client_post_async(const gchar *path, const gchar *body);
+gboolean rest_client_post(const gchar *path, const gchar *body);
+// Pipelines every body on one connection; returns how many got a 2xx.
+guint rest_client_post_batch(const gchar *path, gchar **bodies, guint n);
+
+void rest_client_get_stats(RestClientStats *out);
+
+#endif // REST_CLIENT_H
@@ -0,0 +1,360 @@
+// Multi-process sharding (L1)
+// - SHARDS=K (>1): this process becomes a thin front. It spawns K copies of itself,
+//   each a full pipeline with its own batch, RTSP/UDP/REST/control ports and CPU
+//   slice, so a crash or a stuck bus only takes down one shard. Exited shards are
+//   respawned.
+// - The front polls every shard's /status once a second; adds go to the least-loaded
+//   live shard, everything else is forwarded to the shard named in ?shard=.
+// - Host-wide encoder budgets are cut per shard: HW_THRESHOLD NVENC sessions and
+//   ADMISSION_CORES are split, and x264 is calibrated once in the front (K shards
+//   calibrating at once would each measure a contended core) and handed down.
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <glib-unix.h>
+#include <gst/gst.h>
+#include <json-glib/json-glib.h>
+#include "log.h"
+#include "config.h"
+#include "admission.h"
+#include "control.h"
+#include "shard.h"
+
+#define SHARD_POLL_S 1
+#define SHARD_RESPAWN_S 2
+#define SHARD_STATUS_TIMEOUT_S 2
+#define SHARD_ADD_TIMEOUT_S 60    // batch adds build branches and wait on REST
+#define SHARD_FORWARD_TIMEOUT_S 10 // everything else: config, record, remove, snapshot
+
+typedef struct {
+  ShardPlan plan;
+  GPid pid;        // 0 while not running
+  guint restarts;  // unexpected exits
+  ShardLoad load;
+} ShardChild;
+
+static GMutex s_lock; // guards s_children[].pid/restarts/load
+static ShardChild s_children[SHARD_MAX];
+static guint s_count = 0;
+static gboolean s_stopping = FALSE;
+static GMainLoop *s_loop = NULL;
+
+// --- Pure helpers
+void shard_plan(const ShardBase *base, guint i, ShardPlan *out) {
+  memset(out, 0, sizeof(*out));
+  out->max_streams = base->batch;
+  out->rtsp_port = base->rtsp_port + i;
+  out->base_udp_port = base->base_udp_port + i * base->batch;
+  out->ctrl_port = base->ctrl_port + 1 + i;
+  out->rest_port = base->rest_port + i;
+  out->sw_fps_per_core = base->sw_fps_per_core;
+  if (base->shards == 0) return;
+  // Remainder sessions go to the lowest shards, so the shards sum to the host cap.
+  out->hw_threshold = base->hw_sessions / base->shards + (i < base->hw_sessions % base->shards ? 1 : 0);
+  out->admission_cores = base->admission_cores / base->shards;
+  if (base->cpu_cores == 0) return;
+  if (base->cpu_cores >= base->shards) {
+    out->cpu_cores = base->cpu_cores / base->shards;
+    out->cpu_first = base->cpu_first + i * out->cpu_cores;
+  } else {
+    // Fewer CPUs than shards: shards share single CPUs round-robin.
+    out->cpu_cores = 1;
+    out->cpu_first = base->cpu_first + i % base->cpu_cores;
+  }
+}
+
+gint shard_pick(const ShardLoad *loads, guint n) {
+  gint best = -1;
+  for (guint i = 0; i < n; ++i) {
+    const ShardLoad *l = &loads[i];
+    if (!l->alive || l->active >= l->capacity) continue;
+    // active_i / cap_i < active_b / cap_b without floating point
+    if (best < 0 || (guint64)l->active * loads[best].capacity < (guint64)loads[best].active * l->capacity) best = (gint)i;
+  }
+  return best;
+}
+
+gboolean shard_front_enabled(void) {
+  return config_env_uint("SHARDS", 1) > 1 && !g_getenv("SHARD_INDEX");
+}
+
+// --- Shard HTTP (one request per connection; the shard closes after responding)
+// resp_len / ctype (optional) make the body binary-safe: it is NUL-terminated either way.
+static gboolean shard_http(guint port, const gchar *method, const gchar *target, const gchar *body, guint timeout_s,
+                           gchar **status, gchar **resp_body, guint *retry_after, gsize *resp_len, gchar **ctype) {
+  int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (s < 0) return FALSE;
+  struct timeval tv = { .tv_sec = timeout_s, .tv_usec = 0 };
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in addr; memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET; addr.sin_port = htons((uint16_t)port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(s, (struct sockaddr*)&addr, sizeof(addr)) != 0) { close(s); return FALSE; }
+
+  gsize blen = body ? strlen(body) : 0;
+  GString *req = g_string_new(NULL);
+  g_string_append_printf(req, "%s %s HTTP/1.1\r\nHost: 127.0.0.1:%u\r\nConnection: close\r\n", method, target, port);
+  if (body) g_string_append_printf(req, "Content-Type: application/json\r\nContent-Length: %zu\r\n", blen);
+  g_string_append(req, "\r\n");
+  if (body) g_string_append_len(req, body, (gssize)blen);
+  gboolean ok = TRUE;
+  for (gsize off = 0; ok && off < req->len; ) {
+    ssize_t n = send(s, req->str + off, req->len - off, MSG_NOSIGNAL);
+    if (n <= 0) ok = FALSE; else off += (gsize)n;
+  }
+  g_string_free(req, TRUE);
+
+  GString *in = g_string_new(NULL);
+  char buf[4096];
+  ssize_t n;
+  while (ok && (n = recv(s, buf, sizeof(buf), 0)) > 0) g_string_append_len(in, buf, n);
+  close(s);
+
+  const gchar *eoh = strstr(in->str, "\r\n\r\n");
+  const gchar *sp = strchr(in->str, ' ');
+  const gchar *eol = strstr(in->str, "\r\n");
+  ok = ok && eoh && sp && eol && sp < eol && g_str_has_prefix(in->str, "HTTP/1.");
+  if (ok) {
+    if (status) *status = g_strndup(sp + 1, (gsize)(eol - sp - 1));
+    gsize blen = in->len - (gsize)(eoh + 4 - in->str);
+    if (resp_body) {
+      *resp_body = g_malloc(blen + 1);
+      memcpy(*resp_body, eoh + 4, blen);
+      (*resp_body)[blen] = '\0';
+    }
+    if (resp_len) *resp_len = blen;
+    gchar *head = g_ascii_strdown(in->str, (gssize)(eoh - in->str));
+    if (retry_after) {
+      const gchar *ra = strstr(head, "\r\nretry-after:");
+      *retry_after = ra ? (guint) g_ascii_strtoull(ra + strlen("\r\nretry-after:"), NULL, 10) : 0;
+    }
+    if (ctype) {
+      const gchar *ct = strstr(head, "\r\ncontent-type:");
+      const gchar *v = ct ? ct + strlen("\r\ncontent-type:") : NULL;
+      const gchar *e = v ? strstr(v, "\r\n") : NULL;
+      *ctype = v ? g_strstrip(g_strndup(v, e ? (gsize)(e - v) : strlen(v))) : g_strdup("application/octet-stream");
+    }
+    g_free(head);
+  }
+  g_string_free(in, TRUE);
+  return ok;
+}
+
+// --- Load polling
+static ShardLoad poll_shard(guint port) {
+  ShardLoad l = { FALSE, 0, 0 };
+  gchar *status = NULL, *body = NULL;
+  if (shard_http(port, "GET", "/status", NULL, SHARD_STATUS_TIMEOUT_S, &status, &body, NULL, NULL, NULL) && g_str_has_prefix(status, "200")) {
+    JsonParser *parser = json_parser_new();
+    if (json_parser_load_from_data(parser, body, -1, NULL)) {
+      JsonNode *root = json_parser_get_root(parser);
+      if (root && JSON_NODE_HOLDS_OBJECT(root)) {
+        JsonObject *obj = json_node_get_object(root);
+        JsonArray *streams = json_object_has_member(obj, "streams") ? json_object_get_array_member(obj, "streams") : NULL;
+        l.alive = TRUE;
+        l.capacity = (guint) json_object_get_int_member(obj, "max");
+        l.active = streams ? json_array_get_length(streams) : 0;
+      }
+    }
+    g_object_unref(parser);
+  }
+  g_free(status); g_free(body);
+  return l;
+}
+
+void shard_front_refresh(guint s) {
+  if (s >= s_count) return;
+  ShardLoad l = poll_shard(s_children[s].plan.ctrl_port);
+  g_mutex_lock(&s_lock);
+  if (!s_children[s].pid) l.alive = FALSE;
+  s_children[s].load = l;
+  g_mutex_unlock(&s_lock);
+}
+
+static gpointer poll_thread(gpointer data) {
+  (void)data;
+  for (;;) {
+    for (guint i = 0; i < s_count; ++i) shard_front_refresh(i);
+    g_usleep(SHARD_POLL_S * G_USEC_PER_SEC);
+  }
+  return NULL;
+}
+
+// --- Child processes
+static gboolean spawn_shard(gpointer data);
+
+static void on_shard_exit(GPid pid, gint wait_status, gpointer data) {
+  guint i = GPOINTER_TO_UINT(data);
+  g_spawn_close_pid(pid);
+  g_mutex_lock(&s_lock);
+  s_children[i].pid = 0;
+  s_children[i].load.alive = FALSE;
+  if (!s_stopping) s_children[i].restarts++;
+  g_mutex_unlock(&s_lock);
+  if (s_stopping) {
+    gboolean any = FALSE;
+    for (guint k = 0; k < s_count; ++k) any = any || s_children[k].pid != 0;
+    if (!any) g_main_loop_quit(s_loop);
+    return;
+  }
+  if (WIFSIGNALED(wait_status)) LOG_ERR("Shard %u (pid %d) killed by signal %d; respawning in %us", i, pid, WTERMSIG(wait_status), SHARD_RESPAWN_S);
+  else LOG_WRN("Shard %u (pid %d) exited with %d; respawning in %us", i, pid, WEXITSTATUS(wait_status), SHARD_RESPAWN_S);
+  g_timeout_add_seconds(SHARD_RESPAWN_S, spawn_shard, data);
+}
+
+static gchar **shard_env(guint i, const ShardPlan *p) {
+  gchar **env = g_get_environ();
+  gchar v[32];
+#define SET_ENV(name, fmt, val) do { g_snprintf(v, sizeof(v), fmt, val); env = g_environ_setenv(env, name, v, TRUE); } while (0)
+  SET_ENV("SHARD_INDEX", "%u", i);
+  SET_ENV("RTSP_PORT", "%u", p->rtsp_port);
+  SET_ENV("BASE_UDP_PORT", "%u", p->base_udp_port);
+  SET_ENV("CTRL_PORT", "%u", p->ctrl_port);
+  SET_ENV("MAX_STREAMS", "%u", p->max_streams);
+  SET_ENV("REST_PORT", "%u", p->rest_port);
+  SET_ENV("REST_PORTS", "%u", p->rest_port);
+  SET_ENV("HW_THRESHOLD", "%u", p->hw_threshold);
+  env = g_environ_setenv(env, "ADMISSION_CORES", g_ascii_formatd(v, sizeof(v), "%.3f", p->admission_cores), TRUE);
+  if (p->sw_fps_per_core) SET_ENV("ADMISSION_SW_FPS_PER_CORE", "%u", p->sw_fps_per_core);
+  if (p->cpu_cores) {
+    SET_ENV("CPU_BUDGET_FIRST", "%u", p->cpu_first);
+    SET_ENV("CPU_BUDGET_CORES", "%u", p->cpu_cores);
+  }
+#undef SET_ENV
+  return env;
+}
+
+static gboolean spawn_shard(gpointer data) {
+  guint i = GPOINTER_TO_UINT(data);
+  if (s_stopping) return G_SOURCE_REMOVE;
+  ShardChild *c = &s_children[i];
+  gchar *argv[] = { (gchar*)"/proc/self/exe", NULL };
+  gchar **envp = shard_env(i, &c->plan);
+  GError *err = NULL;
+  GPid pid = 0;
+  if (!g_spawn_async(NULL, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &err)) {
+    LOG_ERR("Shard %u: spawn failed: %s; retrying in %us", i, err ? err->message : "?", SHARD_RESPAWN_S);
+    if (err) g_error_free(err);
+    g_strfreev(envp);
+    g_timeout_add_seconds(SHARD_RESPAWN_S, spawn_shard, data);
+    return G_SOURCE_REMOVE;
+  }
+  g_strfreev(envp);
+  g_mutex_lock(&s_lock);
+  c->pid = pid;
+  g_mutex_unlock(&s_lock);
+  g_child_watch_add(pid, on_shard_exit, data);
+  LOG_INF("Shard %u: pid %d, %u streams, RTSP %u, UDP %u-%u, control %u, REST %u, CPUs %s%u+%u, NVENC %u, admission %.2f cores",
+          i, pid, c->plan.max_streams, c->plan.rtsp_port, c->plan.base_udp_port, c->plan.base_udp_port + c->plan.max_streams - 1,
+          c->plan.ctrl_port, c->plan.rest_port, c->plan.cpu_cores ? "" : "(inherited) ", c->plan.cpu_first, c->plan.cpu_cores,
+          c->plan.hw_threshold, c->plan.admission_cores);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean on_front_signal(gpointer data) {
+  (void)data;
+  if (s_stopping) return G_SOURCE_CONTINUE;
+  LOG_INF("Signal received; stopping %u shards", s_count);
+  s_stopping = TRUE;
+  gboolean any = FALSE;
+  g_mutex_lock(&s_lock);
+  for (guint i = 0; i < s_count; ++i) {
+    if (s_children[i].pid) { kill(s_children[i].pid, SIGTERM); any = TRUE; }
+  }
+  g_mutex_unlock(&s_lock);
+  if (!any) g_main_loop_quit(s_loop);
+  return G_SOURCE_CONTINUE;
+}
+
+// --- Front
+int shard_front_run(const AppConfig *cfg) {
+  ShardBase base;
+  memset(&base, 0, sizeof(base));
+  base.shards = MIN(config_env_uint("SHARDS", 1), (guint)SHARD_MAX);
+  base.batch = CLAMP(config_env_uint("SHARD_BATCH", 64 / base.shards), 1u, 64u);
+  base.rtsp_port = cfg->rtsp_port;
+  base.base_udp_port = cfg->base_udp_port;
+  base.ctrl_port = config_env_uint("CTRL_PORT", 8080);
+  base.rest_port = cfg->rest_port ? cfg->rest_port : 9000;
+  guint cpus = (guint) g_get_num_processors();
+  base.cpu_first = MIN(config_env_uint("CPU_BUDGET_FIRST", 0), cpus - 1);
+  base.cpu_cores = MIN(config_env_uint("CPU_BUDGET_CORES", cpus), cpus - base.cpu_first);
+  base.hw_sessions = config_env_uint("HW_THRESHOLD", 8);
+  const gchar *cores = g_getenv("ADMISSION_CORES");
+  base.admission_cores = cores && *cores ? g_ascii_strtod(cores, NULL) : (gdouble)base.cpu_cores;
+  base.sw_fps_per_core = config_env_uint("ADMISSION_SW_FPS_PER_CORE", 0);
+  if (base.sw_fps_per_core == 0) {
+    gst_init(NULL, NULL);
+    base.sw_fps_per_core = (guint)(admission_calibrate_x264() + 0.5);
+    LOG_INF("Sharding: x264 calibrated once for all shards: %u fps/core", base.sw_fps_per_core);
+  }
+
+  s_count = base.shards;
+  LOG_INF("Sharding: %u shards x %u streams (front control on %u)", s_count, base.batch, base.ctrl_port);
+  s_loop = g_main_loop_new(NULL, FALSE);
+  for (guint i = 0; i < s_count; ++i) {
+    shard_plan(&base, i, &s_children[i].plan);
+    spawn_shard(GUINT_TO_POINTER(i));
+  }
+  g_unix_signal_add(SIGINT, on_front_signal, NULL);
+  g_unix_signal_add(SIGTERM, on_front_signal, NULL);
+
+  (void)g_thread_new("shard_poll", poll_thread, NULL);
+  control_use_front_routes();
+  (void)g_thread_new("ctrl_http", control_http_thread, NULL);
+
+  g_main_loop_run(s_loop);
+  g_main_loop_unref(s_loop);
+  return 0;
+}
+
+guint shard_front_count(void) { return s_count; }
+
+gint shard_front_pick(void) {
+  ShardLoad loads[SHARD_MAX];
+  g_mutex_lock(&s_lock);
+  for (guint i = 0; i < s_count; ++i) loads[i] = s_children[i].load;
+  gint s = shard_pick(loads, s_count);
+  // Count the add now so back-to-back adds spread out before the next poll corrects it.
+  if (s >= 0) s_children[s].load.active++;
+  g_mutex_unlock(&s_lock);
+  return s;
+}
+
+static guint forward_timeout_s(const gchar *target) {
+  return g_str_has_prefix(target, "/add_demo_stream") || g_str_has_prefix(target, "/add_streams")
+    ? SHARD_ADD_TIMEOUT_S : SHARD_FORWARD_TIMEOUT_S;
+}
+
+gboolean shard_front_forward(guint s, const gchar *method, const gchar *target, const gchar *body,
+                             gchar **status, gchar **resp_body, guint *retry_after) {
+  if (s >= s_count) return FALSE;
+  return shard_http(s_children[s].plan.ctrl_port, method, target, body, forward_timeout_s(target), status, resp_body, retry_after, NULL, NULL);
+}
+
+gboolean shard_front_fetch(guint s, const gchar *target, gchar **status, gchar **ctype, gchar **resp_body, gsize *resp_len) {
+  if (s >= s_count) return FALSE;
+  return shard_http(s_children[s].plan.ctrl_port, "GET", target, NULL, SHARD_FORWARD_TIMEOUT_S, status, resp_body, NULL, resp_len, ctype);
+}
+
+gchar *shard_front_status_json(void) {
+  GString *j = g_string_new("{\n  \"shards\": [\n");
+  g_mutex_lock(&s_lock);
+  for (guint i = 0; i < s_count; ++i) {
+    const ShardChild *c = &s_children[i];
+    g_string_append_printf(j,
+      "    { \"shard\": %u, \"pid\": %d, \"alive\": %s, \"active\": %u, \"max\": %u, \"restarts\": %u,"
+      " \"rtsp_port\": %u, \"ctrl_port\": %u, \"base_udp_port\": %u }%s\n",
+      i, c->pid, c->load.alive ? "true" : "false", c->load.active, c->load.capacity, c->restarts,
+      c->plan.rtsp_port, c->plan.ctrl_port, c->plan.base_udp_port, i + 1 < s_count ? "," : "");
+  }
+  g_mutex_unlock(&s_lock);
+  g_string_append(j, "  ]\n}\n");
+  return g_string_free(j, FALSE);
+}
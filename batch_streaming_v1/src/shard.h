@@ -0,0 +1,66 @@
+// Multi-process sharding: a front process runs K pipeline shards as child processes
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <glib.h>
+#include "config.h"
+
+#define SHARD_MAX 16
+
+// Front-side inputs the per-shard plans are cut from.
+typedef struct {
+  guint shards;         // K
+  guint batch;          // streams (and nvmultiurisrcbin batch) per shard
+  guint rtsp_port;      // shard i serves RTSP on rtsp_port + i
+  guint base_udp_port;  // shard i owns UDP [base + i*batch, base + (i+1)*batch)
+  guint ctrl_port;      // the front listens here; shard i on ctrl_port + 1 + i
+  guint rest_port;      // shard i's nvmultiurisrcbin REST server on rest_port + i
+  guint cpu_first;      // CPU_BUDGET_FIRST/CORES split evenly (cpu_cores 0 = no split)
+  guint cpu_cores;
+  guint hw_sessions;    // HW_THRESHOLD for the whole host, split across shards
+  gdouble admission_cores; // ADMISSION_CORES for the whole host, split across shards
+  guint sw_fps_per_core; // x264 calibration done once by the front (0 = each shard calibrates)
+} ShardBase;
+
+typedef struct {
+  guint rtsp_port, base_udp_port, ctrl_port, rest_port, max_streams;
+  guint cpu_first, cpu_cores; // cpu_cores 0 = inherit the front's environment
+  guint hw_threshold;         // this shard's NVENC sessions
+  gdouble admission_cores;    // this shard's share of the software-encoder cores
+  guint sw_fps_per_core;      // 0 = calibrate in the shard
+} ShardPlan;
+
+typedef struct {
+  gboolean alive;  // last /status poll answered
+  guint active;    // streams in use
+  guint capacity;  // "max" from its /status
+} ShardLoad;
+
+// Pure: ports, batch, CPU slice and encoder budget (NVENC sessions, admission cores) for shard i.
+void shard_plan(const ShardBase *base, guint i, ShardPlan *out);
+// Pure: live shard with a free slot and the lowest fill ratio (ties: lowest index); -1 if none.
+gint shard_pick(const ShardLoad *loads, guint n);
+
+// SHARDS > 1 and this process is not itself a shard (SHARD_INDEX unset).
+gboolean shard_front_enabled(void);
+// Spawns the shards (respawning any that exit), polls their load and serves the
+// front control API. Returns the process exit code.
+int shard_front_run(const AppConfig *cfg);
+
+// Front control API helpers (control.c routes call these).
+guint shard_front_count(void);
+// shard_pick over the last polled loads; the picked shard's active count is bumped
+// until the next poll.
+gint shard_front_pick(void);
+// Forwards one request to shard s's control API. *status is the child's status line
+// (e.g. "200 OK"), *retry_after its Retry-After value or 0. FALSE if it did not answer
+// (adds get 60 s, anything else 10 s).
+gboolean shard_front_forward(guint s, const gchar *method, const gchar *target, const gchar *body,
+                             gchar **status, gchar **resp_body, guint *retry_after);
+// Binary-safe GET (e.g. snapshots): body as received plus its length and content type.
+gboolean shard_front_fetch(guint s, const gchar *target, gchar **status, gchar **ctype, gchar **resp_body, gsize *resp_len);
+// Re-polls shard s now (after an add/remove) instead of waiting for the next tick.
+void shard_front_refresh(guint s);
+gchar *shard_front_status_json(void);
+
+#endif // SHARD_H
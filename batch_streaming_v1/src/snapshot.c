@@ -0,0 +1,275 @@
+// Keyframe snapshots (L2)
+// - A probe on each branch tee sink pad collects the buffers of the newest keyframe
+//   access unit (non-delta buffers sharing one PTS, so au and nal alignment both work)
+//   and publishes it when the next delta frame arrives. Buffers are only reffed; the
+//   one scan (for SPS/PPS) is once per keyframe, memory by memory, and stops at the
+//   first slice, so the streaming thread never copies or walks the picture data.
+// - SPS/PPS are remembered from keyframes that carry them and prepended to ones that
+//   do not (periodic IDRs in UDP mode), so every published unit decodes on its own.
+// - A request decodes that unit in a throwaway software pipeline (appsrc ! h264parse !
+//   avdec_h264 ! videoconvert ! jpegenc ! appsink). The JPEG is cached per stream and
+//   reused while it is younger than the TTL or the keyframe has not changed; the cache
+//   is bounded in bytes.
+#include <string.h>
+#include <gst/app/app.h>
+#include "log.h"
+#include "config.h"
+#include "state.h"
+#include "snapshot.h"
+
+typedef struct {
+  // Streaming thread only
+  GstBuffer *cur;          // keyframe unit being collected
+  GstClockTime cur_pts;
+  GBytes *params;          // last SPS/PPS seen (start codes included)
+  // Under lock
+  GMutex lock;
+  GstBuffer *key;          // newest complete keyframe unit
+  gint64 key_us;
+  guint64 key_seq;
+  // Under s_cache_lock
+  GBytes *jpeg;
+  gint64 jpeg_us;
+  guint64 jpeg_seq;
+} SnapSlot;
+
+static SnapSlot s_slots[G_N_ELEMENTS(g_streams)];
+static GMutex s_cache_lock;
+static gsize s_cache_bytes = 0;
+static gsize s_cache_max = 8192 * 1024;
+static gint64 s_ttl_us = 1000 * 1000;
+static guint s_quality = 85;
+static guint64 s_timeout_ns = 2 * GST_SECOND;
+static const gchar *s_decoder = NULL;
+
+static gboolean have_factory(const char *name) {
+  GstElementFactory *f = gst_element_factory_find(name);
+  if (f) { gst_object_unref(f); return TRUE; }
+  return FALSE;
+}
+
+void snapshot_init(void) {
+  s_ttl_us = (gint64) config_env_uint("SNAPSHOT_TTL_MS", 1000) * 1000;
+  s_cache_max = (gsize) MAX(64, config_env_uint("SNAPSHOT_CACHE_KB", 8192)) * 1024;
+  s_quality = CLAMP(config_env_uint("SNAPSHOT_QUALITY", 85), 1, 100);
+  s_timeout_ns = (guint64) MAX(100, config_env_uint("SNAPSHOT_TIMEOUT_MS", 2000)) * GST_MSECOND;
+  for (guint i = 0; i < G_N_ELEMENTS(s_slots); ++i) g_mutex_init(&s_slots[i].lock);
+  const gchar *decoders[] = { "avdec_h264", "openh264dec" };
+  for (guint i = 0; i < G_N_ELEMENTS(decoders) && !s_decoder; ++i) if (have_factory(decoders[i])) s_decoder = decoders[i];
+  if (!s_decoder || !have_factory("jpegenc")) {
+    LOG_WRN("Snapshots unavailable: need avdec_h264|openh264dec and jpegenc");
+    s_decoder = NULL;
+    return;
+  }
+  LOG_INF("Snapshots: %s, TTL %" G_GINT64_FORMAT "ms, cache %zuKB, quality %u", s_decoder, s_ttl_us / 1000, s_cache_max / 1024, s_quality);
+}
+
+// --- Keyframe capture (streaming thread)
+static gsize next_nal(const guint8 *d, gsize n, gsize from) {
+  for (gsize i = from; i + 3 <= n; ++i) if (d[i] == 0 && d[i + 1] == 0 && d[i + 2] == 1) return i + 3;
+  return n;
+}
+
+// Appends the SPS/PPS units of one byte-stream chunk to *ps. TRUE once the first
+// slice is reached (nothing after it can be a parameter set of this unit).
+static gboolean chunk_parameter_sets(const guint8 *d, gsize n, GByteArray **ps) {
+  for (gsize p = next_nal(d, n, 0); p < n; ) {
+    guint type = d[p] & 0x1f;
+    if (type == 1 || type == 5) return TRUE;
+    gsize q = next_nal(d, n, p);
+    gsize end = q < n ? q - 3 : n;
+    while (q < n && end > p && d[end - 1] == 0) end--; // leading zero of a 4-byte start code
+    if (type == 7 || type == 8) {
+      if (!*ps) *ps = g_byte_array_new();
+      g_byte_array_append(*ps, (const guint8*)"\0\0\0\1", 4);
+      g_byte_array_append(*ps, d + p, (guint)(end - p));
+    }
+    p = q;
+  }
+  return FALSE;
+}
+
+// SPS/PPS units ahead of the first slice of an access unit; NULL if none. Memories
+// are mapped one at a time (one per NAL with nal alignment): mapping the whole
+// appended buffer would merge them into a copy of the keyframe.
+static GBytes *au_parameter_sets(GstBuffer *au) {
+  GByteArray *ps = NULL;
+  gboolean slice = FALSE;
+  for (guint i = 0; i < gst_buffer_n_memory(au) && !slice; ++i) {
+    GstMemory *mem = gst_buffer_peek_memory(au, i);
+    GstMapInfo map;
+    if (!gst_memory_map(mem, &map, GST_MAP_READ)) break;
+    slice = chunk_parameter_sets(map.data, map.size, &ps);
+    gst_memory_unmap(mem, &map);
+  }
+  return ps ? g_byte_array_free_to_bytes(ps) : NULL;
+}
+
+static void publish_keyframe(SnapSlot *s) {
+  GstBuffer *au = s->cur;
+  s->cur = NULL;
+  GBytes *ps = au_parameter_sets(au);
+  if (ps) {
+    if (s->params) g_bytes_unref(s->params);
+    s->params = ps;
+  } else if (s->params) {
+    GstBuffer *hdr = gst_buffer_new_wrapped_bytes(g_bytes_ref(s->params));
+    au = gst_buffer_append(hdr, au);
+  } else {
+    gst_buffer_unref(au); // undecodable until a keyframe brings SPS/PPS
+    return;
+  }
+  g_mutex_lock(&s->lock);
+  if (s->key) gst_buffer_unref(s->key);
+  s->key = au;
+  s->key_us = g_get_monotonic_time();
+  s->key_seq++;
+  g_mutex_unlock(&s->lock);
+}
+
+static GstPadProbeReturn on_tee_in(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  SnapSlot *s = (SnapSlot*)user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (!buf) return GST_PAD_PROBE_OK;
+  if (GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    if (s->cur) publish_keyframe(s);
+    return GST_PAD_PROBE_OK;
+  }
+  if (s->cur && GST_BUFFER_PTS(buf) == s->cur_pts) {
+    s->cur = gst_buffer_append(s->cur, gst_buffer_ref(buf));
+  } else {
+    if (s->cur) publish_keyframe(s);
+    s->cur = gst_buffer_ref(buf);
+    s->cur_pts = GST_BUFFER_PTS(buf);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+void snapshot_branch_attach(guint index, GstElement *tee) {
+  if (index >= G_N_ELEMENTS(s_slots) || !s_decoder || !tee) return;
+  GstPad *pad = gst_element_get_static_pad(tee, "sink");
+  if (!pad) return;
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_tee_in, &s_slots[index], NULL);
+  gst_object_unref(pad);
+}
+
+static void cache_drop(SnapSlot *s) {
+  if (!s->jpeg) return;
+  s_cache_bytes -= g_bytes_get_size(s->jpeg);
+  g_bytes_unref(s->jpeg);
+  s->jpeg = NULL;
+}
+
+void snapshot_branch_detach(guint index) {
+  if (index >= G_N_ELEMENTS(s_slots)) return;
+  SnapSlot *s = &s_slots[index];
+  // The branch is in NULL: no streaming thread touches cur/params any more.
+  g_clear_pointer(&s->cur, gst_buffer_unref);
+  g_clear_pointer(&s->params, g_bytes_unref);
+  g_mutex_lock(&s->lock);
+  g_clear_pointer(&s->key, gst_buffer_unref);
+  g_mutex_unlock(&s->lock);
+  g_mutex_lock(&s_cache_lock);
+  cache_drop(s);
+  g_mutex_unlock(&s_cache_lock);
+}
+
+// --- Decode (request side)
+static GBytes *decode_to_jpeg(GstBuffer *au) {
+  gchar *desc = g_strdup_printf(
+    "appsrc name=src format=time caps=video/x-h264,stream-format=byte-stream,alignment=au "
+    "! h264parse ! %s ! videoconvert ! jpegenc quality=%u ! appsink name=sink sync=false", s_decoder, s_quality);
+  GError *err = NULL;
+  GstElement *pipe = gst_parse_launch(desc, &err);
+  g_free(desc);
+  if (err) {
+    LOG_ERR("Snapshot: pipeline: %s", err->message);
+    g_error_free(err);
+    if (pipe) gst_object_unref(pipe);
+    return NULL;
+  }
+  GstElement *src = gst_bin_get_by_name(GST_BIN(pipe), "src");
+  GstElement *sink = gst_bin_get_by_name(GST_BIN(pipe), "sink");
+  gst_element_set_state(pipe, GST_STATE_PLAYING);
+  // Own timestamps: the live running time means nothing here.
+  GstBuffer *b = gst_buffer_copy(au);
+  GST_BUFFER_PTS(b) = 0;
+  GST_BUFFER_DTS(b) = GST_CLOCK_TIME_NONE;
+  gst_app_src_push_buffer(GST_APP_SRC(src), b);
+  gst_app_src_end_of_stream(GST_APP_SRC(src));
+
+  GBytes *jpeg = NULL;
+  GstSample *sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink), s_timeout_ns);
+  GstBuffer *out = sample ? gst_sample_get_buffer(sample) : NULL;
+  GstMapInfo map;
+  if (out && gst_buffer_map(out, &map, GST_MAP_READ)) {
+    jpeg = g_bytes_new(map.data, map.size);
+    gst_buffer_unmap(out, &map);
+  }
+  if (sample) gst_sample_unref(sample);
+  gst_element_set_state(pipe, GST_STATE_NULL);
+  gst_object_unref(src); gst_object_unref(sink); gst_object_unref(pipe);
+  return jpeg;
+}
+
+// Caller holds s_cache_lock. Evicts the oldest JPEGs until `incoming` more bytes fit.
+static void cache_make_room(gsize incoming) {
+  while (s_cache_bytes + incoming > s_cache_max) {
+    SnapSlot *oldest = NULL;
+    for (guint i = 0; i < G_N_ELEMENTS(s_slots); ++i) {
+      if (s_slots[i].jpeg && (!oldest || s_slots[i].jpeg_us < oldest->jpeg_us)) oldest = &s_slots[i];
+    }
+    if (!oldest) return;
+    cache_drop(oldest);
+  }
+}
+
+SnapshotResult snapshot_get(guint index, GBytes **jpeg, guint *age_ms, gboolean *cached) {
+  if (index >= G_N_ELEMENTS(s_slots)) return SNAPSHOT_NO_STREAM;
+  g_mutex_lock(&g_state_lock);
+  gboolean in_use = g_streams[index].in_use;
+  g_mutex_unlock(&g_state_lock);
+  if (!in_use) return SNAPSHOT_NO_STREAM;
+  if (!s_decoder) return SNAPSHOT_FAILED;
+
+  SnapSlot *s = &s_slots[index];
+  g_mutex_lock(&s->lock);
+  GstBuffer *key = s->key ? gst_buffer_ref(s->key) : NULL;
+  gint64 key_us = s->key_us;
+  guint64 seq = s->key_seq;
+  g_mutex_unlock(&s->lock);
+  if (!key) return SNAPSHOT_NO_KEYFRAME;
+  gint64 now = g_get_monotonic_time();
+  *age_ms = (guint)((now - key_us) / 1000);
+
+  g_mutex_lock(&s_cache_lock);
+  if (s->jpeg && (s->jpeg_seq == seq || now - s->jpeg_us < s_ttl_us)) {
+    *jpeg = g_bytes_ref(s->jpeg);
+    *cached = TRUE;
+    g_mutex_unlock(&s_cache_lock);
+    gst_buffer_unref(key);
+    return SNAPSHOT_OK;
+  }
+  g_mutex_unlock(&s_cache_lock);
+
+  GBytes *fresh = decode_to_jpeg(key);
+  gst_buffer_unref(key);
+  if (!fresh) {
+    LOG_WRN("Snapshot /s%u: keyframe decode failed", index);
+    return SNAPSHOT_FAILED;
+  }
+  g_mutex_lock(&s_cache_lock);
+  cache_drop(s);
+  if (g_bytes_get_size(fresh) <= s_cache_max) {
+    cache_make_room(g_bytes_get_size(fresh));
+    s->jpeg = g_bytes_ref(fresh);
+    s->jpeg_us = now;
+    s->jpeg_seq = seq;
+    s_cache_bytes += g_bytes_get_size(fresh);
+  }
+  g_mutex_unlock(&s_cache_lock);
+  *jpeg = fresh;
+  *cached = FALSE;
+  return SNAPSHOT_OK;
+}
@@ -0,0 +1,31 @@
+// Per-stream JPEG snapshots decoded on demand from the branch's last encoded keyframe
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <gst/gst.h>
+
+typedef enum {
+  SNAPSHOT_OK = 0,
+  SNAPSHOT_NO_STREAM,    // slot not in use
+  SNAPSHOT_NO_KEYFRAME,  // nothing encoded yet (e.g. a lazy branch that never had a viewer)
+  SNAPSHOT_FAILED,
+} SnapshotResult;
+
+// SNAPSHOT_TTL_MS (1000): how long a JPEG is served before a newer keyframe replaces it;
+// SNAPSHOT_CACHE_KB (8192): JPEG cache bound, oldest evicted first; SNAPSHOT_QUALITY (85);
+// SNAPSHOT_TIMEOUT_MS (2000): decode deadline; SNAPSHOT_THREADS (2, read by control.c):
+// decodes that may run at once, apart from the worker that adds and removes streams.
+void snapshot_init(void);
+
+// Keeps a ref to the newest keyframe access unit passing the branch tee (one per
+// branch; the probe never holds or alters the buffers).
+void snapshot_branch_attach(guint index, GstElement *tee);
+// After the branch elements are in NULL: drop the keyframe and cached JPEG.
+void snapshot_branch_detach(guint index);
+
+// JPEG for stream index (cached or decoded now, in software, off the live path).
+// Safe to call from several threads at once.
+// *age_ms is how old the keyframe is; *cached whether the JPEG came from the cache.
+SnapshotResult snapshot_get(guint index, GBytes **jpeg, guint *age_ms, gboolean *cached);
+
+#endif // SNAPSHOT_H
@@ -6,13 +6,26 @@
 #include <gst/rtsp-server/rtsp-server.h>
 #include <glib.h>
 
+// Encoder settings a branch runs with (changed live through /streams/{index}/config)
+typedef struct {
+  guint bitrate_kbps;  // before the overload ladder scales it
+  guint gop;           // keyframe interval, frames
+  guint fps;           // output frame-rate cap via the branch videorate, 0 = source rate
+  char preset[16];     // x264 speed-preset
+} EncoderConfig;
+
 typedef struct {
   gboolean in_use;
   gboolean enc_is_hw;
   char enc_kind[16]; // nvenc, x264, avenc, openh264
+  EncoderConfig enc_cfg;
   guint udp_port;
   char path[16];     // /sN
+  gchar *uri;        // source registered with nvmultiurisrcbin (owned)
   GstElement *queue;
+  GstElement *slow;  // BACKEND=cpu SLOW_BRANCH test stall (NULL otherwise)
+  GstElement *valve; // closed while the mount has no viewers (NULL when lazy encoding is off)
+  GstElement *rate;  // drop-only videorate: fps cap from enc_cfg and the degrade ladder
   GstElement *conv_pre;
   GstElement *caps_pre;
   GstElement *osd;
@@ -22,8 +35,9 @@ typedef struct {
   GstElement *caps_cpu;
   GstElement *enc;
   GstElement *parse;
-  GstElement *pay;
-  GstElement *udp;
+  GstElement *tee;   // after parse: live egress plus optional recording taps (record.c)
+  GstElement *pay;   // NULL in appsrc hand-off mode (the RTSP media payloads)
+  GstElement *sink;  // udpsink, or appsink in appsrc hand-off mode
 } StreamInfo;
 
 extern GstPipeline *g_pipeline;
@@ -31,13 +45,14 @@ extern GstElement  *g_pre_bin;
 extern GstElement  *g_demux;
 extern GstRTSPServer *g_rtsp_server;
 extern guint g_rtsp_port;
-extern guint g_next_index;
 extern guint g_base_udp_port_glb;
+extern gboolean g_handoff_appsrc; // branches feed RTSP media in-process (no UDP loopback)
+extern gboolean g_backend_cpu;    // no GPU: test-pattern front end, system-memory branches, no REST
+extern gboolean g_rest_mock;      // CPU backend still sends camera REST calls (mock server timing)
 extern GMutex g_state_lock;
 extern guint g_ctrl_port;
 extern const gchar *g_public_host;
-extern guint g_hw_threshold;  // NVENC for first N
-extern guint g_sw_max;        // SW encoder count
+extern guint g_hw_threshold;  // NVENC session cap (software admission is measured)
 extern guint g_max_streams;   // total allowed
 extern StreamInfo g_streams[64];
 
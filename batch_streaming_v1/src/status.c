@@ -0,0 +1,72 @@
+// Status snapshot (L2)
+// - Publisher (under g_state_lock): render the JSON once per change, swap it in with
+//   a new generation, retire the old one.
+// - Reader: one hazard pointer. A retired snapshot is freed on a later publish once
+//   the reader no longer points at it, so a poll never waits on the stream table.
+// - Each snapshot also carries the active (index, encoder) table, so /metrics
+//   renders from it instead of walking g_streams[] without the lock.
+#include <string.h>
+#include "state.h"
+#include "status.h"
+
+static StatusSnapshot *s_current = NULL; // atomic
+static StatusSnapshot *s_hazard = NULL;  // atomic; set while the reader copies
+static GPtrArray *s_retired = NULL;      // publisher only
+static guint64 s_generation = 0;         // publisher only
+
+G_STATIC_ASSERT(G_N_ELEMENTS(g_streams) == STATUS_MAX_STREAMS);
+
+static StatusSnapshot *render(guint64 gen) {
+  StatusStream table[STATUS_MAX_STREAMS];
+  guint n = 0;
+  GString *j = g_string_new(NULL);
+  g_string_append_printf(j, "{\n  \"generation\": %" G_GUINT64_FORMAT ",\n  \"max\": %u,\n  \"streams\": [\n", gen, g_max_streams);
+  gboolean first = TRUE;
+  for (guint i = 0; i < G_N_ELEMENTS(g_streams); ++i) {
+    if (!g_streams[i].in_use) continue;
+    if (!first) g_string_append(j, ",\n");
+    first = FALSE;
+    table[n].index = i;
+    g_strlcpy(table[n].encoder, g_streams[i].enc_kind[0] ? g_streams[i].enc_kind : "unknown", sizeof(table[n].encoder));
+    n++;
+    g_string_append_printf(j,
+      "    { \"index\": %u, \"path\": \"%s\", \"udp\": %u, \"encoder\": \"%s\" }",
+      i, g_streams[i].path, g_streams[i].udp_port, g_streams[i].enc_kind[0] ? g_streams[i].enc_kind : "unknown");
+  }
+  g_string_append(j, "\n  ]\n}\n");
+  StatusSnapshot *s = g_malloc(sizeof(StatusSnapshot) + j->len + 1);
+  s->generation = gen;
+  s->n_streams = n;
+  memcpy(s->streams, table, n * sizeof(StatusStream));
+  s->len = j->len;
+  memcpy(s->json, j->str, j->len + 1);
+  g_string_free(j, TRUE);
+  return s;
+}
+
+void status_publish(void) {
+  if (!s_retired) s_retired = g_ptr_array_new();
+  StatusSnapshot *next = render(++s_generation);
+  StatusSnapshot *old = g_atomic_pointer_exchange(&s_current, next);
+  if (old) g_ptr_array_add(s_retired, old);
+  StatusSnapshot *in_use = g_atomic_pointer_get(&s_hazard);
+  for (guint i = 0; i < s_retired->len; ) {
+    StatusSnapshot *r = g_ptr_array_index(s_retired, i);
+    if (r == in_use) { ++i; continue; }
+    g_free(r);
+    g_ptr_array_remove_index_fast(s_retired, i);
+  }
+}
+
+const StatusSnapshot *status_acquire(void) {
+  StatusSnapshot *s;
+  do {
+    s = g_atomic_pointer_get(&s_current);
+    g_atomic_pointer_set(&s_hazard, s);
+  } while (s != g_atomic_pointer_get(&s_current));
+  return s;
+}
+
+void status_release(void) {
+  g_atomic_pointer_set(&s_hazard, NULL);
+}
@@ -0,0 +1,32 @@
+// /status snapshot: immutable JSON republished whenever g_streams[] changes
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <glib.h>
+
+#define STATUS_MAX_STREAMS 64 // == G_N_ELEMENTS(g_streams)
+
+// Active branch as of the snapshot, for renderers that must not walk g_streams[].
+typedef struct {
+  guint index;
+  gchar encoder[16];
+} StatusStream;
+
+typedef struct {
+  guint64 generation;
+  guint n_streams;
+  StatusStream streams[STATUS_MAX_STREAMS];
+  gsize len;
+  gchar json[]; // rendered body, NUL-terminated
+} StatusSnapshot;
+
+// Re-render from g_streams[] and publish. Call with g_state_lock held after every
+// change to the stream table (single publisher).
+void status_publish(void);
+
+// Reader side (the control thread): no locks, no allocation. The snapshot stays
+// valid until status_release().
+const StatusSnapshot *status_acquire(void);
+void status_release(void);
+
+#endif // STATUS_H
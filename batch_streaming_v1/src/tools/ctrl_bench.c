@@ -0,0 +1,212 @@
+// Control API load generator (tool)
+// - N client threads, each on its own TCP connection to the control port, sending
+//   GET <path> back to back (HTTP/1.1 keep-alive; --close opens a connection per
+//   request instead).
+// - Per request: send -> last body byte. Prints one JSON document on stdout with
+//   requests/s and latency percentiles (logs go to stderr).
+//
+// Example (against a BACKEND=cpu server with 8 streams added):
+//   ctrl_bench --port 8080 --conns 64 --duration 10 > ctrl.json
+#include <glib.h>
+#include <json-glib/json-glib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "log.h"
+
+typedef struct {
+  guint id;
+  GThread *thread;
+  GArray *lat_us;   // gint64 per completed 2xx request
+  guint64 errors;   // non-2xx, short reads, connect failures
+  guint64 connects;
+} BenchConn;
+
+static gint s_port = 8080;
+static gint s_conns = 16;
+static gint s_duration_s = 10;
+static gchar *s_path = NULL;
+static gboolean s_close = FALSE;
+static gint64 s_deadline_us = 0;
+
+static GOptionEntry k_options[] = {
+  { "port", 'p', 0, G_OPTION_ARG_INT, &s_port, "Control port on 127.0.0.1 (default 8080)", "PORT" },
+  { "conns", 'c', 0, G_OPTION_ARG_INT, &s_conns, "Concurrent connections (default 16)", "N" },
+  { "duration", 'd', 0, G_OPTION_ARG_INT, &s_duration_s, "Seconds to run (default 10)", "S" },
+  { "path", 'u', 0, G_OPTION_ARG_STRING, &s_path, "Request target (default /status)", "PATH" },
+  { "close", 0, 0, G_OPTION_ARG_NONE, &s_close, "One connection per request (Connection: close)", NULL },
+  { NULL }
+};
+
+static int connect_ctrl(void) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)s_port) };
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) { close(fd); return -1; }
+  return fd;
+}
+
+static gboolean send_all(int fd, const gchar *data, gsize len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return FALSE;
+    data += n; len -= (gsize)n;
+  }
+  return TRUE;
+}
+
+// One response off fd (buf carries bytes read past the previous one). Returns the
+// status code, 0 on a short read or malformed header.
+static guint read_response(int fd, GString *buf, gboolean *server_close) {
+  char chunk[16384];
+  const gchar *hdr_end;
+  while (!(hdr_end = g_strstr_len(buf->str, (gssize)buf->len, "\r\n\r\n"))) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+    g_string_append_len(buf, chunk, n);
+  }
+  gsize hdr_len = (gsize)(hdr_end - buf->str) + 4;
+  guint status = buf->len > 12 ? (guint)g_ascii_strtoull(buf->str + 9, NULL, 10) : 0;
+  gchar *hdr = g_ascii_strdown(buf->str, (gssize)hdr_len);
+  const gchar *cl = strstr(hdr, "\r\ncontent-length:");
+  guint64 body_len = cl ? g_ascii_strtoull(cl + 17, NULL, 10) : 0;
+  *server_close = strstr(hdr, "\r\nconnection: close") != NULL;
+  g_free(hdr);
+  if (!cl || body_len > 64 * 1024 * 1024) return 0;
+  while (buf->len < hdr_len + body_len) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return 0;
+    g_string_append_len(buf, chunk, n);
+  }
+  g_string_erase(buf, 0, (gssize)(hdr_len + body_len));
+  return status;
+}
+
+static gpointer conn_run(gpointer data) {
+  BenchConn *c = (BenchConn*)data;
+  gchar *req = g_strdup_printf("GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n\r\n",
+                               s_path, s_close ? "close" : "keep-alive");
+  gsize req_len = strlen(req);
+  GString *buf = g_string_sized_new(16384);
+  int fd = -1;
+  while (g_get_monotonic_time() < s_deadline_us) {
+    if (fd < 0) {
+      fd = connect_ctrl();
+      if (fd < 0) { c->errors++; g_usleep(10000); continue; }
+      c->connects++;
+      g_string_truncate(buf, 0);
+    }
+    gint64 t0 = g_get_monotonic_time();
+    gboolean server_close = FALSE;
+    guint status = send_all(fd, req, req_len) ? read_response(fd, buf, &server_close) : 0;
+    gint64 us = g_get_monotonic_time() - t0;
+    if (status >= 200 && status < 300) g_array_append_val(c->lat_us, us);
+    else c->errors++;
+    if (status == 0 || server_close || s_close) { close(fd); fd = -1; }
+  }
+  if (fd >= 0) close(fd);
+  g_string_free(buf, TRUE);
+  g_free(req);
+  return NULL;
+}
+
+static gint cmp_gint64(gconstpointer a, gconstpointer b) {
+  gint64 x = *(const gint64*)a, y = *(const gint64*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static gdouble percentile_ms(const GArray *sorted, gdouble p) {
+  if (sorted->len == 0) return 0.0;
+  guint i = (guint) MIN((gdouble)(sorted->len - 1), floor(p * (sorted->len - 1) + 0.5));
+  return g_array_index(sorted, gint64, i) / 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+  GError *err = NULL;
+  GOptionContext *ctx = g_option_context_new("- control API requests/s and latency benchmark");
+  g_option_context_add_main_entries(ctx, k_options, NULL);
+  if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+    LOG_ERR("%s", err->message);
+    g_error_free(err); g_option_context_free(ctx);
+    return 1;
+  }
+  g_option_context_free(ctx);
+  if (!s_path) s_path = g_strdup("/status");
+  guint n = (guint) CLAMP(s_conns, 1, 4096);
+
+  g_printerr("ctrl_bench: %u connection(s) to 127.0.0.1:%d%s for %ds (%s)\n", n, s_port, s_path, s_duration_s,
+             s_close ? "close" : "keep-alive");
+  s_deadline_us = g_get_monotonic_time() + (gint64) MAX(1, s_duration_s) * G_USEC_PER_SEC;
+  gint64 t_start = g_get_monotonic_time();
+  BenchConn *conns = g_new0(BenchConn, n);
+  for (guint i = 0; i < n; ++i) {
+    conns[i].id = i;
+    conns[i].lat_us = g_array_new(FALSE, FALSE, sizeof(gint64));
+    conns[i].thread = g_thread_new("ctrl_bench", conn_run, &conns[i]);
+  }
+  GArray *all = g_array_new(FALSE, FALSE, sizeof(gint64));
+  guint64 errors = 0, connects = 0;
+  for (guint i = 0; i < n; ++i) {
+    g_thread_join(conns[i].thread);
+    g_array_append_vals(all, conns[i].lat_us->data, conns[i].lat_us->len);
+    errors += conns[i].errors;
+    connects += conns[i].connects;
+    g_array_free(conns[i].lat_us, TRUE);
+  }
+  gdouble elapsed_s = (g_get_monotonic_time() - t_start) / 1e6;
+  g_array_sort(all, cmp_gint64);
+
+  JsonBuilder *b = json_builder_new();
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "config");
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "port"); json_builder_add_int_value(b, s_port);
+  json_builder_set_member_name(b, "path"); json_builder_add_string_value(b, s_path);
+  json_builder_set_member_name(b, "conns"); json_builder_add_int_value(b, n);
+  json_builder_set_member_name(b, "duration_s"); json_builder_add_int_value(b, s_duration_s);
+  json_builder_set_member_name(b, "keep_alive"); json_builder_add_boolean_value(b, !s_close);
+  json_builder_end_object(b);
+  json_builder_set_member_name(b, "summary");
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "requests"); json_builder_add_int_value(b, all->len);
+  json_builder_set_member_name(b, "errors"); json_builder_add_int_value(b, (gint64)errors);
+  json_builder_set_member_name(b, "connects"); json_builder_add_int_value(b, (gint64)connects);
+  json_builder_set_member_name(b, "rps"); json_builder_add_double_value(b, elapsed_s > 0 ? all->len / elapsed_s : 0.0);
+  json_builder_set_member_name(b, "latency_ms");
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "p50"); json_builder_add_double_value(b, percentile_ms(all, 0.50));
+  json_builder_set_member_name(b, "p90"); json_builder_add_double_value(b, percentile_ms(all, 0.90));
+  json_builder_set_member_name(b, "p99"); json_builder_add_double_value(b, percentile_ms(all, 0.99));
+  json_builder_set_member_name(b, "max"); json_builder_add_double_value(b, percentile_ms(all, 1.0));
+  json_builder_end_object(b);
+  json_builder_end_object(b);
+  json_builder_end_object(b);
+
+  JsonGenerator *gen = json_generator_new();
+  json_generator_set_pretty(gen, TRUE);
+  JsonNode *root = json_builder_get_root(b);
+  json_generator_set_root(gen, root);
+  gchar *text = json_generator_to_data(gen, NULL);
+  g_print("%s\n", text);
+  g_free(text);
+  json_node_free(root);
+  g_object_unref(gen);
+  g_object_unref(b);
+
+  gboolean ok = all->len > 0;
+  g_array_free(all, TRUE);
+  g_free(conns);
+  g_free(s_path);
+  return ok ? 0 : 2;
+}
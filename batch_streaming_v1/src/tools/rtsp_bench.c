@@ -0,0 +1,396 @@
+// RTSP load generator / viewer-side latency benchmark (tool)
+// - Opens N RTSP clients (rtspsrc ! rtph264depay ! fakesink) against /sN mounts,
+//   all in one process on one main loop.
+// - Per client: DESCRIBE round trip, time to first frame and to first keyframe (the
+//   first one a decoder can start from), inter-frame jitter after a
+//   warm-up window, RTP loss from the jitterbuffer stats, achieved fps, and the
+//   wall-clock arrival of every keyframe (to check GOP changes against a script).
+// - --ramp-ms spreads client starts over a window (a connect storm); the summary has
+//   setup latency percentiles across clients.
+// - Prints one JSON document on stdout (logs go to stderr).
+//
+// Example (against a BACKEND=cpu server with 8 streams added):
+//   rtsp_bench --mounts 0-7 --clients 32 --duration 30 > bench.json
+// Connect storm (bench_rtsp_threads.sh repeats it per server RTSP_THREADS setting):
+//   rtsp_bench --mounts 0-7 --clients 500 --ramp-ms 1000 --duration 15 --tcp > storm.json
+#include <gst/gst.h>
+#include <json-glib/json-glib.h>
+#include <math.h>
+#include <string.h>
+#include "log.h"
+
+typedef struct {
+  guint id;
+  gchar *mount;          // /sN
+  GstElement *pipe;
+  GMutex lock;           // streaming threads write below; main reads after the run
+  GstElement *jb;        // rtpjitterbuffer (reffed), for loss stats
+  gint64 t_start_us;
+  gint64 t_sdp_us;       // 0 until the DESCRIBE answer (on-sdp)
+  gint64 t_first_us;     // 0 until the first frame
+  gint64 t_key_us;       // 0 until the first keyframe (no DELTA_UNIT flag)
+  gint64 t_last_us;
+  guint64 frames;
+  GArray *intervals_us;  // inter-frame gaps after warm-up (gint64)
+  GArray *key_unix_ms;   // wall-clock keyframe arrivals (gint64), first KEYFRAME_LOG_MAX
+  gchar *error;
+} BenchClient;
+
+#define KEYFRAME_LOG_MAX 1024
+
+static gchar *s_base = NULL;
+static gchar *s_mounts = NULL;
+static gint s_clients = 0;
+static gint s_duration_s = 20;
+static gint s_warmup_s = 2;
+static gint s_latency_ms = 100;
+static gboolean s_tcp = FALSE;
+static gint s_ramp_ms = 0;
+static const gchar *s_url = NULL;
+static GMainLoop *s_loop = NULL;
+static gint s_stopped = 0;    // set before results are read: probes stop recording
+
+static GOptionEntry k_options[] = {
+  { "base", 'b', 0, G_OPTION_ARG_STRING, &s_base, "Server URL (default rtsp://127.0.0.1:8554)", "URL" },
+  { "mounts", 'm', 0, G_OPTION_ARG_STRING, &s_mounts, "Stream indices, e.g. 0-7 or 0,3,5 (default 0)", "LIST" },
+  { "clients", 'n', 0, G_OPTION_ARG_INT, &s_clients, "Concurrent clients, spread round-robin (default: one per mount)", "N" },
+  { "duration", 'd', 0, G_OPTION_ARG_INT, &s_duration_s, "Seconds to run (default 20)", "S" },
+  { "warmup", 'w', 0, G_OPTION_ARG_INT, &s_warmup_s, "Seconds after the first frame excluded from jitter (default 2)", "S" },
+  { "latency", 'l', 0, G_OPTION_ARG_INT, &s_latency_ms, "rtspsrc jitterbuffer latency in ms (default 100)", "MS" },
+  { "tcp", 't', 0, G_OPTION_ARG_NONE, &s_tcp, "RTP over TCP instead of UDP", NULL },
+  { "ramp-ms", 'r', 0, G_OPTION_ARG_INT, &s_ramp_ms, "Spread client starts evenly over this window (default 0: all at once)", "MS" },
+  { NULL }
+};
+
+// "0-3,7" -> [0,1,2,3,7]
+static GArray *parse_mounts(const gchar *spec) {
+  GArray *out = g_array_new(FALSE, FALSE, sizeof(guint));
+  gchar **parts = g_strsplit(spec, ",", -1);
+  for (guint i = 0; parts[i]; ++i) {
+    gchar *end = NULL;
+    guint64 a = g_ascii_strtoull(parts[i], &end, 10), b = a;
+    if (end == parts[i]) continue;
+    if (*end == '-') b = g_ascii_strtoull(end + 1, NULL, 10);
+    for (guint64 v = a; v <= b && v < 1024; ++v) { guint x = (guint)v; g_array_append_val(out, x); }
+  }
+  g_strfreev(parts);
+  return out;
+}
+
+static GstPadProbeReturn on_frame(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+  (void)pad;
+  BenchClient *c = (BenchClient*) user_data;
+  if (g_atomic_int_get(&s_stopped)) return GST_PAD_PROBE_OK;
+  gint64 now = g_get_monotonic_time();
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  g_mutex_lock(&c->lock);
+  if (buf && !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    if (c->t_key_us == 0) c->t_key_us = now;
+    if (c->key_unix_ms->len < KEYFRAME_LOG_MAX) { gint64 ms = g_get_real_time() / 1000; g_array_append_val(c->key_unix_ms, ms); }
+  }
+  if (c->t_first_us == 0) c->t_first_us = now;
+  else if (now - c->t_first_us >= (gint64)s_warmup_s * G_USEC_PER_SEC) {
+    gint64 gap = now - c->t_last_us;
+    g_array_append_val(c->intervals_us, gap);
+  }
+  c->t_last_us = now;
+  c->frames++;
+  g_mutex_unlock(&c->lock);
+  return GST_PAD_PROBE_OK;
+}
+
+static void on_new_jitterbuffer(GstElement *rtpbin, GstElement *jb, guint session, guint ssrc, gpointer user_data) {
+  (void)rtpbin; (void)session; (void)ssrc;
+  BenchClient *c = (BenchClient*) user_data;
+  g_mutex_lock(&c->lock);
+  if (!c->jb) c->jb = gst_object_ref(jb);
+  g_mutex_unlock(&c->lock);
+}
+
+static void on_new_manager(GstElement *src, GstElement *manager, gpointer user_data) {
+  (void)src;
+  g_signal_connect(manager, "new-jitterbuffer", G_CALLBACK(on_new_jitterbuffer), user_data);
+}
+
+static void on_sdp(GstElement *src, gpointer sdp, gpointer user_data) {
+  (void)src; (void)sdp;
+  BenchClient *c = (BenchClient*) user_data;
+  g_mutex_lock(&c->lock);
+  if (!c->t_sdp_us) c->t_sdp_us = g_get_monotonic_time();
+  g_mutex_unlock(&c->lock);
+}
+
+static void on_bus_message(GstBus *bus, GstMessage *msg, gpointer user_data) {
+  (void)bus;
+  BenchClient *c = (BenchClient*) user_data;
+  if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_ERROR && GST_MESSAGE_TYPE(msg) != GST_MESSAGE_EOS) return;
+  if (c->error) return;
+  if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS) {
+    c->error = g_strdup("eos");
+  } else {
+    GError *err = NULL;
+    gst_message_parse_error(msg, &err, NULL);
+    c->error = g_strdup(err ? err->message : "error");
+    if (err) g_error_free(err);
+  }
+  LOG_WRN("client %u (%s): %s", c->id, c->mount, c->error);
+}
+
+static gboolean client_start(BenchClient *c, const gchar *base) {
+  gchar *desc = g_strdup_printf(
+    "rtspsrc name=src location=%s%s latency=%d protocols=%s "
+    "! rtph264depay ! video/x-h264,stream-format=byte-stream,alignment=au ! fakesink name=sink sync=false",
+    base, c->mount, s_latency_ms, s_tcp ? "tcp" : "udp");
+  GError *err = NULL;
+  c->pipe = gst_parse_launch(desc, &err);
+  g_free(desc);
+  if (err) { c->error = g_strdup(err->message); g_error_free(err); return FALSE; }
+
+  GstElement *src = gst_bin_get_by_name(GST_BIN(c->pipe), "src");
+  g_signal_connect(src, "new-manager", G_CALLBACK(on_new_manager), c);
+  g_signal_connect(src, "on-sdp", G_CALLBACK(on_sdp), c);
+  gst_object_unref(src);
+  GstElement *sink = gst_bin_get_by_name(GST_BIN(c->pipe), "sink");
+  GstPad *pad = gst_element_get_static_pad(sink, "sink");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_frame, c, NULL);
+  gst_object_unref(pad);
+  gst_object_unref(sink);
+
+  GstBus *bus = gst_element_get_bus(c->pipe);
+  gst_bus_add_signal_watch(bus);
+  g_signal_connect(bus, "message", G_CALLBACK(on_bus_message), c);
+  gst_object_unref(bus);
+
+  c->t_start_us = g_get_monotonic_time();
+  gst_element_set_state(c->pipe, GST_STATE_PLAYING);
+  return TRUE;
+}
+
+static gboolean on_client_due(gpointer data) {
+  BenchClient *c = (BenchClient*) data;
+  if (!client_start(c, s_url)) LOG_WRN("client %u (%s): %s", c->id, c->mount, c->error);
+  return G_SOURCE_REMOVE;
+}
+
+static gint cmp_gint64(gconstpointer a, gconstpointer b) {
+  gint64 x = *(const gint64*)a, y = *(const gint64*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static gdouble percentile_ms(const GArray *sorted, gdouble p) {
+  if (sorted->len == 0) return 0.0;
+  guint i = (guint) MIN((gdouble)(sorted->len - 1), floor(p * (sorted->len - 1) + 0.5));
+  return g_array_index(sorted, gint64, i) / 1000.0;
+}
+
+// Loss from the jitterbuffer: packets pushed vs declared lost.
+static void read_loss(BenchClient *c, guint64 *pushed, guint64 *lost) {
+  *pushed = 0; *lost = 0;
+  g_mutex_lock(&c->lock);
+  GstElement *jb = c->jb ? gst_object_ref(c->jb) : NULL;
+  g_mutex_unlock(&c->lock);
+  if (!jb) return;
+  GstStructure *st = NULL;
+  g_object_get(jb, "stats", &st, NULL);
+  if (st) {
+    gst_structure_get_uint64(st, "num-pushed", pushed);
+    gst_structure_get_uint64(st, "num-lost", lost);
+    gst_structure_free(st);
+  }
+  gst_object_unref(jb);
+}
+
+typedef struct {
+  gdouble ttff_sum_ms, ttff_max_ms, ttkf_sum_ms, ttkf_max_ms, fps_sum, jitter_sum_ms, jitter_max_ms;
+  guint64 pushed, lost;
+  guint ok, key_ok;
+  GArray *describe_us, *ttff_us; // per-client setup latencies (gint64), for percentiles
+} BenchTotals;
+
+static void add_client_json(JsonBuilder *b, BenchClient *c, BenchTotals *t) {
+  // Wait out a probe that was already past the stop check.
+  g_mutex_lock(&c->lock);
+  g_mutex_unlock(&c->lock);
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "client"); json_builder_add_int_value(b, c->id);
+  json_builder_set_member_name(b, "mount"); json_builder_add_string_value(b, c->mount);
+  json_builder_set_member_name(b, "frames"); json_builder_add_int_value(b, (gint64)c->frames);
+
+  gdouble ttff_ms = c->t_first_us ? (c->t_first_us - c->t_start_us) / 1000.0 : -1.0;
+  json_builder_set_member_name(b, "ttff_ms");
+  if (ttff_ms >= 0) json_builder_add_double_value(b, ttff_ms); else json_builder_add_null_value(b);
+  gdouble ttkf_ms = c->t_key_us ? (c->t_key_us - c->t_start_us) / 1000.0 : -1.0;
+  json_builder_set_member_name(b, "ttkf_ms");
+  if (ttkf_ms >= 0) json_builder_add_double_value(b, ttkf_ms); else json_builder_add_null_value(b);
+  gdouble describe_ms = c->t_sdp_us ? (c->t_sdp_us - c->t_start_us) / 1000.0 : -1.0;
+  json_builder_set_member_name(b, "describe_ms");
+  if (describe_ms >= 0) json_builder_add_double_value(b, describe_ms); else json_builder_add_null_value(b);
+  json_builder_set_member_name(b, "keyframes_unix_ms");
+  json_builder_begin_array(b);
+  for (guint i = 0; i < c->key_unix_ms->len; ++i) json_builder_add_int_value(b, g_array_index(c->key_unix_ms, gint64, i));
+  json_builder_end_array(b);
+
+  gdouble span_s = c->t_first_us && c->t_last_us > c->t_first_us ? (c->t_last_us - c->t_first_us) / 1e6 : 0.0;
+  gdouble fps = span_s > 0 ? (c->frames - 1) / span_s : 0.0;
+  json_builder_set_member_name(b, "fps"); json_builder_add_double_value(b, fps);
+
+  GArray *iv = c->intervals_us;
+  gdouble mean = 0.0, var = 0.0;
+  for (guint i = 0; i < iv->len; ++i) mean += g_array_index(iv, gint64, i);
+  if (iv->len) mean /= iv->len;
+  for (guint i = 0; i < iv->len; ++i) { gdouble d = g_array_index(iv, gint64, i) - mean; var += d * d; }
+  if (iv->len > 1) var /= (iv->len - 1);
+  g_array_sort(iv, cmp_gint64);
+  gdouble stddev_ms = sqrt(var) / 1000.0;
+  json_builder_set_member_name(b, "interval_ms");
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "samples"); json_builder_add_int_value(b, iv->len);
+  json_builder_set_member_name(b, "mean"); json_builder_add_double_value(b, mean / 1000.0);
+  json_builder_set_member_name(b, "jitter"); json_builder_add_double_value(b, stddev_ms);
+  json_builder_set_member_name(b, "p50"); json_builder_add_double_value(b, percentile_ms(iv, 0.50));
+  json_builder_set_member_name(b, "p99"); json_builder_add_double_value(b, percentile_ms(iv, 0.99));
+  json_builder_set_member_name(b, "max"); json_builder_add_double_value(b, percentile_ms(iv, 1.0));
+  json_builder_end_object(b);
+
+  guint64 pushed = 0, lost = 0;
+  read_loss(c, &pushed, &lost);
+  json_builder_set_member_name(b, "packets");
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "received"); json_builder_add_int_value(b, (gint64)pushed);
+  json_builder_set_member_name(b, "lost"); json_builder_add_int_value(b, (gint64)lost);
+  json_builder_set_member_name(b, "loss_pct"); json_builder_add_double_value(b, pushed + lost ? 100.0 * lost / (gdouble)(pushed + lost) : 0.0);
+  json_builder_end_object(b);
+
+  json_builder_set_member_name(b, "error");
+  if (c->error) json_builder_add_string_value(b, c->error); else json_builder_add_null_value(b);
+  json_builder_end_object(b);
+
+  if (c->t_sdp_us) { gint64 us = c->t_sdp_us - c->t_start_us; g_array_append_val(t->describe_us, us); }
+  if (ttkf_ms >= 0) { t->key_ok++; t->ttkf_sum_ms += ttkf_ms; t->ttkf_max_ms = MAX(t->ttkf_max_ms, ttkf_ms); }
+  if (ttff_ms >= 0) {
+    gint64 us = c->t_first_us - c->t_start_us;
+    g_array_append_val(t->ttff_us, us);
+    t->ok++;
+    t->ttff_sum_ms += ttff_ms; t->ttff_max_ms = MAX(t->ttff_max_ms, ttff_ms);
+    t->fps_sum += fps;
+    t->jitter_sum_ms += stddev_ms; t->jitter_max_ms = MAX(t->jitter_max_ms, stddev_ms);
+  }
+  t->pushed += pushed; t->lost += lost;
+}
+
+static gboolean on_done(gpointer data) {
+  (void)data;
+  g_atomic_int_set(&s_stopped, 1);
+  g_main_loop_quit(s_loop);
+  return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char *argv[]) {
+  GError *err = NULL;
+  GOptionContext *ctx = g_option_context_new("- RTSP viewer-side load benchmark");
+  g_option_context_add_main_entries(ctx, k_options, NULL);
+  g_option_context_add_group(ctx, gst_init_get_option_group());
+  if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+    LOG_ERR("%s", err->message);
+    g_error_free(err); g_option_context_free(ctx);
+    return 1;
+  }
+  g_option_context_free(ctx);
+  const gchar *base = s_base ? s_base : "rtsp://127.0.0.1:8554";
+  s_url = base;
+  GArray *mounts = parse_mounts(s_mounts ? s_mounts : "0");
+  if (mounts->len == 0) { LOG_ERR("No mounts in --mounts"); return 1; }
+  guint n = s_clients > 0 ? (guint)s_clients : mounts->len;
+
+  s_loop = g_main_loop_new(NULL, FALSE);
+  BenchClient *clients = g_new0(BenchClient, n);
+  for (guint i = 0; i < n; ++i) {
+    BenchClient *c = &clients[i];
+    c->id = i;
+    c->mount = g_strdup_printf("/s%u", g_array_index(mounts, guint, i % mounts->len));
+    c->intervals_us = g_array_new(FALSE, FALSE, sizeof(gint64));
+    c->key_unix_ms = g_array_new(FALSE, FALSE, sizeof(gint64));
+    g_mutex_init(&c->lock);
+    guint due_ms = s_ramp_ms > 0 ? (guint)((guint64)s_ramp_ms * i / n) : 0;
+    if (due_ms == 0) on_client_due(c);
+    else g_timeout_add(due_ms, on_client_due, c);
+  }
+  g_printerr("rtsp_bench: %u client(s) on %u mount(s) of %s for %ds (ramp %dms)\n", n, mounts->len, base, s_duration_s, MAX(0, s_ramp_ms));
+  g_timeout_add_seconds((guint) MAX(1, s_duration_s), on_done, NULL);
+  g_main_loop_run(s_loop);
+
+  // Results are read before teardown so the jitterbuffer stats are still there.
+  BenchTotals t = { 0 };
+  t.describe_us = g_array_new(FALSE, FALSE, sizeof(gint64));
+  t.ttff_us = g_array_new(FALSE, FALSE, sizeof(gint64));
+  JsonBuilder *b = json_builder_new();
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "config");
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "base"); json_builder_add_string_value(b, base);
+  json_builder_set_member_name(b, "clients"); json_builder_add_int_value(b, n);
+  json_builder_set_member_name(b, "mounts"); json_builder_add_int_value(b, mounts->len);
+  json_builder_set_member_name(b, "duration_s"); json_builder_add_int_value(b, s_duration_s);
+  json_builder_set_member_name(b, "warmup_s"); json_builder_add_int_value(b, s_warmup_s);
+  json_builder_set_member_name(b, "latency_ms"); json_builder_add_int_value(b, s_latency_ms);
+  json_builder_set_member_name(b, "transport"); json_builder_add_string_value(b, s_tcp ? "tcp" : "udp");
+  json_builder_set_member_name(b, "ramp_ms"); json_builder_add_int_value(b, MAX(0, s_ramp_ms));
+  json_builder_end_object(b);
+  json_builder_set_member_name(b, "clients");
+  json_builder_begin_array(b);
+  for (guint i = 0; i < n; ++i) add_client_json(b, &clients[i], &t);
+  json_builder_end_array(b);
+  json_builder_set_member_name(b, "summary");
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "clients_ok"); json_builder_add_int_value(b, t.ok);
+  json_builder_set_member_name(b, "ttff_ms_avg"); json_builder_add_double_value(b, t.ok ? t.ttff_sum_ms / t.ok : 0.0);
+  json_builder_set_member_name(b, "ttff_ms_max"); json_builder_add_double_value(b, t.ttff_max_ms);
+  json_builder_set_member_name(b, "keyframe_ok"); json_builder_add_int_value(b, t.key_ok);
+  json_builder_set_member_name(b, "ttkf_ms_avg"); json_builder_add_double_value(b, t.key_ok ? t.ttkf_sum_ms / t.key_ok : 0.0);
+  json_builder_set_member_name(b, "ttkf_ms_max"); json_builder_add_double_value(b, t.ttkf_max_ms);
+  g_array_sort(t.describe_us, cmp_gint64);
+  g_array_sort(t.ttff_us, cmp_gint64);
+  json_builder_set_member_name(b, "setup_ms");
+  json_builder_begin_object(b);
+  json_builder_set_member_name(b, "describe_p50"); json_builder_add_double_value(b, percentile_ms(t.describe_us, 0.50));
+  json_builder_set_member_name(b, "describe_p95"); json_builder_add_double_value(b, percentile_ms(t.describe_us, 0.95));
+  json_builder_set_member_name(b, "describe_p99"); json_builder_add_double_value(b, percentile_ms(t.describe_us, 0.99));
+  json_builder_set_member_name(b, "ttff_p50"); json_builder_add_double_value(b, percentile_ms(t.ttff_us, 0.50));
+  json_builder_set_member_name(b, "ttff_p95"); json_builder_add_double_value(b, percentile_ms(t.ttff_us, 0.95));
+  json_builder_set_member_name(b, "ttff_p99"); json_builder_add_double_value(b, percentile_ms(t.ttff_us, 0.99));
+  json_builder_end_object(b);
+  json_builder_set_member_name(b, "fps_total"); json_builder_add_double_value(b, t.fps_sum);
+  json_builder_set_member_name(b, "jitter_ms_avg"); json_builder_add_double_value(b, t.ok ? t.jitter_sum_ms / t.ok : 0.0);
+  json_builder_set_member_name(b, "jitter_ms_max"); json_builder_add_double_value(b, t.jitter_max_ms);
+  json_builder_set_member_name(b, "loss_pct"); json_builder_add_double_value(b, t.pushed + t.lost ? 100.0 * t.lost / (gdouble)(t.pushed + t.lost) : 0.0);
+  json_builder_end_object(b);
+  json_builder_end_object(b);
+
+  JsonGenerator *gen = json_generator_new();
+  json_generator_set_pretty(gen, TRUE);
+  JsonNode *root = json_builder_get_root(b);
+  json_generator_set_root(gen, root);
+  gchar *text = json_generator_to_data(gen, NULL);
+  g_print("%s\n", text);
+  g_free(text);
+  json_node_free(root);
+  g_object_unref(gen);
+  g_object_unref(b);
+
+  guint ok = t.ok;
+  g_array_free(t.describe_us, TRUE);
+  g_array_free(t.ttff_us, TRUE);
+  for (guint i = 0; i < n; ++i) {
+    BenchClient *c = &clients[i];
+    if (c->pipe) { gst_element_set_state(c->pipe, GST_STATE_NULL); gst_object_unref(c->pipe); }
+    if (c->jb) gst_object_unref(c->jb);
+    g_mutex_clear(&c->lock);
+    g_array_free(c->intervals_us, TRUE);
+    g_array_free(c->key_unix_ms, TRUE);
+    g_free(c->mount); g_free(c->error);
+  }
+  g_free(clients);
+  g_array_free(mounts, TRUE);
+  g_main_loop_unref(s_loop);
+  return ok == n ? 0 : 2;
+}
@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Stream churn test: thousands of /add_streams + /remove_stream cycles against a
+# BACKEND=cpu server; RSS and open fds must stay flat once warmed up.
+# - Every WATCH_EVERY cycles a viewer is attached to the first stream of the batch
+#   while it is removed, so RTSP media teardown (and, with RTSP_HANDOFF=appsrc, the
+#   hand-off "unprepared" callback) races the slot being recycled.
+# Run inside the image (twice: UDP wrap and in-process hand-off):
+#   docker run --rm --network host batch_streaming:latest bash test_churn.sh
+#   docker run --rm --network host -e RTSP_HANDOFF=appsrc batch_streaming:latest bash test_churn.sh
+source "$(dirname "$0")/bench_lib.sh"
+CYCLES="${CYCLES:-2000}"
+BATCH="${BATCH:-4}"
+WARMUP="${WARMUP:-100}"
+WATCH_EVERY="${WATCH_EVERY:-50}"
+MAX_FD_GROWTH="${MAX_FD_GROWTH:-8}"
+MAX_RSS_GROWTH_KB="${MAX_RSS_GROWTH_KB:-32768}"
+
+server_start RTSP_HANDOFF="${RTSP_HANDOFF:-}"
+viewers=()
+
+cycle() {
+  local c="$1" json idx
+  json=$(add_streams "$BATCH")
+  idx=$(json_get "' '.join(str(s['index']) for s in d['streams'])" <<<"$json")
+  [[ -n "$idx" ]] || bench_fail "cycle $c: add returned no streams: $json"
+  if (( WATCH_EVERY > 0 && c % WATCH_EVERY == 0 )); then
+    local first=${idx%% *}
+    "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "$first" --duration 3 >/dev/null 2>&1 &
+    viewers+=($!)
+    sleep 1.5
+  fi
+  for i in $idx; do
+    [[ "$(ctrl_code "/remove_stream?index=$i")" == 200 ]] || bench_fail "cycle $c: remove $i failed"
+  done
+}
+
+wait_viewers() { (( ${#viewers[@]} == 0 )) || wait "${viewers[@]}" 2>/dev/null || true; viewers=(); }
+
+for c in $(seq 1 "$WARMUP"); do cycle "$c"; done
+wait_viewers
+rss0=$(proc_rss_kb "$SERVER_PID"); fds0=$(proc_fds "$SERVER_PID")
+bench_log "after $WARMUP warm-up cycles: rss ${rss0} kB, fds $fds0"
+
+t0=$(now_ms)
+for c in $(seq 1 "$CYCLES"); do
+  cycle "$c"
+  if (( c % 250 == 0 )); then bench_log "cycle $c: rss $(proc_rss_kb "$SERVER_PID") kB, fds $(proc_fds "$SERVER_PID")"; fi
+done
+wait_viewers
+sleep 2
+rss1=$(proc_rss_kb "$SERVER_PID"); fds1=$(proc_fds "$SERVER_PID")
+left=$(stream_count)
+echo "cycles=$CYCLES batch=$BATCH handoff=${RTSP_HANDOFF:-udp} elapsed_s=$(( ($(now_ms) - t0) / 1000 ))"
+echo "rss_kb: $rss0 -> $rss1 (+$(( rss1 - rss0 )))   fds: $fds0 -> $fds1 (+$(( fds1 - fds0 )))   streams left: $left"
+
+kill -0 "$SERVER_PID" 2>/dev/null || bench_fail "server died during churn"
+(( left == 0 )) || bench_fail "$left stream(s) left after churn"
+(( fds1 - fds0 <= MAX_FD_GROWTH )) || bench_fail "fd count grew by $(( fds1 - fds0 ))"
+(( rss1 - rss0 <= MAX_RSS_GROWTH_KB )) || bench_fail "RSS grew by $(( rss1 - rss0 )) kB"
+server_stop
+bench_pass "churn: $CYCLES cycles, memory and fds flat"
@@ -0,0 +1,60 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Live keyframe-interval change (BACKEND=cpu, x264): a POST to
+# /streams/0/config must take effect within one GOP.
+# - /s0 starts at OLD_GOP frames; one viewer logs the wall-clock time of every
+#   keyframe (rtsp_bench keyframes_unix_ms) across the whole run.
+# - Mid-run keyframe_interval is set to NEW_GOP (an encoder swap). The first
+#   keyframe after the POST must arrive within one NEW_GOP period (+SLACK_MS),
+#   and every later keyframe gap must stay within one NEW_GOP period (+SLACK_MS).
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash test_encoder_gop.sh
+source "$(dirname "$0")/bench_lib.sh"
+OLD_GOP="${OLD_GOP:-150}"
+NEW_GOP="${NEW_GOP:-30}"
+SLACK_MS="${SLACK_MS:-300}"
+
+set_gop() { ctrl_code /streams/0/config -X POST -H 'Content-Type: application/json' -d "{\"keyframe_interval\": $1}"; }
+
+server_start ADMISSION_SW_FPS_PER_CORE=100000 ADMISSION_RESERVE_PCT=0 LAZY_ENCODE=off KEYFRAME_ON_JOIN=off
+add_streams 1 >/dev/null
+[[ "$(stream_count)" == 1 ]] || bench_fail "stream not added"
+[[ "$(set_gop "$OLD_GOP")" == 200 ]] || bench_fail "config keyframe_interval=$OLD_GOP"
+fps=$(ctrl /streams/0/config | json_get "d['fps'] or 30")
+old_ms=$(( OLD_GOP * 1000 / fps )); new_ms=$(( NEW_GOP * 1000 / fps ))
+out="$BENCH_OUT/gop.json"
+"$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts 0 \
+  --duration $(( 3 * old_ms / 1000 + 8 )) >"$out" 2>/dev/null &
+viewer=$!
+sleep $(( 2 * old_ms / 1000 + 2 )) # at least two periodic keyframes at OLD_GOP
+t_post=$(now_ms)
+code=$(set_gop "$NEW_GOP")
+t_ack=$(now_ms)
+wait "$viewer" || true
+[[ "$code" == 200 ]] || bench_fail "config keyframe_interval=$NEW_GOP answered $code"
+server_stop
+
+python3 - "$out" "$t_post" "$old_ms" "$new_ms" "$SLACK_MS" "$(( t_ack - t_post ))" <<'PY' || bench_fail "GOP change did not take effect within one GOP (JSON in $out)"
+import json, sys
+d = json.load(open(sys.argv[1]))
+t_post, old_ms, new_ms, slack, ack = (int(v) for v in sys.argv[2:])
+keys = d["clients"][0]["keyframes_unix_ms"]
+before = [k for k in keys if k < t_post]
+after = [k for k in keys if k >= t_post]
+old_gaps = [b - a for a, b in zip(before, before[1:])]
+new_gaps = [b - a for a, b in zip(after, after[1:])]
+first = after[0] - t_post if after else None
+print("keyframe_interval old=%dms new=%dms  POST answered in %dms" % (old_ms, new_ms, ack))
+print("  gaps before: %s" % old_gaps)
+print("  first keyframe after POST: %s ms, gaps after: %s" % (first, new_gaps))
+ok = True
+if not old_gaps or max(old_gaps) < 2 * new_ms:
+    print("FAIL: no OLD_GOP-sized gap before the change (baseline not established)"); ok = False
+if first is None or first > new_ms + slack:
+    print("FAIL: first keyframe after the POST later than one new GOP"); ok = False
+if len(new_gaps) < 3 or max(new_gaps) > new_ms + slack:
+    print("FAIL: keyframe gaps after the change exceed one new GOP"); ok = False
+sys.exit(0 if ok else 1)
+PY
+bench_pass "keyframe_interval $OLD_GOP -> $NEW_GOP took effect within one GOP"
@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Branch isolation test (BACKEND=cpu): one branch with an artificially slow
+# "encoder" must not slow the others down.
+# - Baseline: STREAMS streams, one rtsp_bench viewer per mount, per-mount fps.
+# - Slow run: same, with SLOW_BRANCH=0:SLOW_MS (identity sleep-time in /s0's
+#   streaming thread). /s0 must fall well behind and its leaky queue must report
+#   drops; every other mount must keep its baseline fps within TOLERANCE_PCT.
+# Run inside the image:
+#   docker run --rm --network host batch_streaming:latest bash test_isolation.sh
+source "$(dirname "$0")/bench_lib.sh"
+STREAMS="${STREAMS:-4}"
+SLOW_MS="${SLOW_MS:-100}"
+DURATION="${DURATION:-20}"
+TOLERANCE_PCT="${TOLERANCE_PCT:-10}"
+
+run() { # label, extra server env...
+  local label="$1"; shift
+  server_start "$@" ADMISSION_SW_FPS_PER_CORE=100000 ADMISSION_RESERVE_PCT=0 DEGRADE=off
+  add_streams "$STREAMS" >/dev/null
+  [[ "$(stream_count)" == "$STREAMS" ]] || bench_fail "$label: only $(stream_count) of $STREAMS streams added"
+  "$RTSP_BENCH" --base "rtsp://127.0.0.1:$BENCH_RTSP_PORT" --mounts "0-$(( STREAMS - 1 ))" \
+    --duration "$DURATION" --warmup 3 >"$BENCH_OUT/iso_$label.json" 2>/dev/null || true
+  ctrl /metrics >"$BENCH_OUT/iso_$label.metrics"
+  server_stop
+}
+fps_of() { # label, mount index
+  json_get "[c.get('fps', 0) for c in d['clients'] if c['mount'] == '/s$2'][0]" <"$BENCH_OUT/iso_$1.json"
+}
+
+run base
+run slow SLOW_BRANCH="0:$SLOW_MS"
+
+fail=0
+for i in $(seq 0 $(( STREAMS - 1 ))); do
+  b=$(fps_of base "$i"); s=$(fps_of slow "$i")
+  echo "/s$i fps: baseline $b, with /s0 slow $s"
+  if (( i == 0 )); then
+    awk -v b="$b" -v s="$s" 'BEGIN { exit !(s < 0.7 * b) }' || { echo "FAIL: /s0 was not slowed down (stall not applied?)"; fail=1; }
+  else
+    awk -v b="$b" -v s="$s" -v t="$TOLERANCE_PCT" 'BEGIN { exit !(s >= b * (100 - t) / 100) }' || { echo "FAIL: /s$i lost more than $TOLERANCE_PCT% fps"; fail=1; }
+  fi
+done
+drops=$(awk '/^batch_stream_dropped_buffers_total\{stream="s0"/ { print $2 }' "$BENCH_OUT/iso_slow.metrics")
+echo "/s0 queue drops: ${drops:-none}"
+[[ "${drops:-0}" -gt 0 ]] || { echo "FAIL: /s0 queue reported no drops"; fail=1; }
+(( fail == 0 )) || bench_fail "slow branch affected the others (JSON in $BENCH_OUT)"
+bench_pass "slow /s0 (${SLOW_MS}ms/frame) left the other $(( STREAMS - 1 )) branches at baseline fps"
@@ -0,0 +1,106 @@
+// admission_decide: NVENC vs x264 vs 429, Retry-After, model and live-headroom edges
+// Model used throughout: 2 NVENC slots, x264 240 fps/core, 30 fps/stream (0.125
+// cores per stream, exact in binary), 4 cores with 25% reserved -> 24 SW streams.
+#include "unit.h"
+#include "admission.h"
+
+typedef struct {
+  const gchar *name;
+  AdmissionModel m;
+  AdmissionLoad load;
+  AdmitKind want;
+  guint want_retry_s;
+} AdmitCase;
+
+#define MODEL { 2, 240.0, 30.0, 4.0, 0.25 }
+#define NO_HW { 0, 240.0, 30.0, 4.0, 0.25 }
+#define HW_FULL 2
+
+static const AdmitCase k_cases[] = {
+  // NVENC first, whatever the CPU does.
+  { "hw free",                     MODEL, { 0, 0, 0.0, 0 },         ADMIT_HW, 0 },
+  { "last hw slot",                MODEL, { 1, 30, 1.0, 0 },        ADMIT_HW, 0 },
+  { "no nvenc -> sw",              NO_HW, { 0, 0, 0.0, 0 },         ADMIT_SW, 0 },
+  // Software: the cost model.
+  { "hw full, idle host",          MODEL, { HW_FULL, 0, 0.0, 0 },   ADMIT_SW, 0 },
+  { "model: 24th sw fits exactly", MODEL, { HW_FULL, 23, 0.0, 0 },  ADMIT_SW, 0 },
+  { "model: 25th sw is full",      MODEL, { HW_FULL, 24, 0.0, 0 },  ADMIT_REJECT, 30 },
+  { "model full beats busy",       MODEL, { HW_FULL, 24, 1.0, 0 },  ADMIT_REJECT, 30 },
+  { "uncalibrated",                { 2, 0.0, 30.0, 4.0, 0.25 }, { HW_FULL, 0, 0.0, 0 }, ADMIT_REJECT, 30 },
+  { "no cores",                    { 2, 240.0, 30.0, 0.0, 0.25 }, { HW_FULL, 0, 0.0, 0 }, ADMIT_REJECT, 30 },
+  // Software: live headroom (idle - cost must stay >= 1.0 reserved core).
+  { "live: idle - cost == reserve", MODEL, { HW_FULL, 0, 0.71875, 0 }, ADMIT_SW, 0 },
+  { "live: just short",            MODEL, { HW_FULL, 0, 0.75, 0 },  ADMIT_REJECT, 5 },
+  { "live: busy clamps at 1",      MODEL, { HW_FULL, 0, 1.5, 0 },   ADMIT_REJECT, 5 },
+  { "live: busy clamps at 0",      MODEL, { HW_FULL, 0, -0.5, 0 },  ADMIT_SW, 0 },
+  // Streams admitted since the CPU sample take their cost out of the idle CPU.
+  { "since sample: 7 of 8 fit",    MODEL, { HW_FULL, 7, 0.5, 7 },   ADMIT_SW, 0 },
+  { "since sample: 9th is short",  MODEL, { HW_FULL, 8, 0.5, 8 },   ADMIT_REJECT, 5 },
+  { "since sample ignored by hw",  MODEL, { 0, 8, 0.5, 8 },         ADMIT_HW, 0 },
+};
+
+static void test_decide_table(void) {
+  for (guint i = 0; i < G_N_ELEMENTS(k_cases); ++i) {
+    const AdmitCase *c = &k_cases[i];
+    AdmitDecision d = admission_decide(&c->m, &c->load);
+    if (d.kind != c->want || d.retry_after_s != c->want_retry_s)
+      g_error("case '%s': got kind %d retry %u, want kind %d retry %u", c->name, d.kind, d.retry_after_s, c->want, c->want_retry_s);
+  }
+}
+
+// n adds within one CPU sample window, the way admission_admit sees them whether
+// they come as one /add_streams batch or back-to-back /add_demo_stream calls: the
+// sample does not move, so only sw_since_sample stops them.
+static guint admit_within_sample(AdmissionLoad *load, guint n, gboolean track, guint *retry_after_s) {
+  AdmissionModel m = MODEL;
+  guint admitted = 0;
+  *retry_after_s = 0;
+  for (guint i = 0; i < n; ++i) {
+    AdmitDecision d = admission_decide(&m, load);
+    if (d.kind == ADMIT_REJECT) { *retry_after_s = MAX(*retry_after_s, d.retry_after_s); continue; }
+    load->sw_active++;
+    if (track) load->sw_since_sample++;
+    admitted++;
+  }
+  return admitted;
+}
+
+static void test_adds_within_sample(void) {
+  guint retry = 0;
+  // 2 idle cores, 1 reserved, 0.125 per stream: 8 fit.
+  AdmissionLoad load = { HW_FULL, 0, 0.5, 0 };
+  g_assert_cmpuint(admit_within_sample(&load, 32, TRUE, &retry), ==, 8);
+  g_assert_cmpuint(retry, ==, 5);
+  // Without the count the stale sample would let the model fill up (24).
+  load = (AdmissionLoad){ HW_FULL, 0, 0.5, 0 };
+  g_assert_cmpuint(admit_within_sample(&load, 32, FALSE, &retry), ==, 24);
+  g_assert_cmpuint(retry, ==, 30);
+  // Idle host: the model is the limit either way.
+  load = (AdmissionLoad){ HW_FULL, 0, 0.0, 0 };
+  g_assert_cmpuint(admit_within_sample(&load, 32, TRUE, &retry), ==, 24);
+  g_assert_cmpuint(retry, ==, 30);
+}
+
+// Single adds split across requests share the count until the next sample, which
+// then shows their cost in cpu_busy and resets it.
+static void test_sample_resets_count(void) {
+  guint retry = 0;
+  AdmissionLoad load = { HW_FULL, 0, 0.5, 0 };
+  for (guint i = 0; i < 4; ++i) g_assert_cmpuint(admit_within_sample(&load, 1, TRUE, &retry), ==, 1);
+  g_assert_cmpuint(admit_within_sample(&load, 8, TRUE, &retry), ==, 4);
+  g_assert_cmpuint(admit_within_sample(&load, 1, TRUE, &retry), ==, 0);
+  // Next sample: the 8 streams (1 core) are busy now, 1 idle core left = the reserve.
+  load.cpu_busy = 0.75;
+  load.sw_since_sample = 0;
+  g_assert_cmpuint(admit_within_sample(&load, 1, TRUE, &retry), ==, 0);
+  g_assert_cmpuint(retry, ==, 5);
+  // A sample that shows them lighter than modelled frees room again.
+  load.cpu_busy = 0.5;
+  g_assert_cmpuint(admit_within_sample(&load, 32, TRUE, &retry), ==, 8);
+}
+
+void test_admission_register(void) {
+  g_test_add_func("/admission/decide_table", test_decide_table);
+  g_test_add_func("/admission/adds_within_sample", test_adds_within_sample);
+  g_test_add_func("/admission/sample_resets_count", test_sample_resets_count);
+}
@@ -0,0 +1,113 @@
+// infer_ctl_step: trace-driven checks of the adaptive inference interval.
+// Each case feeds one mean batch time per tick and compares the interval after
+// every tick. Defaults: 33ms budget, hot >= 85% (28.05ms), cool when the load
+// predicted one step down is <= 60% (19.8ms), up after 2 hot ticks, down after
+// 3 cool ticks, step 1, interval 0..4.
+#include "unit.h"
+#include "infer.h"
+
+#define TRACE_MAX 16
+#define HOT 30000
+#define SPIKE 1000000 // 30 budgets: still only one step per decision
+
+typedef struct {
+  const gchar *name;
+  guint step, min_interval; // 0 -> default (step 1, min 0)
+  guint start;
+  guint n;
+  guint64 batch_us[TRACE_MAX];
+  guint want[TRACE_MAX];    // interval after each tick
+} InferTrace;
+
+static const InferTrace k_traces[] = {
+  // Hysteresis: the band between the thresholds holds the interval either way.
+  { "band holds", 0, 0, 1, 8,
+    { 22000, 22000, 22000, 22000, 22000, 22000, 22000, 22000 },
+    { 1, 1, 1, 1, 1, 1, 1, 1 } },
+  { "isolated hot ticks reset", 0, 0, 0, 8,
+    { HOT, 20000, HOT, 20000, HOT, 25000, HOT, 20000 },
+    { 0, 0, 0, 0, 0, 0, 0, 0 } },
+  { "cool run broken by the band", 0, 0, 2, 7,
+    { 12000, 12000, 25000, 12000, 12000, 12000, 12000 },
+    { 2, 2, 2, 2, 2, 1, 1 } },
+  { "hot breaks a cool run", 0, 0, 2, 6,
+    { 12000, 12000, HOT, 12000, 12000, 12000 },
+    { 2, 2, 2, 2, 2, 1 } },
+  // Step up: one step per up_after hot ticks, clamped at max.
+  { "sustained hot", 0, 0, 0, 10,
+    { HOT, HOT, HOT, HOT, HOT, HOT, HOT, HOT, HOT, HOT },
+    { 0, 1, 1, 2, 2, 3, 3, 4, 4, 4 } },
+  { "per-step limit under a spike", 0, 0, 0, 6,
+    { SPIKE, SPIKE, SPIKE, SPIKE, SPIKE, SPIKE },
+    { 0, 1, 1, 2, 2, 3 } },
+  { "step 3 clamps at max", 3, 0, 0, 6,
+    { SPIKE, SPIKE, SPIKE, SPIKE, SPIKE, SPIKE },
+    { 0, 3, 3, 4, 4, 4 } },
+  // Step down: only when the load predicted at interval-step is cool, so the
+  // controller does not drop into a level it would immediately leave again.
+  // 12ms at 3 -> 16ms at 2 (cool), at 2 -> 18ms at 1 (cool), at 1 -> 24ms at 0 (not).
+  { "step down stops at the prediction", 0, 0, 3, 10,
+    { 12000, 12000, 12000, 12000, 12000, 12000, 12000, 12000, 12000, 12000 },
+    { 3, 3, 2, 2, 2, 1, 1, 1, 1, 1 } },
+  { "idle steps to min", 0, 0, 2, 7,
+    { 1000, 1000, 1000, 1000, 1000, 1000, 1000 },
+    { 2, 2, 1, 1, 1, 0, 0 } },
+  { "never below min", 0, 1, 2, 7,
+    { 1000, 1000, 1000, 1000, 1000, 1000, 1000 },
+    { 2, 2, 1, 1, 1, 1, 1 } },
+  { "step 2 down clamps at min", 2, 0, 3, 6,
+    { 1000, 1000, 1000, 1000, 1000, 1000 },
+    { 3, 3, 1, 1, 1, 0 } },
+  // A full episode: load rises, the interval follows, load falls back.
+  { "up then down", 0, 0, 0, 12,
+    { HOT, HOT, HOT, HOT, 22000, 12000, 12000, 12000, 8000, 8000, 8000, 8000 },
+    { 0, 1, 1, 2, 2, 2, 2, 1, 1, 1, 0, 0 } },
+};
+
+static InferCtlParams params_for(const InferTrace *t) {
+  InferCtlParams p = { 33000, 85, 60, 2, 3, 1, 0, 4 };
+  if (t->step) p.step = t->step;
+  p.min_interval = t->min_interval;
+  return p;
+}
+
+static void test_traces(void) {
+  for (guint i = 0; i < G_N_ELEMENTS(k_traces); ++i) {
+    const InferTrace *t = &k_traces[i];
+    InferCtlParams p = params_for(t);
+    InferCtlState st = { t->start, 0, 0 };
+    for (guint k = 0; k < t->n; ++k) {
+      guint before = st.interval;
+      gboolean changed = infer_ctl_step(&st, &p, t->batch_us[k]);
+      if (st.interval != t->want[k])
+        g_error("trace '%s' tick %u (%" G_GUINT64_FORMAT "us): interval %u, want %u", t->name, k, t->batch_us[k], st.interval, t->want[k]);
+      if (changed != (st.interval != before))
+        g_error("trace '%s' tick %u: returned %d for %u -> %u", t->name, k, changed, before, st.interval);
+      if (st.interval > before && st.interval - before > p.step)
+        g_error("trace '%s' tick %u: moved %u -> %u, more than one step", t->name, k, before, st.interval);
+    }
+  }
+}
+
+// The counters restart after each decision: a second step needs a full new run.
+static void test_counters_reset(void) {
+  InferCtlParams p = { 33000, 85, 60, 2, 3, 1, 0, 4 };
+  InferCtlState st = { 0, 0, 0 };
+  g_assert_false(infer_ctl_step(&st, &p, HOT));
+  g_assert_cmpuint(st.hot, ==, 1);
+  g_assert_true(infer_ctl_step(&st, &p, HOT));
+  g_assert_cmpuint(st.hot, ==, 0);
+  g_assert_cmpuint(st.interval, ==, 1);
+  st.interval = 3;
+  g_assert_false(infer_ctl_step(&st, &p, 1000));
+  g_assert_false(infer_ctl_step(&st, &p, 1000));
+  g_assert_cmpuint(st.cool, ==, 2);
+  g_assert_true(infer_ctl_step(&st, &p, 1000));
+  g_assert_cmpuint(st.cool, ==, 0);
+  g_assert_cmpuint(st.interval, ==, 2);
+}
+
+void test_infer_register(void) {
+  g_test_add_func("/infer/traces", test_traces);
+  g_test_add_func("/infer/counters_reset", test_counters_reset);
+}
@@ -0,0 +1,90 @@
+// push_timeout_target / push_timeout_step: the fastest live source sets the wait,
+// stalled sources are ignored, bounds and deadband hold over a synthetic trace.
+// Params: 5..100ms, +20% margin, 10% deadband, sources below 1 fps are stalled.
+#include "unit.h"
+#include "push_timeout.h"
+
+static const PushTimeoutParams k_params = { 5000, 100000, 20, 10, 1.0 };
+
+// 1/fps * 1.2 in us; float rounding may land one below.
+#define NEAR(got, want) g_assert_cmpuint((got) + 1 - (want), <=, 1)
+
+typedef struct {
+  const gchar *name;
+  guint n;
+  gdouble fps[4];
+  guint64 want_us;  // 0: no live source
+} TargetCase;
+
+static const TargetCase k_targets[] = {
+  { "one 30fps source",         1, { 30.0 },                   40000 },
+  { "fastest of mixed rates",   3, { 25.0, 30.0, 15.0 },       40000 },
+  { "60fps camera sets it",     2, { 30.0, 60.0 },             20000 },
+  { "stalled source ignored",   2, { 0.5, 30.0 },              40000 },
+  { "all stalled",              2, { 0.5, 0.0 },               0 },
+  { "no sources",               0, { 0 },                      0 },
+  { "clamped to min",           1, { 1000.0 },                 5000 },
+  { "clamped to max",           1, { 5.0 },                    100000 },
+  { "just live (1 fps)",        1, { 1.0 },                    100000 },
+};
+
+static void test_target_table(void) {
+  for (guint i = 0; i < G_N_ELEMENTS(k_targets); ++i) {
+    const TargetCase *c = &k_targets[i];
+    guint64 got = push_timeout_target(c->fps, c->n, &k_params);
+    if (got + 1 < c->want_us || got > c->want_us)
+      g_error("case '%s': target %" G_GUINT64_FORMAT "us, want %" G_GUINT64_FORMAT "us", c->name, got, c->want_us);
+  }
+}
+
+typedef struct {
+  guint n;
+  gdouble fps[4];   // per-source rates measured this tick
+  gboolean changed;
+  guint64 want_us;  // timeout after the tick
+} TraceTick;
+
+// Two cameras at ~30/25 fps with arrival jitter, a 60 fps camera that joins and
+// then stalls, a full stall, and a small then a large rate change.
+static const TraceTick k_trace[] = {
+  { 2, { 30.0, 25.0 },        TRUE,  40000 },  // from the bin's 100ms default
+  { 2, { 30.3, 24.8 },        FALSE, 40000 },  // jitter: inside the deadband
+  { 2, { 29.7, 25.1 },        FALSE, 40000 },
+  { 3, { 60.0, 30.0, 25.0 },  TRUE,  20000 },  // fastest camera joins
+  { 3, { 59.4, 29.8, 25.2 },  FALSE, 20000 },
+  { 3, { 0.2, 30.0, 25.0 },   TRUE,  40000 },  // it stalls: no longer counts
+  { 3, { 0.0, 0.0, 0.0 },     FALSE, 40000 },  // nothing live: keep the last wait
+  { 1, { 33.0 },              FALSE, 40000 },  // 36.4ms target: within 10%
+  { 1, { 40.0 },              TRUE,  30000 },
+};
+
+static void test_step_trace(void) {
+  guint64 timeout = k_params.max_us;
+  for (guint k = 0; k < G_N_ELEMENTS(k_trace); ++k) {
+    const TraceTick *t = &k_trace[k];
+    gboolean changed = push_timeout_step(&timeout, t->fps, t->n, &k_params);
+    if (changed != t->changed || timeout + 1 < t->want_us || timeout > t->want_us)
+      g_error("tick %u: changed %d timeout %" G_GUINT64_FORMAT "us, want %d %" G_GUINT64_FORMAT "us",
+              k, changed, timeout, t->changed, t->want_us);
+  }
+}
+
+// A timeout outside the bounds (e.g. the bin's own default) is pulled in even when
+// the target is within the deadband of it.
+static void test_step_out_of_bounds(void) {
+  gdouble fps[1] = { 5.0 };
+  guint64 timeout = 104000;
+  g_assert_true(push_timeout_step(&timeout, fps, 1, &k_params));
+  g_assert_cmpuint(timeout, ==, 100000);
+  g_assert_false(push_timeout_step(&timeout, fps, 1, &k_params));
+  fps[0] = 30.0;
+  timeout = 4800;
+  g_assert_true(push_timeout_step(&timeout, fps, 1, &k_params));
+  NEAR(timeout, 40000);
+}
+
+void test_push_timeout_register(void) {
+  g_test_add_func("/push_timeout/target_table", test_target_table);
+  g_test_add_func("/push_timeout/step_trace", test_step_trace);
+  g_test_add_func("/push_timeout/step_out_of_bounds", test_step_out_of_bounds);
+}
@@ -0,0 +1,306 @@
+// rest_client against a loopback mock of the nvmultiurisrcbin REST server
+// - REST_PORTS lists a dead port first, so the first call has to probe and cache.
+// - The mock counts accepts and requests, and can be told to answer the next N
+//   requests with 503 or with an absurd Content-Length, or not at all.
+// - rest_client_init() runs once per process: cases share one client and one mock
+//   and compare counter deltas.
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "unit.h"
+#include "rest_client.h"
+
+#define BACKOFF_MS 20
+#define RETRIES 2
+#define TIMEOUT_MS 300
+
+typedef struct {
+  int listen_fd;
+  guint port;
+  GMutex lock;
+  GPtrArray *conns;   // open server-side fds (GINT_TO_POINTER)
+  guint accepts;
+  guint requests;
+  guint fail_next;    // answer this many requests with 503
+  guint bogus_next;   // answer this many with Content-Length 2^64-1, then close
+  guint hang_next;    // read this many and never answer
+} MockRest;
+
+static MockRest s_mock;
+
+static int listen_loopback(guint *port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0 };
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  g_assert_cmpint(bind(fd, (struct sockaddr*)&addr, sizeof(addr)), ==, 0);
+  g_assert_cmpint(getsockname(fd, (struct sockaddr*)&addr, &len), ==, 0);
+  *port = ntohs(addr.sin_port);
+  return fd;
+}
+
+static void mock_send(int fd, const char *text) {
+  gsize len = strlen(text);
+  while (len > 0) {
+    ssize_t n = send(fd, text, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    text += n; len -= (gsize)n;
+  }
+}
+
+// Serves pipelined POSTs on one connection until the client (or mock_kick) closes it.
+static gpointer mock_conn_thread(gpointer data) {
+  int fd = GPOINTER_TO_INT(data);
+  GString *acc = g_string_new(NULL);
+  char buf[4096];
+  gboolean open = TRUE;
+  while (open) {
+    const gchar *hdr_end = g_strstr_len(acc->str, (gssize)acc->len, "\r\n\r\n");
+    if (hdr_end) {
+      gsize hdr_len = (gsize)(hdr_end - acc->str) + 4;
+      gchar *hdr = g_ascii_strdown(acc->str, (gssize)hdr_len);
+      const gchar *cl = strstr(hdr, "\r\ncontent-length:");
+      gsize body_len = cl ? (gsize) g_ascii_strtoull(cl + 17, NULL, 10) : 0;
+      g_free(hdr);
+      if (acc->len >= hdr_len + body_len) {
+        g_string_erase(acc, 0, (gssize)(hdr_len + body_len));
+        const char *reply = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 2\r\n\r\n{}";
+        gboolean bogus = FALSE, hang = FALSE;
+        g_mutex_lock(&s_mock.lock);
+        s_mock.requests++;
+        if (s_mock.hang_next > 0) {
+          s_mock.hang_next--;
+          hang = TRUE;
+        } else if (s_mock.fail_next > 0) {
+          s_mock.fail_next--;
+          reply = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+        } else if (s_mock.bogus_next > 0) {
+          s_mock.bogus_next--;
+          bogus = TRUE;
+          reply = "HTTP/1.1 200 OK\r\nContent-Length: 18446744073709551615\r\n\r\n{}";
+        }
+        g_mutex_unlock(&s_mock.lock);
+        if (hang) continue;
+        mock_send(fd, reply);
+        if (bogus) break;
+        continue;
+      }
+    }
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) open = FALSE;
+    else g_string_append_len(acc, buf, n);
+  }
+  g_mutex_lock(&s_mock.lock);
+  g_ptr_array_remove(s_mock.conns, GINT_TO_POINTER(fd));
+  g_mutex_unlock(&s_mock.lock);
+  close(fd);
+  g_string_free(acc, TRUE);
+  return NULL;
+}
+
+static gpointer mock_accept_thread(gpointer data) {
+  (void)data;
+  for (;;) {
+    int fd = accept(s_mock.listen_fd, NULL, NULL);
+    if (fd < 0) { if (errno == EINTR) continue; break; }
+    g_mutex_lock(&s_mock.lock);
+    s_mock.accepts++;
+    g_ptr_array_add(s_mock.conns, GINT_TO_POINTER(fd));
+    g_mutex_unlock(&s_mock.lock);
+    g_thread_unref(g_thread_new("mock_rest_conn", mock_conn_thread, GINT_TO_POINTER(fd)));
+  }
+  return NULL;
+}
+
+// Drops every open connection server-side, as a restarted REST server would.
+static void mock_kick(void) {
+  g_mutex_lock(&s_mock.lock);
+  for (guint i = 0; i < s_mock.conns->len; ++i) shutdown(GPOINTER_TO_INT(g_ptr_array_index(s_mock.conns, i)), SHUT_RDWR);
+  g_mutex_unlock(&s_mock.lock);
+  g_usleep(50 * 1000);
+}
+
+static void mock_counts(guint *accepts, guint *requests) {
+  g_mutex_lock(&s_mock.lock);
+  *accepts = s_mock.accepts;
+  *requests = s_mock.requests;
+  g_mutex_unlock(&s_mock.lock);
+}
+
+static void mock_script(guint fail_next, guint bogus_next, guint hang_next) {
+  g_mutex_lock(&s_mock.lock);
+  s_mock.fail_next = fail_next;
+  s_mock.bogus_next = bogus_next;
+  s_mock.hang_next = hang_next;
+  g_mutex_unlock(&s_mock.lock);
+}
+
+// Mock up, client pointed at "<dead port>,<mock port>" (first call only).
+static void setup_once(void) {
+  static gsize done = 0;
+  if (!g_once_init_enter(&done)) return;
+  guint dead_port = 0;
+  close(listen_loopback(&dead_port));
+  g_mutex_init(&s_mock.lock);
+  s_mock.conns = g_ptr_array_new();
+  s_mock.listen_fd = listen_loopback(&s_mock.port);
+  g_assert_cmpint(listen(s_mock.listen_fd, 16), ==, 0);
+  g_thread_unref(g_thread_new("mock_rest", mock_accept_thread, NULL));
+
+  gchar *ports = g_strdup_printf("%u,%u", dead_port, s_mock.port);
+  gchar *retries = g_strdup_printf("%u", RETRIES);
+  gchar *backoff = g_strdup_printf("%u", BACKOFF_MS);
+  gchar *timeout = g_strdup_printf("%u", TIMEOUT_MS);
+  g_setenv("REST_PORTS", ports, TRUE);
+  g_setenv("REST_RETRIES", retries, TRUE);
+  g_setenv("REST_BACKOFF_MS", backoff, TRUE);
+  g_setenv("REST_TIMEOUT_MS", timeout, TRUE);
+  g_setenv("REST_POOL_SIZE", "2", TRUE);
+  g_free(ports); g_free(retries); g_free(backoff); g_free(timeout);
+  rest_client_init();
+  g_once_init_leave(&done, 1);
+}
+
+static void test_port_probe_and_cache(void) {
+  setup_once();
+  RestClientStats st;
+  rest_client_get_stats(&st);
+  g_assert_cmpuint(st.port, ==, 0);
+
+  // First call: the dead port refuses, the mock answers and gets cached.
+  g_assert_true(rest_client_post("/api/v1/stream/add", "{\"n\":0}"));
+  rest_client_get_stats(&st);
+  g_assert_cmpuint(st.port, ==, s_mock.port);
+  g_assert_cmpuint(st.connects, ==, 2);
+  g_assert_cmpuint(st.retries, ==, 0);
+
+  // The server drops the pooled socket: one reconnect, straight to the cached port.
+  mock_kick();
+  guint64 connects0 = st.connects;
+  g_assert_true(rest_client_post("/api/v1/stream/add", "{\"n\":1}"));
+  rest_client_get_stats(&st);
+  g_assert_cmpuint(st.connects - connects0, ==, 1);
+  g_assert_cmpuint(st.retries, ==, 0);
+  g_assert_cmpuint(st.failures, ==, 0);
+}
+
+static void test_keep_alive_reuse(void) {
+  setup_once();
+  g_assert_true(rest_client_post("/api/v1/stream/add", "{}")); // leaves a pooled socket
+  guint accepts0, requests0, accepts1, requests1;
+  RestClientStats st0, st1;
+  mock_counts(&accepts0, &requests0);
+  rest_client_get_stats(&st0);
+
+  for (guint i = 0; i < 20; ++i) g_assert_true(rest_client_post("/api/v1/stream/add", "{}"));
+  gchar *bodies[8];
+  for (guint i = 0; i < G_N_ELEMENTS(bodies); ++i) bodies[i] = g_strdup_printf("{\"i\":%u}", i);
+  g_assert_cmpuint(rest_client_post_batch("/api/v1/stream/add", bodies, G_N_ELEMENTS(bodies)), ==, G_N_ELEMENTS(bodies));
+  for (guint i = 0; i < G_N_ELEMENTS(bodies); ++i) g_free(bodies[i]);
+  rest_client_post_async("/api/v1/stream/remove", "{}");
+  g_assert_true(rest_client_post("/api/v1/stream/add", "{}")); // FIFO: the async one is done too
+
+  mock_counts(&accepts1, &requests1);
+  rest_client_get_stats(&st1);
+  g_assert_cmpuint(accepts1 - accepts0, ==, 0);
+  g_assert_cmpuint(st1.connects - st0.connects, ==, 0);
+  g_assert_cmpuint(requests1 - requests0, ==, 20 + 8 + 2);
+  g_assert_cmpuint(st1.calls - st0.calls, ==, 20 + 1 + 2);
+}
+
+// The server saw a request it answered with 5xx (it may have applied it): no resend.
+static void test_5xx_not_resent(void) {
+  setup_once();
+  g_assert_true(rest_client_post("/api/v1/stream/add", "{}")); // leaves a pooled socket
+  RestClientStats st0, st1;
+  guint accepts0, requests0, accepts1, requests1;
+  rest_client_get_stats(&st0);
+  mock_counts(&accepts0, &requests0);
+
+  mock_script(1, 0, 0);
+  g_assert_false(rest_client_post("/api/v1/stream/add", "{}"));
+  rest_client_get_stats(&st1);
+  mock_counts(&accepts1, &requests1);
+  g_assert_cmpuint(requests1 - requests0, ==, 1);
+  g_assert_cmpuint(st1.retries - st0.retries, ==, 0);
+  g_assert_cmpuint(st1.failures - st0.failures, ==, 1);
+
+  // In a batch, the 5xx fails its own entry only; the rest are still answered.
+  mock_script(1, 0, 0);
+  gchar *bodies[] = { "{\"i\":0}", "{\"i\":1}", "{\"i\":2}" };
+  g_assert_cmpuint(rest_client_post_batch("/api/v1/stream/add", bodies, G_N_ELEMENTS(bodies)), ==, 2);
+  mock_counts(&accepts0, &requests0);
+  g_assert_cmpuint(requests0 - requests1, ==, 3);
+  g_assert_true(rest_client_post("/api/v1/stream/add", "{}"));
+}
+
+// Accepted but never answered: fails after REST_TIMEOUT_MS and is not sent again.
+static void test_timeout_not_resent(void) {
+  setup_once();
+  RestClientStats st0, st1;
+  guint accepts0, requests0, accepts1, requests1;
+  rest_client_get_stats(&st0);
+  mock_counts(&accepts0, &requests0);
+
+  mock_script(0, 0, 1);
+  gint64 t0 = g_get_monotonic_time();
+  g_assert_false(rest_client_post("/api/v1/stream/add", "{}"));
+  gint64 took_ms = (g_get_monotonic_time() - t0) / 1000;
+  rest_client_get_stats(&st1);
+  mock_counts(&accepts1, &requests1);
+  g_assert_cmpint(took_ms, >=, TIMEOUT_MS);
+  g_assert_cmpint(took_ms, <, TIMEOUT_MS + 1000);
+  g_assert_cmpuint(requests1 - requests0, ==, 1);
+  g_assert_cmpuint(st1.retries - st0.retries, ==, 0);
+  g_assert_cmpuint(st1.failures - st0.failures, ==, 1);
+
+  // The timed-out socket is not pooled: the next call reconnects and succeeds.
+  g_assert_true(rest_client_post("/api/v1/stream/add", "{}"));
+  rest_client_get_stats(&st0);
+  g_assert_cmpuint(st0.connects - st1.connects, ==, 1);
+}
+
+static void test_bogus_content_length(void) {
+  setup_once();
+  RestClientStats st0, st1;
+  rest_client_get_stats(&st0);
+  // A 2^64-1 Content-Length is a transport error (not "read to EOF" and not a 2xx).
+  mock_script(0, 100, 0);
+  g_assert_false(rest_client_post("/api/v1/stream/add", "{}"));
+  mock_script(0, 0, 0);
+  rest_client_get_stats(&st1);
+  g_assert_cmpuint(st1.failures - st0.failures, ==, 1);
+  g_assert_true(rest_client_post("/api/v1/stream/add", "{}"));
+}
+
+// What /rest_stats renders: call counts, latencies, queue depth, cached port.
+static void test_stats(void) {
+  setup_once();
+  RestClientStats st0, st1;
+  rest_client_get_stats(&st0);
+  for (guint i = 0; i < 5; ++i) g_assert_true(rest_client_post("/api/v1/stream/add", "{}"));
+  rest_client_get_stats(&st1);
+  g_assert_cmpuint(st1.calls - st0.calls, ==, 5);
+  g_assert_cmpuint(st1.failures, ==, st0.failures);
+  g_assert_cmpuint(st1.last_us, >, 0);
+  g_assert_cmpuint(st1.max_us, >=, st1.last_us);
+  g_assert_cmpuint(st1.total_us - st0.total_us, >=, st1.last_us);
+  g_assert_cmpuint(st1.queued, ==, 0);
+  g_assert_cmpuint(st1.port, ==, s_mock.port);
+}
+
+void test_rest_client_register(void) {
+  g_test_add_func("/rest_client/port_probe_and_cache", test_port_probe_and_cache);
+  g_test_add_func("/rest_client/keep_alive_reuse", test_keep_alive_reuse);
+  g_test_add_func("/rest_client/5xx_not_resent", test_5xx_not_resent);
+  g_test_add_func("/rest_client/timeout_not_resent", test_timeout_not_resent);
+  g_test_add_func("/rest_client/bogus_content_length", test_bogus_content_length);
+  g_test_add_func("/rest_client/stats", test_stats);
+}
@@ -0,0 +1,142 @@
+// shard_plan / shard_pick: port allocation, batch, CPU slices, encoder budget
+// split and least-loaded routing.
+#include "unit.h"
+#include "shard.h"
+
+static ShardBase base_of(guint shards) {
+  ShardBase b = { 0 };
+  b.shards = shards;
+  b.batch = 64 / shards;
+  b.rtsp_port = 8554;
+  b.base_udp_port = 5000;
+  b.ctrl_port = 8080;
+  b.rest_port = 9000;
+  b.cpu_first = 0;
+  b.cpu_cores = 8;
+  b.hw_sessions = 8;
+  b.admission_cores = 8.0;
+  b.sw_fps_per_core = 240;
+  return b;
+}
+
+static void test_plan_ports(void) {
+  ShardBase b = base_of(4);
+  ShardPlan p[4];
+  for (guint i = 0; i < 4; ++i) shard_plan(&b, i, &p[i]);
+  for (guint i = 0; i < 4; ++i) {
+    g_assert_cmpuint(p[i].max_streams, ==, 16);
+    g_assert_cmpuint(p[i].rtsp_port, ==, 8554 + i);
+    g_assert_cmpuint(p[i].ctrl_port, ==, 8081 + i); // 8080 is the front
+    g_assert_cmpuint(p[i].rest_port, ==, 9000 + i);
+    g_assert_cmpuint(p[i].base_udp_port, ==, 5000 + i * 16);
+    // UDP ranges are back to back, never overlapping.
+    if (i > 0) g_assert_cmpuint(p[i].base_udp_port, ==, p[i - 1].base_udp_port + p[i - 1].max_streams);
+  }
+}
+
+static void test_plan_cpu_slices(void) {
+  ShardBase b = base_of(4);
+  b.cpu_first = 2;
+  ShardPlan p;
+  for (guint i = 0; i < 4; ++i) {
+    shard_plan(&b, i, &p);
+    g_assert_cmpuint(p.cpu_cores, ==, 2);
+    g_assert_cmpuint(p.cpu_first, ==, 2 + 2 * i);
+  }
+  // Fewer CPUs than shards: single CPUs shared round-robin.
+  b.cpu_cores = 3;
+  guint want_first[4] = { 2, 3, 4, 2 };
+  for (guint i = 0; i < 4; ++i) {
+    shard_plan(&b, i, &p);
+    g_assert_cmpuint(p.cpu_cores, ==, 1);
+    g_assert_cmpuint(p.cpu_first, ==, want_first[i]);
+  }
+  // No CPU budget: shards inherit the front's environment.
+  b.cpu_cores = 0;
+  shard_plan(&b, 1, &p);
+  g_assert_cmpuint(p.cpu_cores, ==, 0);
+}
+
+static void test_plan_encoder_budget(void) {
+  // NVENC sessions: the remainder goes to the lowest shards, the sum is the host cap.
+  ShardBase b = base_of(3);
+  b.hw_sessions = 8;
+  b.admission_cores = 6.0;
+  guint want_hw[3] = { 3, 3, 2 }, hw_sum = 0;
+  gdouble cores_sum = 0.0;
+  for (guint i = 0; i < 3; ++i) {
+    ShardPlan p;
+    shard_plan(&b, i, &p);
+    g_assert_cmpuint(p.hw_threshold, ==, want_hw[i]);
+    g_assert_cmpfloat(p.admission_cores, ==, 2.0);
+    g_assert_cmpuint(p.sw_fps_per_core, ==, 240); // one calibration for all
+    hw_sum += p.hw_threshold;
+    cores_sum += p.admission_cores;
+  }
+  g_assert_cmpuint(hw_sum, ==, 8);
+  g_assert_cmpfloat(cores_sum, ==, 6.0);
+  // More shards than sessions / cores: some shards get no NVENC, cores go fractional.
+  b = base_of(16);
+  b.hw_sessions = 3;
+  b.admission_cores = 4.0;
+  hw_sum = 0;
+  for (guint i = 0; i < 16; ++i) {
+    ShardPlan p;
+    shard_plan(&b, i, &p);
+    g_assert_cmpuint(p.hw_threshold, ==, i < 3 ? 1 : 0);
+    g_assert_cmpfloat(p.admission_cores, ==, 0.25);
+    hw_sum += p.hw_threshold;
+  }
+  g_assert_cmpuint(hw_sum, ==, 3);
+  // Uncalibrated front: shards calibrate themselves.
+  b.sw_fps_per_core = 0;
+  ShardPlan p;
+  shard_plan(&b, 0, &p);
+  g_assert_cmpuint(p.sw_fps_per_core, ==, 0);
+}
+
+typedef struct {
+  const gchar *name;
+  ShardLoad loads[4];
+  guint n;
+  gint want;
+} PickCase;
+
+static const PickCase k_pick[] = {
+  { "none",                  { { 0 } }, 0, -1 },
+  { "all dead",              { { FALSE, 0, 16 }, { FALSE, 0, 16 } }, 2, -1 },
+  { "all full",              { { TRUE, 16, 16 }, { TRUE, 8, 8 } }, 2, -1 },
+  { "tie -> lowest index",   { { TRUE, 4, 16 }, { TRUE, 4, 16 }, { TRUE, 4, 16 } }, 3, 0 },
+  { "least loaded",          { { TRUE, 5, 16 }, { TRUE, 3, 16 }, { TRUE, 4, 16 } }, 3, 1 },
+  { "dead skipped",          { { TRUE, 5, 16 }, { FALSE, 0, 16 }, { TRUE, 6, 16 } }, 3, 0 },
+  { "full skipped",          { { TRUE, 16, 16 }, { TRUE, 15, 16 } }, 2, 1 },
+  { "fill ratio, not count", { { TRUE, 4, 8 }, { TRUE, 6, 16 } }, 2, 1 },
+  { "zero capacity skipped", { { TRUE, 0, 0 }, { TRUE, 9, 16 } }, 2, 1 },
+};
+
+static void test_pick_table(void) {
+  for (guint i = 0; i < G_N_ELEMENTS(k_pick); ++i) {
+    const PickCase *c = &k_pick[i];
+    gint got = shard_pick(c->loads, c->n);
+    if (got != c->want) g_error("case '%s': picked %d, want %d", c->name, got, c->want);
+  }
+}
+
+// Adds routed one at a time fill the shards evenly, then stop at capacity.
+static void test_pick_fills_evenly(void) {
+  ShardLoad loads[3] = { { TRUE, 0, 4 }, { TRUE, 0, 4 }, { TRUE, 0, 4 } };
+  for (guint k = 0; k < 12; ++k) {
+    gint s = shard_pick(loads, 3);
+    g_assert_cmpint(s, ==, (gint)(k % 3));
+    loads[s].active++;
+  }
+  g_assert_cmpint(shard_pick(loads, 3), ==, -1);
+}
+
+void test_shard_register(void) {
+  g_test_add_func("/shard/plan_ports", test_plan_ports);
+  g_test_add_func("/shard/plan_cpu_slices", test_plan_cpu_slices);
+  g_test_add_func("/shard/plan_encoder_budget", test_plan_encoder_budget);
+  g_test_add_func("/shard/pick_table", test_pick_table);
+  g_test_add_func("/shard/pick_fills_evenly", test_pick_fills_evenly);
+}
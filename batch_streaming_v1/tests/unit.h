@@ -0,0 +1,16 @@
+// Plain-C unit tests (GLib g_test), linked against every src/*.c except main.c.
+// Each tests/test_<module>.c registers its cases here; unit_main.c runs them all.
+// Build + run inside the image (build.sh does this after the sanity check):
+//   docker run --rm batch_streaming:latest ./unit_tests
+#ifndef UNIT_H
+#define UNIT_H
+
+#include <glib.h>
+
+void test_rest_client_register(void);
+void test_admission_register(void);
+void test_shard_register(void);
+void test_infer_register(void);
+void test_push_timeout_register(void);
+
+#endif // UNIT_H
@@ -0,0 +1,13 @@
+// Unit test runner: registers every tests/test_*.c suite and runs it (g_test)
+#include <glib.h>
+#include "unit.h"
+
+int main(int argc, char *argv[]) {
+  g_test_init(&argc, &argv, NULL);
+  test_rest_client_register();
+  test_admission_register();
+  test_shard_register();
+  test_infer_register();
+  test_push_timeout_register();
+  return g_test_run();
+}
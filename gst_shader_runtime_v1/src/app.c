@@ -4,6 +4,7 @@
 #include <json-glib/json-glib.h>
 #include <signal.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 #include "control.h"
@@ -195,8 +196,176 @@ static void native_stop_locked(void) {
   g_state.native_running = FALSE;
 }
 
+static gboolean write_all_fd(int fd, const gchar *data, gsize len, gchar **error_out) {
+  gsize off = 0;
+  while (off < len) {
+    ssize_t n = write(fd, data + off, len - off);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      if (error_out) *error_out = g_strdup_printf("native_stdin_write_failed=%s", g_strerror(errno));
+      return FALSE;
+    }
+    off += (gsize)n;
+  }
+  return TRUE;
+}
+
+// Warm worker pool. Workers are spawned ahead of any select and sent
+// {"warm_only":true}: they pay library preload, CUDA context and buffer setup,
+// then block on stdin for the real request. A select hands its request line to
+// the oldest parked worker and falls back to a cold spawn when the pool is empty.
+// Taken workers are replaced after warm_refill_ms so the refill does not compete
+// with the graph starting up.
+#define WARM_POOL_MAX 4
+#define WARM_POOL_MAX_FAILURES 3
+
+typedef struct {
+  GPid pid;
+  gint stdin_fd;  // kept open: the worker blocks on it until the request arrives
+  gint ready_fd;
+} WarmWorker;
+
+static GMutex s_pool_lock;
+static WarmWorker s_pool[WARM_POOL_MAX];
+static guint s_pool_len = 0;
+static guint s_pool_failures = 0;  // parked workers that exited before being used
+static guint s_pool_refill_id = 0;
+
+static void native_child_watch(GPid pid, gint status, gpointer user_data);
+
+// Every worker gets the write end of a pipe as fd NATIVE_READY_FD (named in
+// DPROC_READY_FD) and writes one "first_frame mono_ns=<CLOCK_MONOTONIC ns>" line
+// there after muxing its first packet; *ready_fd is the read end.
+#define NATIVE_READY_FD 3
+
+static gboolean native_spawn(GPid *pid, gint *stdin_fd, gint *ready_fd, gchar **error_out) {
+  const gchar *argv[] = { g_cfg.native_processor, NULL };
+  GError *err = NULL;
+  gint ready[2];
+  if (!g_unix_open_pipe(ready, FD_CLOEXEC, &err)) {
+    if (error_out) *error_out = g_strdup(err ? err->message : "native_ready_pipe_failed");
+    if (err) g_error_free(err);
+    return FALSE;
+  }
+  gchar *fd_name = g_strdup_printf("%d", NATIVE_READY_FD);
+  gchar **envp = g_environ_setenv(g_get_environ(), "DPROC_READY_FD", fd_name, TRUE);
+  const gint source_fds[] = { ready[1] };
+  const gint target_fds[] = { NATIVE_READY_FD };
+  gboolean ok = g_spawn_async_with_pipes_and_fds(NULL, argv, (const gchar * const *)envp,
+                                                 G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, -1, -1, -1,
+                                                 source_fds, target_fds, G_N_ELEMENTS(source_fds),
+                                                 pid, stdin_fd, NULL, NULL, &err);
+  g_strfreev(envp);
+  g_free(fd_name);
+  close(ready[1]);
+  if (!ok) {
+    close(ready[0]);
+    if (error_out) *error_out = g_strdup(err ? err->message : "native_spawn_failed");
+    if (err) g_error_free(err);
+    return FALSE;
+  }
+  *ready_fd = ready[0];
+  g_child_watch_add(*pid, native_child_watch, NULL);
+  return TRUE;
+}
+
+// Caller holds s_pool_lock.
+static void pool_fill_locked(void) {
+  while (s_pool_len < MIN(g_cfg.warm_workers, WARM_POOL_MAX) && s_pool_failures < WARM_POOL_MAX_FAILURES) {
+    WarmWorker *ww = &s_pool[s_pool_len];
+    gchar *error = NULL;
+    if (!native_spawn(&ww->pid, &ww->stdin_fd, &ww->ready_fd, &error)) {
+      LOG_WRN("warm pool: spawn failed: %s", error ? error : "unknown");
+      g_free(error);
+      s_pool_failures++;
+      continue;
+    }
+    const gchar *warm = "{\"warm_only\":true}\n";
+    if (!write_all_fd(ww->stdin_fd, warm, strlen(warm), NULL)) {
+      kill((pid_t)ww->pid, SIGTERM);
+      close(ww->stdin_fd);
+      close(ww->ready_fd);
+      s_pool_failures++;
+      continue;
+    }
+    LOG_INF("warm pool: parked pid=%d (%u/%u)", (int)ww->pid, s_pool_len + 1, g_cfg.warm_workers);
+    s_pool_len++;
+  }
+  if (s_pool_failures >= WARM_POOL_MAX_FAILURES && s_pool_len == 0 && g_cfg.warm_workers) {
+    LOG_WRN("warm pool: disabled after %u failed workers; selects spawn cold", s_pool_failures);
+    g_cfg.warm_workers = 0;
+  }
+}
+
+static gboolean pool_refill_cb(gpointer data) {
+  (void)data;
+  g_mutex_lock(&s_pool_lock);
+  s_pool_refill_id = 0;
+  pool_fill_locked();
+  g_mutex_unlock(&s_pool_lock);
+  return G_SOURCE_REMOVE;
+}
+
+// Caller holds s_pool_lock.
+static void pool_schedule_refill_locked(void) {
+  if (s_pool_refill_id || !g_cfg.warm_workers) return;
+  s_pool_refill_id = g_timeout_add(g_cfg.warm_refill_ms, pool_refill_cb, NULL);
+}
+
+// Oldest parked worker, or FALSE when the pool is empty.
+static gboolean pool_take(GPid *pid, gint *stdin_fd, gint *ready_fd) {
+  g_mutex_lock(&s_pool_lock);
+  gboolean ok = s_pool_len > 0;
+  if (ok) {
+    *pid = s_pool[0].pid;
+    *stdin_fd = s_pool[0].stdin_fd;
+    *ready_fd = s_pool[0].ready_fd;
+    memmove(&s_pool[0], &s_pool[1], (s_pool_len - 1) * sizeof(s_pool[0]));
+    s_pool_len--;
+    s_pool_failures = 0;
+  }
+  pool_schedule_refill_locked();
+  g_mutex_unlock(&s_pool_lock);
+  return ok;
+}
+
+// A parked worker exited (warm failed, or was killed): drop it and refill later.
+static gboolean pool_forget(GPid pid, gint status) {
+  g_mutex_lock(&s_pool_lock);
+  gboolean found = FALSE;
+  for (guint i = 0; i < s_pool_len && !found; i++) {
+    if (s_pool[i].pid != pid) continue;
+    close(s_pool[i].stdin_fd);
+    close(s_pool[i].ready_fd);
+    memmove(&s_pool[i], &s_pool[i + 1], (s_pool_len - i - 1) * sizeof(s_pool[0]));
+    s_pool_len--;
+    s_pool_failures++;
+    found = TRUE;
+    LOG_WRN("warm pool: parked pid=%d exited status=%d", (int)pid, status);
+    pool_schedule_refill_locked();
+  }
+  g_mutex_unlock(&s_pool_lock);
+  return found;
+}
+
+static void pool_drain(void) {
+  g_mutex_lock(&s_pool_lock);
+  if (s_pool_refill_id) { g_source_remove(s_pool_refill_id); s_pool_refill_id = 0; }
+  for (guint i = 0; i < s_pool_len; i++) {
+    kill((pid_t)s_pool[i].pid, SIGTERM);
+    close(s_pool[i].stdin_fd);
+    close(s_pool[i].ready_fd);
+  }
+  s_pool_len = 0;
+  g_mutex_unlock(&s_pool_lock);
+}
+
 static void native_child_watch(GPid pid, gint status, gpointer user_data) {
   (void)user_data;
+  if (pool_forget(pid, status)) {
+    g_spawn_close_pid(pid);
+    return;
+  }
   g_mutex_lock(&g_state.lock);
   if (g_state.native_pid == pid) {
     g_state.native_pid = 0;
@@ -211,20 +380,6 @@ static void native_child_watch(GPid pid, gint status, gpointer user_data) {
   g_spawn_close_pid(pid);
 }
 
-static gboolean write_all_fd(int fd, const gchar *data, gsize len, gchar **error_out) {
-  gsize off = 0;
-  while (off < len) {
-    ssize_t n = write(fd, data + off, len - off);
-    if (n < 0) {
-      if (errno == EINTR) continue;
-      if (error_out) *error_out = g_strdup_printf("native_stdin_write_failed=%s", g_strerror(errno));
-      return FALSE;
-    }
-    off += (gsize)n;
-  }
-  return TRUE;
-}
-
 static gchar *native_request_json(const GraphSpec *graph) {
   JsonParser *post_parser = NULL, *deband_parser = NULL, *custom_parser = NULL;
   JsonParser *dlsaa_parser = NULL, *tdn_parser = NULL;
@@ -321,36 +476,235 @@ static gchar *native_request_json(const GraphSpec *graph) {
   return out;
 }
 
+// The ready line is written with a single write() well under PIPE_BUF, so one read
+// gets all of it. Returns the worker's stamp in g_get_monotonic_time() units (both
+// CLOCK_MONOTONIC), the receive time for a line without one, 0 on EOF.
+static gint64 native_read_first_frame(gint ready_fd) {
+  gchar buf[128];
+  ssize_t n;
+  do {
+    n = read(ready_fd, buf, sizeof(buf) - 1);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) return 0;
+  buf[n] = '\0';
+  const gchar *stamp = strstr(buf, "mono_ns=");
+  gint64 ns = stamp ? g_ascii_strtoll(stamp + strlen("mono_ns="), NULL, 10) : 0;
+  return ns > 0 ? ns / 1000 : g_get_monotonic_time();
+}
+
+// break_us: when the previous worker was stopped, 0 if there was none.
+static void native_record_switch(GPid pid, gint64 select_us, gint64 break_us, gint64 first_us) {
+  gdouble first_ms = (gdouble)(first_us - select_us) / 1000.0;
+  if (!break_us) {
+    LOG_INF("switch: pid=%d first frame %.1fms after select (no previous worker)", (int)pid, first_ms);
+    return;
+  }
+  gdouble gap_ms = first_us > break_us ? (gdouble)(first_us - break_us) / 1000.0 : 0.0;
+  gdouble overlap_ms = break_us > first_us ? (gdouble)(break_us - first_us) / 1000.0 : 0.0;
+  g_mutex_lock(&g_state.lock);
+  g_state.switch_measured = TRUE;
+  g_state.switch_first_frame_ms = first_ms;
+  g_state.switch_gap_ms = gap_ms;
+  g_state.switch_overlap_ms = overlap_ms;
+  g_mutex_unlock(&g_state.lock);
+  LOG_INF("switch: pid=%d first frame %.1fms after select, gap=%.1fms overlap=%.1fms",
+          (int)pid, first_ms, gap_ms, overlap_ms);
+}
+
+typedef struct {
+  GPid pid;
+  gint64 select_us;
+  gint64 break_us;
+} FirstFrameWatch;
+
+static gboolean native_first_frame_cb(gint fd, GIOCondition condition, gpointer user_data) {
+  (void)condition;
+  FirstFrameWatch *w = (FirstFrameWatch *)user_data;
+  gint64 first_us = native_read_first_frame(fd);
+  if (first_us) native_record_switch(w->pid, w->select_us, w->break_us, first_us);
+  close(fd);
+  g_free(w);
+  return G_SOURCE_REMOVE;
+}
+
+// Measures on the main loop when the select did not wait for the first frame.
+static void native_watch_first_frame(GPid pid, gint ready_fd, gint64 select_us, gint64 break_us) {
+  FirstFrameWatch *w = g_new0(FirstFrameWatch, 1);
+  w->pid = pid;
+  w->select_us = select_us;
+  w->break_us = break_us;
+  g_unix_fd_add(ready_fd, G_IO_IN | G_IO_HUP | G_IO_ERR, native_first_frame_cb, w);
+}
+
+// Pending make-before-break handover, under g_state.lock. The new worker is fed its
+// request while g_state.native_pid stays on the old one; the handover runs on the
+// main loop (first frame on ready_fd, or switch_overlap_ms), so the control thread
+// never waits for it. serial 0: none pending; while set, both sources are armed and
+// own ready_fd.
+typedef struct {
+  guint serial;
+  GPid pid;
+  gint ready_fd;
+  GraphSpec graph;
+  gint64 select_us;
+  guint fd_id;
+  guint timeout_id;
+} SwitchHandover;
+
+static SwitchHandover s_switch;
+static guint s_switch_serial = 0;
+
+// Caller holds g_state.lock. Stops the on-air worker and puts the pending one in its
+// place; returns when the old worker was stopped, 0 if there was none.
+static gint64 native_handover_locked(void) {
+  gint64 break_us = 0;
+  if (g_state.native_pid) {
+    native_stop_locked();
+    break_us = g_get_monotonic_time();
+  }
+  g_state.native_pid = s_switch.pid;
+  g_state.native_running = TRUE;
+  g_state.graph = s_switch.graph;
+  g_state.running = TRUE;
+  g_free(g_state.last_error);
+  g_state.last_error = NULL;
+  s_switch.serial = 0;
+  return break_us;
+}
+
+// Caller holds g_state.lock. A newer select or a stop supersedes the pending worker.
+static void native_switch_cancel_locked(void) {
+  if (!s_switch.serial) return;
+  g_source_remove(s_switch.fd_id);
+  g_source_remove(s_switch.timeout_id);
+  close(s_switch.ready_fd);
+  kill((pid_t)s_switch.pid, SIGTERM);
+  LOG_INF("switch: pid=%d superseded before handover", (int)s_switch.pid);
+  s_switch.serial = 0;
+}
+
+static gboolean native_switch_ready_cb(gint fd, GIOCondition condition, gpointer user_data) {
+  (void)condition;
+  g_mutex_lock(&g_state.lock);
+  if (s_switch.serial != GPOINTER_TO_UINT(user_data)) {
+    g_mutex_unlock(&g_state.lock);
+    return G_SOURCE_REMOVE;
+  }
+  g_source_remove(s_switch.timeout_id);
+  GPid pid = s_switch.pid;
+  gint64 select_us = s_switch.select_us;
+  gint64 first_us = native_read_first_frame(fd);
+  close(fd);
+  gint64 break_us = 0;
+  if (first_us) {
+    break_us = native_handover_locked();
+  } else {
+    // Died before its first frame: the old worker stays on air.
+    kill((pid_t)pid, SIGTERM);
+    s_switch.serial = 0;
+    g_free(g_state.last_error);
+    g_state.last_error = g_strdup("native_exited_before_first_frame");
+  }
+  g_mutex_unlock(&g_state.lock);
+  if (first_us) {
+    native_record_switch(pid, select_us, break_us, first_us);
+  } else {
+    LOG_WRN("switch: pid=%d exited before its first frame; keeping the previous worker", (int)pid);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean native_switch_timeout_cb(gpointer user_data) {
+  g_mutex_lock(&g_state.lock);
+  if (s_switch.serial != GPOINTER_TO_UINT(user_data)) {
+    g_mutex_unlock(&g_state.lock);
+    return G_SOURCE_REMOVE;
+  }
+  g_source_remove(s_switch.fd_id);
+  GPid pid = s_switch.pid;
+  gint ready_fd = s_switch.ready_fd;
+  gint64 select_us = s_switch.select_us;
+  gint64 break_us = native_handover_locked();
+  g_mutex_unlock(&g_state.lock);
+  LOG_WRN("switch: pid=%d no first frame within %ums; stopped the previous worker anyway",
+          (int)pid, g_cfg.switch_overlap_ms);
+  native_watch_first_frame(pid, ready_fd, select_us, break_us);
+  return G_SOURCE_REMOVE;
+}
+
+// Make-before-break: the previous worker stays on air until the new one reports its
+// first muxed packet, or switch_overlap_ms passes and it is stopped anyway. The select
+// returns once the request is written; a new worker that dies before its first frame
+// leaves the old one running and sets last_error. switch_overlap_ms 0 stops the old
+// worker before spawning (the cold gap).
 static gboolean app_select_native_graph(const GraphSpec *graph, gchar **error_out) {
   gchar *request = native_request_json(graph);
+  gchar *line = g_strdup_printf("%s\n", request);
+  g_free(request);
   GPid pid = 0;
-  gint stdin_fd = -1;
-  gchar *argv[] = { "/opt/dgst/d_native_processor", NULL };
-  GError *err = NULL;
+  gint stdin_fd = -1, ready_fd = -1;
+  gint64 select_us = g_get_monotonic_time(), break_us = 0;
 
   g_mutex_lock(&g_state.lock);
-  native_stop_locked();
+  native_switch_cancel_locked();
+  gboolean overlap = g_state.native_pid && g_cfg.switch_overlap_ms > 0;
+  if (!overlap && g_state.native_pid) {
+    native_stop_locked();
+    break_us = g_get_monotonic_time();
+  }
   g_mutex_unlock(&g_state.lock);
 
-  if (!g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
-                                NULL, NULL, &pid, &stdin_fd, NULL, NULL, &err)) {
-    if (error_out) *error_out = g_strdup(err ? err->message : "native_spawn_failed");
-    if (err) g_error_free(err);
-    g_free(request);
-    return FALSE;
+  // A parked worker whose stdin is gone (exited, not yet reaped) falls back to a cold spawn.
+  gboolean warm = pool_take(&pid, &stdin_fd, &ready_fd);
+  gboolean wrote = FALSE;
+  if (warm) {
+    wrote = write_all_fd(stdin_fd, line, strlen(line), NULL);
+    close(stdin_fd);
+    if (!wrote) {
+      kill((pid_t)pid, SIGTERM);
+      close(ready_fd);
+      warm = FALSE;
+    }
+  }
+  if (!wrote) {
+    if (!native_spawn(&pid, &stdin_fd, &ready_fd, error_out)) {
+      g_free(line);
+      return FALSE;
+    }
+    wrote = write_all_fd(stdin_fd, line, strlen(line), error_out);
+    close(stdin_fd);
   }
-  g_child_watch_add(pid, native_child_watch, NULL);
-  gchar *line = g_strdup_printf("%s\n", request);
-  gboolean wrote = write_all_fd(stdin_fd, line, strlen(line), error_out);
-  close(stdin_fd);
   g_free(line);
-  g_free(request);
   if (!wrote) {
     kill((pid_t)pid, SIGTERM);
+    close(ready_fd);
     return FALSE;
   }
 
+  LOG_INF("selected native graph runtime=%s program=%s source=%s sink=%s stages=%u audio=%u pid=%d worker=%s",
+          graph->runtime_name, graph->program_name, graph->source_uri, graph->sink_uri,
+          graph->stage_count, graph->audio_stage_count, (int)pid, warm ? "warm" : "cold");
+
   g_mutex_lock(&g_state.lock);
+  // The old worker may have exited while this one was spawned: no overlap then.
+  if (overlap && g_state.native_pid) {
+    if (++s_switch_serial == 0) s_switch_serial = 1;
+    s_switch.serial = s_switch_serial;
+    s_switch.pid = pid;
+    s_switch.ready_fd = ready_fd;
+    s_switch.graph = *graph;
+    s_switch.select_us = select_us;
+    s_switch.fd_id = g_unix_fd_add(ready_fd, G_IO_IN | G_IO_HUP | G_IO_ERR, native_switch_ready_cb,
+                                   GUINT_TO_POINTER(s_switch.serial));
+    s_switch.timeout_id = g_timeout_add(g_cfg.switch_overlap_ms, native_switch_timeout_cb,
+                                        GUINT_TO_POINTER(s_switch.serial));
+    g_mutex_unlock(&g_state.lock);
+    return TRUE;
+  }
+  if (g_state.native_pid) {
+    native_stop_locked();
+    break_us = g_get_monotonic_time();
+  }
   g_state.native_pid = pid;
   g_state.native_running = TRUE;
   g_state.graph = *graph;
@@ -358,10 +712,7 @@ static gboolean app_select_native_graph(const GraphSpec *graph, gchar **error_ou
   g_free(g_state.last_error);
   g_state.last_error = NULL;
   g_mutex_unlock(&g_state.lock);
-
-  LOG_INF("selected native graph runtime=%s program=%s source=%s sink=%s stages=%u audio=%u pid=%d",
-          graph->runtime_name, graph->program_name, graph->source_uri, graph->sink_uri,
-          graph->stage_count, graph->audio_stage_count, (int)pid);
+  native_watch_first_frame(pid, ready_fd, select_us, break_us);
   return TRUE;
 }
 
@@ -372,6 +723,7 @@ gboolean app_select_graph(const GraphSpec *graph, gchar **error_out) {
 
 void app_stop_graph(void) {
   g_mutex_lock(&g_state.lock);
+  native_switch_cancel_locked();
   native_stop_locked();
   g_state.running = FALSE;
   g_mutex_unlock(&g_state.lock);
@@ -382,7 +734,27 @@ gchar *app_status_json(void) {
   gchar *out = graph_spec_summary_json(&g_state.graph,
                                        g_state.running ? "running" : "idle",
                                        g_state.last_error);
+  gboolean measured = g_state.switch_measured;
+  gdouble first_ms = g_state.switch_first_frame_ms;
+  gdouble gap_ms = g_state.switch_gap_ms;
+  gdouble overlap_ms = g_state.switch_overlap_ms;
   g_mutex_unlock(&g_state.lock);
+  if (!measured) return out;
+
+  JsonParser *parser = NULL;
+  JsonObject *root = json_object_from_text(out, &parser);
+  if (!root) return out;
+  JsonObject *sw = json_object_new();
+  json_object_set_double_member(sw, "firstFrameMs", first_ms);
+  json_object_set_double_member(sw, "gapMs", gap_ms);
+  json_object_set_double_member(sw, "overlapMs", overlap_ms);
+  json_object_set_object_member(root, "lastSwitch", sw);
+  JsonGenerator *g = json_generator_new();
+  json_generator_set_root(g, json_parser_get_root(parser));
+  g_free(out);
+  out = json_generator_to_data(g, NULL);
+  g_object_unref(g);
+  g_object_unref(parser);
   return out;
 }
 
@@ -398,8 +770,19 @@ gboolean app_setup(const AppConfig *cfg) {
   g_cfg.default_graph = g_strdup(cfg->default_graph);
   g_cfg.mediamtx_rtsp_url = g_strdup(cfg->mediamtx_rtsp_url);
   g_cfg.public_playback_url = g_strdup(cfg->public_playback_url);
+  g_cfg.native_processor = g_strdup(cfg->native_processor);
+  g_cfg.warm_workers = MIN(cfg->warm_workers, WARM_POOL_MAX);
+  g_cfg.warm_refill_ms = cfg->warm_refill_ms;
+  g_cfg.switch_overlap_ms = cfg->switch_overlap_ms;
   g_mutex_init(&g_state.lock);
   graph_spec_init(&g_state.graph);
+  // Worker stdin writes must fail with EPIPE, not kill the runtime.
+  signal(SIGPIPE, SIG_IGN);
+
+  g_mutex_lock(&s_pool_lock);
+  pool_fill_locked();
+  g_mutex_unlock(&s_pool_lock);
+  if (g_cfg.warm_workers) LOG_INF("warm pool: %u worker(s) of %s", g_cfg.warm_workers, g_cfg.native_processor);
 
   gchar *error = NULL;
   GraphSpec graph;
@@ -432,6 +815,7 @@ void app_loop(void) {
 
 void app_teardown(void) {
   app_stop_graph();
+  pool_drain();
   if (g_loop) {
     g_main_loop_unref(g_loop);
     g_loop = NULL;
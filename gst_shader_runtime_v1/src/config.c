@@ -1,5 +1,10 @@
 #include "config.h"
 
+static guint env_uint(const gchar *name, guint fallback) {
+  const gchar *value = g_getenv(name);
+  return (value && *value) ? (guint)g_ascii_strtoull(value, NULL, 10) : fallback;
+}
+
 static gchar *env_dup(const gchar *name, const gchar *fallback) {
   const gchar *value = g_getenv(name);
   return g_strdup((value && *value) ? value : fallback);
@@ -14,6 +19,10 @@ gboolean parse_args(int argc, char **argv, AppConfig *cfg) {
   cfg->default_graph = env_dup("DGST_DEFAULT_GRAPH", "/opt/dgst/graphs/default_video.json");
   cfg->mediamtx_rtsp_url = env_dup("DGST_MEDIAMTX_RTSP_URL", "unix:/run/99ks/99sk.ts.sock");
   cfg->public_playback_url = env_dup("DGST_PUBLIC_PLAYBACK_URL", "http://localhost:8888/default/index.m3u8");
+  cfg->native_processor = env_dup("DGST_NATIVE_PROCESSOR", "/opt/dgst/d_native_processor");
+  cfg->warm_workers = env_uint("DGST_WARM_WORKERS", 1);
+  cfg->warm_refill_ms = env_uint("DGST_WARM_REFILL_MS", 3000);
+  cfg->switch_overlap_ms = env_uint("DGST_SWITCH_OVERLAP_MS", 10000);
   return TRUE;
 }
 
@@ -21,4 +30,5 @@ void cleanup_config(AppConfig *cfg) {
   g_free(cfg->default_graph);
   g_free(cfg->mediamtx_rtsp_url);
   g_free(cfg->public_playback_url);
+  g_free(cfg->native_processor);
 }
@@ -9,6 +9,10 @@ typedef struct {
   gchar *default_graph;
   gchar *mediamtx_rtsp_url;
   gchar *public_playback_url;
+  gchar *native_processor;   // worker binary (a stub speaking the stdin protocol works too)
+  guint warm_workers;        // prespawned workers parked after bake_worker_init
+  guint warm_refill_ms;      // delay before replacing a worker taken from the pool
+  guint switch_overlap_ms;   // how long the old worker stays up waiting for the new one's first frame; 0 = stop first
 } AppConfig;
 
 gboolean parse_args(int argc, char **argv, AppConfig *cfg);
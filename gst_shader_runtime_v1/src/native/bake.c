@@ -221,7 +221,7 @@ static void set_json_value(char* line, const jsmntok_t* toks, int n, int* i, con
     }
 }
 
-static int parse_request_line(char* line, BakeRequest* req, int* prep_only) {
+static int parse_request_line(char* line, BakeRequest* req, int* prep_only, int* warm_only) {
     jsmn_parser p;
     jsmn_init(&p);
     jsmntok_t toks[8192];
@@ -275,12 +275,14 @@ static int parse_request_line(char* line, BakeRequest* req, int* prep_only) {
         else if (jsmn_key_eq(line, &toks[i], "temporal_denoise_strength")) { req->temporal_denoise_strength = (float)atof(line + val->start); i++; }
         else if (jsmn_key_eq(line, &toks[i], "temporal_denoise_luma_max")) { req->temporal_denoise_luma_max = (float)atof(line + val->start); i++; }
         else if (jsmn_key_eq(line, &toks[i], "prep_only")) { if (prep_only) *prep_only = json_bool_token(line, val); i++; }
+        else if (jsmn_key_eq(line, &toks[i], "warm_only")) { if (warm_only) *warm_only = json_bool_token(line, val); i++; }
         else {
             line[toks[i].end] = 0;
             fprintf(stderr, "[d_native_processor] unknown_request_field=%s\n", line + toks[i].start);
             return -1;
         }
     }
+    if (warm_only && *warm_only) return 0;
     clamp_request(req);
     if (req->d_pipeline_json && req->d_pipeline_json[0] && strcmp(req->d_pipeline_json, "{}") != 0) {
         char err[256] = {0};
@@ -376,6 +378,7 @@ int main(int argc, char** argv) {
     size_t cap = 0;
     size_t stream_cap = 0;
     int prep_only = 0;
+    int warm_only = 0;
     int rc = 0;
 
     if (getline(&line, &cap, stdin) <= 0) {
@@ -383,11 +386,31 @@ int main(int argc, char** argv) {
         rc = 2;
         goto done;
     }
-    if (parse_request_line(line, &req, &prep_only) < 0) {
+    if (parse_request_line(line, &req, &prep_only, &warm_only) < 0) {
         fprintf(stderr, "[d_native_processor] bad_json\n");
         rc = 3;
         goto done;
     }
+    if (warm_only) {
+        BakeResult warm_res;
+        if (bake_warm(&w, &warm_res) != 0) {
+            fprintf(stderr, "[d_native_processor] warm_failed: %s\n", warm_res.error);
+            rc = 8;
+            goto done;
+        }
+        fprintf(stderr, "[d_native_processor] warm, awaiting request\n");
+        set_request_defaults(&req);
+        if (getline(&line, &cap, stdin) <= 0) {
+            fprintf(stderr, "[d_native_processor] no request on stdin after warm\n");
+            rc = 2;
+            goto done;
+        }
+        if (parse_request_line(line, &req, &prep_only, NULL) < 0) {
+            fprintf(stderr, "[d_native_processor] bad_json\n");
+            rc = 3;
+            goto done;
+        }
+    }
     if (!req.url) {
         fprintf(stderr, "[d_native_processor] missing_url\n");
         rc = 4;
@@ -410,7 +433,7 @@ int main(int argc, char** argv) {
             rc = 6;
             goto done;
         }
-        if (parse_request_line(stream_line, &req, NULL) < 0) {
+        if (parse_request_line(stream_line, &req, NULL, NULL) < 0) {
             fprintf(stderr, "[d_native_processor] bad_stream_json\n");
             bake_release_prepared(&w);
             rc = 7;
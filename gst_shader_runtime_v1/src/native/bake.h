@@ -296,6 +296,11 @@ int bake_run(BakeWorker* w, const BakeRequest* req, BakeResult* res);
 // 8-9 s. If a prepared worker is killed before bake_run_prepared, the
 // caller should invoke bake_release_prepared to close the stashed context.
 int bake_prepare(BakeWorker* w, const BakeRequest* req, BakeResult* res);
+// Warm-pool variant: a {warm_only:true} first line carries no request, so only
+// the source-independent part is paid up front (library preload, CUDA context,
+// worker buffers via bake_worker_init). The real request line follows on
+// stdin and runs bake_run or the prep_only pair on the already-ready worker.
+int bake_warm(BakeWorker* w, BakeResult* res);
 int bake_run_prepared(BakeWorker* w, const BakeRequest* req, BakeResult* res);
 void bake_release_prepared(BakeWorker* w);
 
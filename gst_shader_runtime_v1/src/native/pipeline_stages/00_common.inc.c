@@ -9,6 +9,24 @@ static double progress_log_interval_s(void) {
     return value;
 }
 
+// Make-before-break handshake: the runtime keeps the previous worker on air until
+// this line arrives on DPROC_READY_FD. Sent once, after the first muxed packet.
+static void notify_first_frame_out(void) {
+    const char* raw = getenv("DPROC_READY_FD");
+    if (!raw || !*raw) return;
+    char* end = NULL;
+    long fd = strtol(raw, &end, 10);
+    if (end == raw || fd < 0 || fd > INT_MAX) return;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    char line[64];
+    int n = snprintf(line, sizeof(line), "first_frame mono_ns=%lld\n",
+                     (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+    ssize_t wr = write((int)fd, line, (size_t)n);
+    (void)wr;  // runtime gone or no longer waiting: nothing to do
+    close((int)fd);
+}
+
 extern void launch_nv12_pre_vsr_filter(
     const void* y_plane, const void* uv_plane, void* out_rgba,
     int srcH, int srcW,
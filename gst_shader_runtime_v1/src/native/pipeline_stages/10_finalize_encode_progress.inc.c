@@ -150,6 +150,7 @@ static int encode_final_rgba_frame(BakeCtx* c, BakeWorker* w, const BakeRequest*
         }
         av_packet_unref(op);
         (*n_out)++;
+        if (*n_out == 1) notify_first_frame_out();
     }
     if (er != AVERROR(EAGAIN) && er != AVERROR_EOF) {
         snprintf(g_last_error, sizeof(g_last_error), "enc_recv=%d", er);
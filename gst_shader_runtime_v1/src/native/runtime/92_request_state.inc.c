@@ -226,6 +226,17 @@ int bake_prepare(BakeWorker* w, const BakeRequest* req, BakeResult* res) {
     return 0;
 }
 
+int bake_warm(BakeWorker* w, BakeResult* res) {
+    memset(res, 0, sizeof(*res));
+    g_last_error[0] = 0;
+    if (ensure_worker_ready(w) < 0) {
+        snprintf(res->error, sizeof(res->error), "%s", g_last_error[0] ? g_last_error : "worker_init");
+        return -1;
+    }
+    res->ok = 1;
+    return 0;
+}
+
 void bake_release_prepared(BakeWorker* w) {
     (void)w;
     if (!g_prepared_valid) return;
@@ -0,0 +1,108 @@
+// d_stub_processor: stands in for d_native_processor when testing the runtime.
+//
+// Speaks the same stdin contract without CUDA or media: an optional
+// {"warm_only":true} line, then one request line (must carry "url"). After the
+// request it writes "first_frame mono_ns=<CLOCK_MONOTONIC ns>" to $DPROC_READY_FD
+// like the real worker does after its first muxed packet, then idles until
+// SIGTERM. Knobs (inherited through the runtime's environment):
+//   DGST_STUB_LOG             append one "<mono_ms> <pid> <event>" line per event
+//                             (start, warm, request, first_frame, exit)
+//   DGST_STUB_WARM_MS         time the warm phase takes (default 0)
+//   DGST_STUB_WARM_FAIL       1: exit 8 after the warm line, like a failed warm-up
+//   DGST_STUB_FIRST_FRAME_MS  request -> first frame (default 100)
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_term(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static long long mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long env_long(const char* name, long fallback) {
+    const char* raw = getenv(name);
+    if (!raw || !*raw) return fallback;
+    char* end = NULL;
+    long v = strtol(raw, &end, 10);
+    return end == raw ? fallback : v;
+}
+
+static void sleep_ms(long ms) {
+    if (ms <= 0) return;
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && !g_stop) {}
+}
+
+// One O_APPEND write per event, so concurrent workers never interleave lines.
+static void event(const char* what) {
+    const char* path = getenv("DGST_STUB_LOG");
+    fprintf(stderr, "[d_stub_processor] pid=%d %s\n", (int)getpid(), what);
+    if (!path || !*path) return;
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    char line[128];
+    int n = snprintf(line, sizeof(line), "%lld %d %s\n", mono_ns() / 1000000LL, (int)getpid(), what);
+    ssize_t wr = write(fd, line, (size_t)n);
+    (void)wr;
+    close(fd);
+}
+
+static void notify_first_frame_out(void) {
+    const char* raw = getenv("DPROC_READY_FD");
+    if (!raw || !*raw) return;
+    char* end = NULL;
+    long fd = strtol(raw, &end, 10);
+    if (end == raw || fd < 0 || fd > INT_MAX) return;
+    char line[64];
+    int n = snprintf(line, sizeof(line), "first_frame mono_ns=%lld\n", mono_ns());
+    ssize_t wr = write((int)fd, line, (size_t)n);
+    (void)wr;
+    close((int)fd);
+}
+
+int main(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_term;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    event("start");
+
+    char* line = NULL;
+    size_t cap = 0;
+    int rc = 0;
+    if (getline(&line, &cap, stdin) <= 0) { rc = 2; goto done; }
+    if (strstr(line, "\"warm_only\":true")) {
+        sleep_ms(env_long("DGST_STUB_WARM_MS", 0));
+        event("warm");
+        if (env_long("DGST_STUB_WARM_FAIL", 0)) { rc = 8; goto done; }
+        if (getline(&line, &cap, stdin) <= 0) { rc = 2; goto done; }
+    }
+    if (!strstr(line, "\"url\"")) { rc = 4; goto done; }
+    event("request");
+    sleep_ms(env_long("DGST_STUB_FIRST_FRAME_MS", 100));
+    if (g_stop) goto done;
+    notify_first_frame_out();
+    event("first_frame");
+    while (!g_stop) pause();
+
+done:
+    event("exit");
+    free(line);
+    return rc;
+}
@@ -11,6 +11,11 @@ typedef struct {
   gchar *last_error;
   gboolean running;
   gboolean native_running;
+  // Last graph switch, from the new worker's first-frame report (ms).
+  gboolean switch_measured;
+  gdouble switch_first_frame_ms;  // select -> first muxed packet
+  gdouble switch_gap_ms;          // old worker stopped -> new first packet (0 when they overlapped)
+  gdouble switch_overlap_ms;      // new first packet -> old worker stopped
 } RuntimeState;
 
 extern RuntimeState g_state;
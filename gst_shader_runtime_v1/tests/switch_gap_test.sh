@@ -0,0 +1,102 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Make-before-break switch test: dgst_runtime with d_stub_processor as the worker
+# (no GPU). Selects a graph, then selects again while the first worker is on air,
+# with the new worker taking FIRST_FRAME_MS to its first frame. Checks that
+#   - the second select returns without waiting for that first frame,
+#   - the control API answers during the overlap and the old worker keeps running,
+#   - the old worker is stopped only after the new one's first frame,
+#   - /v1/status reports lastSwitch.gapMs == 0.
+# Run inside the image:
+#   docker run --rm dgst:latest bash tests/switch_gap_test.sh
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+RUNTIME="${RUNTIME:-$ROOT/dgst_runtime}"
+STUB="${STUB:-$ROOT/d_stub_processor}"
+GRAPH="${GRAPH:-$ROOT/graphs/test_videotestsrc_hevc.json}"
+PORT="${PORT:-18089}"
+FIRST_FRAME_MS="${FIRST_FRAME_MS:-1500}"
+OVERLAP_MS="${OVERLAP_MS:-5000}"
+OUT="$(mktemp -d)"
+EVENTS="$OUT/events"
+RT_PID=""
+
+fail() {
+  echo "FAIL: $*"
+  echo "--- stub events"; cat "$EVENTS" 2>/dev/null || true
+  echo "--- runtime"; cat "$OUT/runtime.log" 2>/dev/null || true
+  exit 1
+}
+
+rt_stop() {
+  [[ -n "$RT_PID" ]] || return 0
+  kill "$RT_PID" 2>/dev/null || true
+  wait "$RT_PID" 2>/dev/null || true
+  RT_PID=""
+}
+trap 'rt_stop; rm -rf "$OUT"' EXIT
+
+pids_of() { awk -v e="$1" '$3 == e { print $2 }' "$EVENTS"; }
+ms_of() { awk -v e="$1" -v p="$2" '$3 == e && $2 == p { print $1; exit }' "$EVENTS"; }
+count_of() { pids_of "$1" | wc -l; }
+now_ms() { date +%s%3N; }
+
+wait_count() {
+  local waited=0
+  while (( $(count_of "$1") < $2 )); do
+    (( waited >= $3 )) && fail "expected $2 '$1' event(s) within $3 ms, got $(count_of "$1")"
+    sleep 0.05
+    waited=$(( waited + 50 ))
+  done
+}
+
+select_graph() {
+  local code
+  code="$(curl -sS -o "$OUT/select.json" -w '%{http_code}' -X POST \
+    -H 'Content-Type: application/json' --data-binary @"$GRAPH" \
+    "http://127.0.0.1:$PORT/v1/programs/test/select")"
+  [[ "$code" == 200 ]] || fail "select -> HTTP $code: $(cat "$OUT/select.json")"
+}
+
+: >"$EVENTS"
+env CTRL_PORT="$PORT" DGST_NATIVE_PROCESSOR="$STUB" DGST_DEFAULT_GRAPH=/nonexistent \
+  DGST_SWITCH_OVERLAP_MS="$OVERLAP_MS" DGST_STUB_FIRST_FRAME_MS="$FIRST_FRAME_MS" \
+  DGST_STUB_LOG="$EVENTS" "$RUNTIME" >"$OUT/runtime.log" 2>&1 &
+RT_PID=$!
+for _ in $(seq 1 50); do
+  curl -fsS "http://127.0.0.1:$PORT/v1/status" >/dev/null 2>&1 && break
+  sleep 0.1
+done
+
+select_graph
+wait_count first_frame 1 $(( FIRST_FRAME_MS + 3000 ))
+old="$(pids_of first_frame | tail -n1)"
+
+t0="$(now_ms)"
+select_graph
+select_ms=$(( $(now_ms) - t0 ))
+(( select_ms < FIRST_FRAME_MS / 2 )) || fail "select took ${select_ms} ms: it waited for the first frame"
+curl -fsS --max-time 0.5 "http://127.0.0.1:$PORT/v1/status" >/dev/null \
+  || fail "control API blocked during the overlap"
+kill -0 "$old" 2>/dev/null || fail "old worker $old stopped before the new first frame"
+echo "PASS async: select returned in ${select_ms} ms, status answered during the overlap"
+
+wait_count first_frame 2 $(( FIRST_FRAME_MS + 3000 ))
+new="$(pids_of first_frame | tail -n1)"
+wait_count exit 1 2000
+[[ "$(pids_of exit | head -n1)" == "$old" ]] || fail "first worker to exit was not the old one"
+handover=$(( $(ms_of exit "$old") - $(ms_of first_frame "$new") ))
+(( handover >= 0 )) || fail "old worker exited ${handover#-} ms before the new first frame"
+echo "PASS handover: old pid $old stopped ${handover} ms after pid $new's first frame"
+
+for _ in $(seq 1 20); do
+  curl -fsS "http://127.0.0.1:$PORT/v1/status" >"$OUT/status.json" && grep -q lastSwitch "$OUT/status.json" && break
+  sleep 0.1
+done
+python3 - "$OUT/status.json" <<'EOF' || fail "lastSwitch: $(cat "$OUT/status.json")"
+import json, sys
+sw = json.load(open(sys.argv[1]))["lastSwitch"]
+print("lastSwitch firstFrameMs=%.1f gapMs=%.1f overlapMs=%.1f" % (sw["firstFrameMs"], sw["gapMs"], sw["overlapMs"]))
+sys.exit(0 if sw["gapMs"] == 0 else 1)
+EOF
+echo "PASS switch gap"
@@ -0,0 +1,114 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Warm worker pool test: dgst_runtime with d_stub_processor as the worker (no GPU).
+#   take     a select is served by the parked worker
+#   refill   the taken slot is refilled after DGST_WARM_REFILL_MS, not before
+#   replace  a parked worker that dies while idle is replaced
+#   disable  three workers failing warm-up turn the pool off; selects spawn cold
+# Workers are identified through the stub's event log (DGST_STUB_LOG), not the
+# runtime's stdout. Run inside the image:
+#   docker run --rm dgst:latest bash tests/warm_pool_test.sh
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+RUNTIME="${RUNTIME:-$ROOT/dgst_runtime}"
+STUB="${STUB:-$ROOT/d_stub_processor}"
+GRAPH="${GRAPH:-$ROOT/graphs/test_videotestsrc_hevc.json}"
+PORT="${PORT:-18088}"
+REFILL_MS="${REFILL_MS:-800}"
+SLACK_MS="${SLACK_MS:-50}"
+OUT="$(mktemp -d)"
+EVENTS="$OUT/events"
+RT_PID=""
+
+fail() {
+  echo "FAIL: $*"
+  echo "--- stub events"; cat "$EVENTS" 2>/dev/null || true
+  echo "--- runtime"; cat "$OUT/runtime.log" 2>/dev/null || true
+  exit 1
+}
+
+rt_start() {
+  : >"$EVENTS"
+  env CTRL_PORT="$PORT" DGST_NATIVE_PROCESSOR="$STUB" DGST_DEFAULT_GRAPH=/nonexistent \
+    DGST_WARM_WORKERS=1 DGST_WARM_REFILL_MS="$REFILL_MS" DGST_STUB_LOG="$EVENTS" "$@" \
+    "$RUNTIME" >"$OUT/runtime.log" 2>&1 &
+  RT_PID=$!
+  for _ in $(seq 1 50); do
+    curl -fsS "http://127.0.0.1:$PORT/v1/status" >/dev/null 2>&1 && return 0
+    sleep 0.1
+  done
+  fail "runtime did not come up on :$PORT"
+}
+
+rt_stop() {
+  [[ -n "$RT_PID" ]] || return 0
+  kill "$RT_PID" 2>/dev/null || true
+  wait "$RT_PID" 2>/dev/null || true
+  RT_PID=""
+}
+trap 'rt_stop; rm -rf "$OUT"' EXIT
+
+# Pids / timestamps (mono ms) of an event, in log order.
+pids_of() { awk -v e="$1" '$3 == e { print $2 }' "$EVENTS"; }
+ms_of() { awk -v e="$1" -v p="$2" '$3 == e && $2 == p { print $1; exit }' "$EVENTS"; }
+count_of() { pids_of "$1" | wc -l; }
+
+# wait_count EVENT N TIMEOUT_MS: until at least N EVENT lines are logged.
+wait_count() {
+  local waited=0
+  while (( $(count_of "$1") < $2 )); do
+    (( waited >= $3 )) && fail "expected $2 '$1' event(s) within $3 ms, got $(count_of "$1")"
+    sleep 0.05
+    waited=$(( waited + 50 ))
+  done
+}
+
+select_graph() {
+  local code
+  code="$(curl -sS -o "$OUT/select.json" -w '%{http_code}' -X POST \
+    -H 'Content-Type: application/json' --data-binary @"$GRAPH" \
+    "http://127.0.0.1:$PORT/v1/programs/test/select")"
+  [[ "$code" == 200 ]] || fail "select -> HTTP $code: $(cat "$OUT/select.json")"
+}
+
+# --- take / refill / replace
+rt_start
+wait_count warm 1 3000
+parked="$(pids_of warm | tail -n1)"
+select_graph
+wait_count request 1 2000
+served="$(pids_of request | tail -n1)"
+[[ "$served" == "$parked" ]] || fail "take: select served by pid $served, parked was $parked"
+echo "PASS take: select served by parked pid $parked"
+
+sleep "$(awk -v ms="$REFILL_MS" 'BEGIN { printf "%.3f", ms / 2000 }')"
+(( $(count_of start) == 1 )) || fail "refill: worker spawned before DGST_WARM_REFILL_MS"
+wait_count warm 2 $(( REFILL_MS + 3000 ))
+refill="$(pids_of warm | tail -n1)"
+delay=$(( $(ms_of start "$refill") - $(ms_of request "$served") ))
+(( delay >= REFILL_MS - SLACK_MS )) || fail "refill: new worker after ${delay} ms < ${REFILL_MS} ms"
+echo "PASS refill: pid $refill parked ${delay} ms after the take"
+
+kill -TERM "$refill"
+wait_count exit 1 2000
+wait_count warm 3 $(( REFILL_MS + 3000 ))
+replacement="$(pids_of warm | tail -n1)"
+delay=$(( $(ms_of start "$replacement") - $(ms_of exit "$refill") ))
+(( delay >= REFILL_MS - SLACK_MS )) || fail "replace: new worker after ${delay} ms < ${REFILL_MS} ms"
+kill -0 "$served" 2>/dev/null || fail "replace: running worker $served died with the parked one"
+echo "PASS replace: dead parked pid $refill replaced by $replacement after ${delay} ms"
+rt_stop
+
+# --- disable after three failed warm-ups
+rt_start DGST_STUB_WARM_FAIL=1
+wait_count warm 3 $(( 3 * REFILL_MS + 3000 ))
+sleep "$(awk -v ms="$REFILL_MS" 'BEGIN { printf "%.3f", (2 * ms + 500) / 1000 }')"
+(( $(count_of start) == 3 )) || fail "disable: $(count_of start) warm-up attempts, want 3"
+select_graph
+wait_count request 1 2000
+cold="$(pids_of request | tail -n1)"
+! pids_of warm | grep -qx "$cold" || fail "disable: select served by a warm worker"
+echo "PASS disable: pool off after 3 failed warm-ups, select spawned cold pid $cold"
+rt_stop
+
+echo "PASS warm pool"